@@ -4,23 +4,9 @@
 #include "../../Common/mpt_tree/mpt_tree_common.h"
 #include <string.h>
 #include <stdlib.h>
-
-void platform_sha256(const uint8_t* data, size_t len, uint8_t* hash) {
-    if (data == NULL || hash == NULL) return;
-    
-    
-    
-    
-    
-    
-    
-    memset(hash, 0, 32);
-    
-    
-    for (size_t i = 0; i < len && i < 32; i++) {
-        hash[i] = data[i] ^ 0xAA;
-    }
-}
+#include <errno.h>
+#include <time.h>
+#include <sys/random.h>
 
 void* platform_malloc(size_t size) {
     
@@ -43,20 +29,31 @@ void platform_free(void* ptr) {
     free(ptr);
 }
 
-int platform_get_random(uint8_t* buffer, size_t len) {
+int platform_get_entropy(uint8_t* buffer, size_t len) {
     if (buffer == NULL) return -1;
     
-    
-    
-    
-    
-    
-    for (size_t i = 0; i < len; i++) {
-        buffer[i] = rand() % 256;
+    size_t filled = 0;
+    while (filled < len) {
+        ssize_t got = getrandom(buffer + filled, len - filled, 0);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        filled += (size_t)got;
     }
     return 0;
 }
 
+uint64_t platform_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t platform_time_ms(void) {
+    return platform_time_ns() / 1000000ull;
+}
+
 int platform_encrypt_memory(void* data, size_t len) {
     
     
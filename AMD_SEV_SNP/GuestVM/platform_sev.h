@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "../../Common/mpt_tree/mpt_tree_common.h"
+#include "../../Common/platform/platform_crypto.h"
 
 int platform_encrypt_memory(void* data, size_t len);
 int platform_decrypt_memory(void* data, size_t len);
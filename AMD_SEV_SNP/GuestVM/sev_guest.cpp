@@ -270,8 +270,16 @@ int sev_set_tx_sort_info(const uint64_t* tx_ids,
     }
     
     
-    tx_sort_info_t sort_info[MAX_PENDING_TXS];
-    size_t info_count = (count > MAX_PENDING_TXS) ? MAX_PENDING_TXS : count;
+    size_t limit = g_cluster_state.tx_limit;
+    size_t info_count = (count > limit) ? limit : count;
+    if (info_count == 0) {
+        return 0;
+    }
+    
+    tx_sort_info_t* sort_info = (tx_sort_info_t*)platform_malloc(info_count * sizeof(tx_sort_info_t));
+    if (sort_info == NULL) {
+        return -1;
+    }
     
     for (size_t i = 0; i < info_count; i++) {
         sort_info[i].tx_id = tx_ids[i];
@@ -279,7 +287,9 @@ int sev_set_tx_sort_info(const uint64_t* tx_ids,
         sort_info[i].sort_timestamp = 0; 
     }
     
-    return tee_cluster_set_tx_sort_info(&g_cluster_state, sort_info, info_count);
+    int ret = tee_cluster_set_tx_sort_info(&g_cluster_state, sort_info, info_count);
+    platform_free(sort_info);
+    return ret;
 }
 
 int sev_add_executed_tx(uint64_t tx_id,
@@ -0,0 +1,613 @@
+#include "mpt_tree.h"
+#include "mpt_store.h"
+#include "mpt_rcu.h"
+#include "mpt_journal.h"
+#include "../thread_pool/thread_pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_DEFAULT_KEYS 1000000
+#define BENCH_KEY_LEN 64
+#define BENCH_VALUE_LEN 32
+#define BENCH_SPARSE_KEYS 20000
+#define BENCH_EPOCHS 10
+#define BENCH_JOURNAL_BATCH 1000
+#define BENCH_JOURNAL_CHECKPOINT (4 * 1024 * 1024)
+
+static uint64_t bench_rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t bench_rand(void) {
+    uint64_t x = bench_rng_state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    bench_rng_state = x;
+    return x;
+}
+
+static double bench_now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void bench_make_key(uint8_t* key, size_t index, const uint8_t* token) {
+    memset(key, 0, BENCH_KEY_LEN);
+    for (size_t i = 0; i < 20; i += 8) {
+        uint64_t r = bench_rand() ^ index;
+        memcpy(key + i, &r, (20 - i < 8) ? 20 - i : 8);
+    }
+    memcpy(key + 20, token, 42);
+}
+
+static int bench_key_compare(const void* a, const void* b) {
+    return memcmp(a, b, BENCH_KEY_LEN);
+}
+
+typedef struct {
+    mpt_tree_t* tree;
+    const uint8_t* keys;
+    const size_t* order;
+    size_t begin;
+    size_t end;
+    size_t hits;
+} bench_reader_t;
+
+static void* bench_reader_run(void* arg) {
+    bench_reader_t* reader = (bench_reader_t*)arg;
+    uint8_t value[BENCH_VALUE_LEN];
+    for (size_t i = reader->begin; i < reader->end; i++) {
+        size_t value_len = BENCH_VALUE_LEN;
+        if (mpt_tree_read_get(reader->tree, reader->keys + reader->order[i] * BENCH_KEY_LEN,
+                              BENCH_KEY_LEN, value, &value_len) == 0) {
+            reader->hits++;
+        }
+    }
+    return NULL;
+}
+
+typedef struct {
+    uint8_t* data;
+    size_t len;
+    size_t capacity;
+    size_t pos;
+} bench_buffer_t;
+
+static int bench_buffer_write(void* ctx, const uint8_t* data, size_t len) {
+    bench_buffer_t* buffer = (bench_buffer_t*)ctx;
+    if (buffer->len + len > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 1 << 20;
+        while (buffer->len + len > capacity) capacity *= 2;
+        uint8_t* grown = (uint8_t*)realloc(buffer->data, capacity);
+        if (grown == NULL) return -1;
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->len, data, len);
+    buffer->len += len;
+    return 0;
+}
+
+static int bench_buffer_read(void* ctx, uint8_t* data, size_t len) {
+    bench_buffer_t* buffer = (bench_buffer_t*)ctx;
+    if (buffer->len - buffer->pos < len) return -1;
+    memcpy(data, buffer->data + buffer->pos, len);
+    buffer->pos += len;
+    return 0;
+}
+
+typedef struct {
+    mpt_tree_t* tree;
+    size_t fetches;
+    size_t bytes;
+    size_t diffs;
+} bench_remote_t;
+
+static int bench_remote_fetch(void* ctx, const uint8_t* path, size_t path_len,
+                              uint8_t* data, size_t* len) {
+    bench_remote_t* remote = (bench_remote_t*)ctx;
+    if (mpt_tree_encode_at(remote->tree, path, path_len, data, len) != 0) return -1;
+    remote->fetches++;
+    remote->bytes += *len;
+    return 0;
+}
+
+static int bench_remote_diff(void* ctx, const uint8_t* key, size_t key_len,
+                             const uint8_t* local_value, size_t local_len,
+                             const uint8_t* remote_value, size_t remote_len) {
+    ((bench_remote_t*)ctx)->diffs++;
+    return 0;
+}
+
+static void bench_report(const char* name, size_t ops, double seconds) {
+    printf("%-24s %10zu ops %10.3f s %10.1f ns/op %12.0f ops/s\n",
+           name, ops, seconds, seconds * 1e9 / (double)ops, (double)ops / seconds);
+}
+
+static int bench_backend_epochs(const char* name, mpt_backend_t backend,
+                                const uint8_t* keys, size_t count) {
+    mpt_tree_t tree;
+    if (mpt_tree_init_backend(&tree, backend) != 0) return -1;
+    
+    uint8_t value[BENCH_VALUE_LEN];
+    memset(value, 0, sizeof(value));
+    
+    char label[64];
+    double start = bench_now_sec();
+    for (size_t i = 0; i < count; i++) {
+        memcpy(value, &i, sizeof(i));
+        if (mpt_tree_insert(&tree, keys + i * BENCH_KEY_LEN, BENCH_KEY_LEN, value, BENCH_VALUE_LEN) != 0) return -1;
+    }
+    if (mpt_tree_commit(&tree) != 0) return -1;
+    snprintf(label, sizeof(label), "%s insert+commit", name);
+    bench_report(label, count, bench_now_sec() - start);
+    
+    size_t per_epoch = (count / 100) ? count / 100 : 1;
+    start = bench_now_sec();
+    for (size_t epoch = 0; epoch < BENCH_EPOCHS; epoch++) {
+        for (size_t i = 0; i < per_epoch; i++) {
+            size_t idx = (size_t)(bench_rand() % count);
+            memcpy(value, &epoch, sizeof(epoch));
+            if (mpt_tree_insert(&tree, keys + idx * BENCH_KEY_LEN, BENCH_KEY_LEN, value, BENCH_VALUE_LEN) != 0) return -1;
+        }
+        if (mpt_tree_commit(&tree) != 0) return -1;
+    }
+    snprintf(label, sizeof(label), "%s epochs (1%%)", name);
+    bench_report(label, per_epoch * BENCH_EPOCHS, bench_now_sec() - start);
+    
+    uint8_t absent[BENCH_KEY_LEN];
+    memset(absent, 0xEE, sizeof(absent));
+    mpt_proof_t member;
+    mpt_proof_t missing;
+    if (mpt_tree_prove(&tree, keys, BENCH_KEY_LEN, &member) != 0) return -1;
+    if (mpt_tree_prove(&tree, absent, BENCH_KEY_LEN, &missing) != 0) return -1;
+    printf("%s proof bytes member=%zu absent=%zu\n", name, member.data_len, missing.data_len);
+    mpt_proof_free(&member);
+    mpt_proof_free(&missing);
+    
+    mpt_tree_destroy(&tree);
+    return 0;
+}
+
+static int bench_journal(const uint8_t* keys, size_t count) {
+    const char* journal_path = "/tmp/mpt_tree_bench.journal";
+    char snapshot_path[MPT_JOURNAL_PATH_MAX + 8];
+    snprintf(snapshot_path, sizeof(snapshot_path), "%s.snap", journal_path);
+    unlink(journal_path);
+    unlink(snapshot_path);
+    
+    mpt_journal_t journal;
+    mpt_tree_t tree;
+    if (mpt_journal_open(&journal, journal_path, BENCH_JOURNAL_CHECKPOINT) != 0) return -1;
+    if (mpt_tree_init(&tree) != 0 || mpt_tree_attach_journal(&tree, &journal) != 0) return -1;
+    
+    uint8_t value[BENCH_VALUE_LEN];
+    memset(value, 0, sizeof(value));
+    
+    size_t checkpoints = 0;
+    uint64_t generation = journal.generation;
+    double start = bench_now_sec();
+    for (size_t i = 0; i < count; i++) {
+        size_t idx = (size_t)(bench_rand() % count);
+        memcpy(value, &i, sizeof(i));
+        if (mpt_tree_insert(&tree, keys + idx * BENCH_KEY_LEN, BENCH_KEY_LEN, value, BENCH_VALUE_LEN) != 0) return -1;
+        if ((i + 1) % BENCH_JOURNAL_BATCH == 0 || i + 1 == count) {
+            if (mpt_tree_commit(&tree) != 0) return -1;
+            if (journal.generation != generation) checkpoints++;
+            generation = journal.generation;
+        }
+    }
+    bench_report("journal insert+commit", count, bench_now_sec() - start);
+    printf("journal batches=%zu checkpoints=%zu tail bytes=%llu\n",
+           (count + BENCH_JOURNAL_BATCH - 1) / BENCH_JOURNAL_BATCH, checkpoints,
+           (unsigned long long)journal.end);
+    
+    uint8_t root[MPT_NODE_HASH_SIZE];
+    memcpy(root, tree.root_hash, MPT_NODE_HASH_SIZE);
+    size_t size = tree.size;
+    mpt_tree_destroy(&tree);
+    mpt_journal_close(&journal);
+    
+    start = bench_now_sec();
+    if (mpt_journal_open(&journal, journal_path, BENCH_JOURNAL_CHECKPOINT) != 0) return -1;
+    if (mpt_tree_init(&tree) != 0 || mpt_tree_attach_journal(&tree, &journal) != 0) return -1;
+    double recovery = bench_now_sec() - start;
+    bool match = memcmp(tree.root_hash, root, MPT_NODE_HASH_SIZE) == 0 && tree.size == size;
+    printf("journal recovery %.3f s keys=%zu root %s\n", recovery, tree.size, match ? "matches" : "DIFFERS");
+    
+    mpt_tree_destroy(&tree);
+    mpt_journal_close(&journal);
+    unlink(journal_path);
+    unlink(snapshot_path);
+    return match ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+    size_t count = BENCH_DEFAULT_KEYS;
+    if (argc > 1) {
+        count = (size_t)strtoull(argv[1], NULL, 10);
+        if (count == 0) count = BENCH_DEFAULT_KEYS;
+    }
+    size_t threads = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 2) {
+        threads = (size_t)strtoull(argv[2], NULL, 10);
+    }
+    
+    uint8_t token[42];
+    for (size_t i = 0; i < sizeof(token); i++) {
+        token[i] = (uint8_t)bench_rand();
+    }
+    
+    uint8_t* keys = (uint8_t*)malloc(count * BENCH_KEY_LEN);
+    if (keys == NULL) return 1;
+    
+    for (size_t i = 0; i < count; i++) {
+        bench_make_key(keys + i * BENCH_KEY_LEN, i, token);
+    }
+    
+    mpt_tree_t tree;
+    if (mpt_tree_init(&tree) != 0) return 1;
+    
+    uint8_t value[BENCH_VALUE_LEN];
+    memset(value, 0, sizeof(value));
+    
+    double start = bench_now_sec();
+    for (size_t i = 0; i < count; i++) {
+        memcpy(value, &i, sizeof(i));
+        if (mpt_tree_insert(&tree, keys + i * BENCH_KEY_LEN, BENCH_KEY_LEN,
+                            value, BENCH_VALUE_LEN) != 0) {
+            fprintf(stderr, "insert failed at %zu\n", i);
+            return 1;
+        }
+    }
+    bench_report("mpt_tree_insert", count, bench_now_sec() - start);
+    
+    start = bench_now_sec();
+    mpt_tree_commit(&tree);
+    bench_report("mpt_tree_commit", count, bench_now_sec() - start);
+    
+    thread_pool_t pool;
+    if (thread_pool_init(&pool, threads) != 0) return 1;
+    
+    mpt_tree_t parallel;
+    if (mpt_tree_init(&parallel) != 0) return 1;
+    mpt_tree_set_thread_pool(&parallel, &pool);
+    for (size_t i = 0; i < count; i++) {
+        memcpy(value, &i, sizeof(i));
+        mpt_tree_insert(&parallel, keys + i * BENCH_KEY_LEN, BENCH_KEY_LEN, value, BENCH_VALUE_LEN);
+    }
+    start = bench_now_sec();
+    mpt_tree_commit(&parallel);
+    bench_report("mpt_tree_commit (pool)", count, bench_now_sec() - start);
+    printf("threads=%zu root %s serial\n", threads,
+           memcmp(parallel.root_hash, tree.root_hash, MPT_NODE_HASH_SIZE) == 0 ? "matches" : "DIFFERS from");
+    mpt_tree_destroy(&parallel);
+    thread_pool_destroy(&pool);
+    
+    size_t update_count = count / 10;
+    start = bench_now_sec();
+    for (size_t i = 0; i < update_count; i++) {
+        size_t idx = (size_t)(bench_rand() % count);
+        memcpy(value, &i, sizeof(i));
+        mpt_tree_insert(&tree, keys + idx * BENCH_KEY_LEN, BENCH_KEY_LEN, value, BENCH_VALUE_LEN);
+    }
+    mpt_tree_commit(&tree);
+    bench_report("update+commit (10%)", update_count, bench_now_sec() - start);
+    
+    size_t backend_count = (count < BENCH_SPARSE_KEYS) ? count : BENCH_SPARSE_KEYS;
+    if (bench_backend_epochs("patricia", MPT_BACKEND_PATRICIA, keys, backend_count) != 0 ||
+        bench_backend_epochs("sparse", MPT_BACKEND_SPARSE, keys, backend_count) != 0) {
+        fprintf(stderr, "backend comparison failed\n");
+        return 1;
+    }
+    
+    if (bench_journal(keys, count) != 0) {
+        fprintf(stderr, "journal benchmark failed\n");
+        return 1;
+    }
+    
+    mpt_snapshot_t snapshot;
+    start = bench_now_sec();
+    mpt_tree_snapshot(&tree, &snapshot);
+    for (size_t i = 0; i < update_count; i++) {
+        size_t idx = (size_t)(bench_rand() % count);
+        memcpy(value, &i, sizeof(i));
+        mpt_tree_insert(&tree, keys + idx * BENCH_KEY_LEN, BENCH_KEY_LEN, value, BENCH_VALUE_LEN);
+    }
+    mpt_tree_rollback(&tree, &snapshot);
+    mpt_tree_snapshot_release(&tree, &snapshot);
+    bench_report("snapshot+update+rollback", update_count, bench_now_sec() - start);
+    
+    mpt_kv_t* items = (mpt_kv_t*)malloc(count * sizeof(mpt_kv_t));
+    uint8_t* values = (uint8_t*)malloc(count * BENCH_VALUE_LEN);
+    if (items == NULL || values == NULL) return 1;
+    
+    for (size_t i = 0; i < update_count; i++) {
+        size_t idx = (size_t)(bench_rand() % count);
+        memset(values + i * BENCH_VALUE_LEN, 0, BENCH_VALUE_LEN);
+        memcpy(values + i * BENCH_VALUE_LEN, &i, sizeof(i));
+        items[i].key = keys + idx * BENCH_KEY_LEN;
+        items[i].key_len = BENCH_KEY_LEN;
+        items[i].value = values + i * BENCH_VALUE_LEN;
+        items[i].value_len = BENCH_VALUE_LEN;
+    }
+    start = bench_now_sec();
+    if (mpt_tree_insert_batch(&tree, items, update_count) != 0) {
+        fprintf(stderr, "insert_batch failed\n");
+        return 1;
+    }
+    mpt_tree_commit(&tree);
+    bench_report("insert_batch+commit (10%)", update_count, bench_now_sec() - start);
+    
+    uint8_t* sorted_keys = (uint8_t*)malloc(count * BENCH_KEY_LEN);
+    if (sorted_keys == NULL) return 1;
+    memcpy(sorted_keys, keys, count * BENCH_KEY_LEN);
+    qsort(sorted_keys, count, BENCH_KEY_LEN, bench_key_compare);
+    
+    for (size_t i = 0; i < count; i++) {
+        memset(values + i * BENCH_VALUE_LEN, 0, BENCH_VALUE_LEN);
+        memcpy(values + i * BENCH_VALUE_LEN, &i, sizeof(i));
+        items[i].key = sorted_keys + i * BENCH_KEY_LEN;
+        items[i].key_len = BENCH_KEY_LEN;
+        items[i].value = values + i * BENCH_VALUE_LEN;
+        items[i].value_len = BENCH_VALUE_LEN;
+    }
+    mpt_tree_t built;
+    if (mpt_tree_init(&built) != 0) return 1;
+    start = bench_now_sec();
+    if (mpt_tree_build_sorted(&built, items, count) != 0) {
+        fprintf(stderr, "build_sorted failed\n");
+        return 1;
+    }
+    mpt_tree_commit(&built);
+    bench_report("build_sorted+commit", count, bench_now_sec() - start);
+    mpt_tree_destroy(&built);
+    free(sorted_keys);
+    free(values);
+    free(items);
+    
+    size_t* order = (size_t*)malloc(count * sizeof(size_t));
+    if (order == NULL) return 1;
+    for (size_t i = 0; i < count; i++) order[i] = i;
+    for (size_t i = count; i > 1; i--) {
+        size_t j = (size_t)(bench_rand() % i);
+        size_t tmp = order[i - 1];
+        order[i - 1] = order[j];
+        order[j] = tmp;
+    }
+    
+    size_t hits = 0;
+    start = bench_now_sec();
+    for (size_t i = 0; i < count; i++) {
+        size_t value_len = BENCH_VALUE_LEN;
+        if (mpt_tree_get(&tree, keys + order[i] * BENCH_KEY_LEN, BENCH_KEY_LEN,
+                         value, &value_len) == 0) {
+            hits++;
+        }
+    }
+    bench_report("mpt_tree_get", count, bench_now_sec() - start);
+    
+    mpt_lookup_t lookups[64];
+    uint8_t lookup_values[64][BENCH_VALUE_LEN];
+    size_t many_hits = 0;
+    start = bench_now_sec();
+    for (size_t i = 0; i < count; i += 64) {
+        size_t n = (count - i < 64) ? count - i : 64;
+        for (size_t j = 0; j < n; j++) {
+            lookups[j].key = keys + order[i + j] * BENCH_KEY_LEN;
+            lookups[j].key_len = BENCH_KEY_LEN;
+            lookups[j].value = lookup_values[j];
+            lookups[j].value_len = BENCH_VALUE_LEN;
+        }
+        mpt_tree_get_many(&tree, lookups, n);
+        for (size_t j = 0; j < n; j++) {
+            if (lookups[j].result == 0) many_hits++;
+        }
+    }
+    bench_report("mpt_tree_get_many", count, bench_now_sec() - start);
+    
+    mpt_rcu_t rcu;
+    if (mpt_rcu_init(&rcu) != 0 || mpt_tree_attach_rcu(&tree, &rcu) != 0) return 1;
+    size_t reader_count = (threads > 0) ? threads : 1;
+    bench_reader_t* readers = (bench_reader_t*)calloc(reader_count, sizeof(bench_reader_t));
+    pthread_t* reader_threads = (pthread_t*)calloc(reader_count, sizeof(pthread_t));
+    if (readers == NULL || reader_threads == NULL) return 1;
+    
+    size_t commits = 0;
+    start = bench_now_sec();
+    for (size_t t = 0; t < reader_count; t++) {
+        readers[t].tree = &tree;
+        readers[t].keys = keys;
+        readers[t].order = order;
+        readers[t].begin = count * t / reader_count;
+        readers[t].end = count * (t + 1) / reader_count;
+        pthread_create(&reader_threads[t], NULL, bench_reader_run, &readers[t]);
+    }
+    for (size_t i = 0; i < update_count; i++) {
+        size_t idx = (size_t)(bench_rand() % count);
+        memcpy(value, &i, sizeof(i));
+        mpt_tree_insert(&tree, keys + idx * BENCH_KEY_LEN, BENCH_KEY_LEN, value, BENCH_VALUE_LEN);
+        if ((i + 1) % 1000 == 0) {
+            mpt_tree_commit(&tree);
+            commits++;
+        }
+    }
+    mpt_tree_commit(&tree);
+    size_t read_hits = 0;
+    for (size_t t = 0; t < reader_count; t++) {
+        pthread_join(reader_threads[t], NULL);
+        read_hits += readers[t].hits;
+    }
+    bench_report("read_get during updates", count, bench_now_sec() - start);
+    printf("readers=%zu commits=%zu retired=%zu\n", reader_count, commits, tree.retired_count);
+    free(reader_threads);
+    free(readers);
+    
+    mpt_cursor_t cursor;
+    size_t scanned = 0;
+    start = bench_now_sec();
+    if (mpt_cursor_open(&cursor, &tree, NULL, 0) != 0) return 1;
+    {
+        const uint8_t* key;
+        const uint8_t* scan_value;
+        size_t key_len;
+        size_t scan_value_len;
+        while (mpt_cursor_next(&cursor, &key, &key_len, &scan_value, &scan_value_len) == 0) {
+            scanned++;
+        }
+    }
+    mpt_cursor_close(&cursor);
+    bench_report("cursor scan", scanned, bench_now_sec() - start);
+    
+    bench_buffer_t snapshot_buffer;
+    memset(&snapshot_buffer, 0, sizeof(snapshot_buffer));
+    start = bench_now_sec();
+    if (mpt_tree_export(&tree, bench_buffer_write, &snapshot_buffer) != 0) return 1;
+    bench_report("export", tree.size, bench_now_sec() - start);
+    
+    mpt_tree_t imported;
+    if (mpt_tree_init(&imported) != 0) return 1;
+    start = bench_now_sec();
+    if (mpt_tree_import(&imported, bench_buffer_read, &snapshot_buffer) != 0) return 1;
+    bench_report("import", imported.size, bench_now_sec() - start);
+    printf("snapshot bytes=%zu root %s\n", snapshot_buffer.len,
+           memcmp(imported.root_hash, tree.root_hash, MPT_NODE_HASH_SIZE) == 0 ? "matches" : "DIFFERS");
+    bool imported_ok = memcmp(imported.root_hash, tree.root_hash, MPT_NODE_HASH_SIZE) == 0;
+    
+    size_t diverged = (count < 100) ? count : 100;
+    for (size_t i = 0; i < diverged; i++) {
+        uint8_t diverged_value[BENCH_VALUE_LEN];
+        memset(diverged_value, 0xA5, sizeof(diverged_value));
+        if (mpt_tree_insert(&imported, keys + order[i] * BENCH_KEY_LEN, BENCH_KEY_LEN,
+                            diverged_value, sizeof(diverged_value)) != 0) return 1;
+    }
+    uint8_t remote_root[MPT_NODE_HASH_SIZE];
+    mpt_tree_get_root_hash(&imported, remote_root);
+    bench_remote_t remote;
+    memset(&remote, 0, sizeof(remote));
+    remote.tree = &imported;
+    start = bench_now_sec();
+    if (mpt_tree_diff(&tree, remote_root, bench_remote_fetch, &remote, bench_remote_diff, &remote) != 0) return 1;
+    bench_report("diff", diverged, bench_now_sec() - start);
+    printf("diffs=%zu fetches=%zu fetched bytes=%zu\n", remote.diffs, remote.fetches, remote.bytes);
+    mpt_tree_destroy(&imported);
+    free(snapshot_buffer.data);
+    
+    uint8_t root[MPT_NODE_HASH_SIZE];
+    mpt_tree_get_root_hash(&tree, root);
+    
+    size_t proof_count = (count < 1000) ? count : 1000;
+    const uint8_t** proof_keys = (const uint8_t**)malloc(proof_count * sizeof(const uint8_t*));
+    size_t* proof_key_lens = (size_t*)malloc(proof_count * sizeof(size_t));
+    if (proof_keys == NULL || proof_key_lens == NULL) return 1;
+    
+    size_t single_bytes = 0;
+    size_t verified = 0;
+    start = bench_now_sec();
+    for (size_t i = 0; i < proof_count; i++) {
+        proof_keys[i] = keys + order[i] * BENCH_KEY_LEN;
+        proof_key_lens[i] = BENCH_KEY_LEN;
+        mpt_proof_t proof;
+        if (mpt_tree_prove(&tree, proof_keys[i], BENCH_KEY_LEN, &proof) != 0) return 1;
+        single_bytes += proof.data_len;
+        bool exists = false;
+        if (mpt_tree_verify_proof(root, proof_keys[i], BENCH_KEY_LEN, &proof, &exists, NULL, NULL) == 0 && exists) {
+            verified++;
+        }
+        mpt_proof_free(&proof);
+    }
+    bench_report("prove+verify", proof_count, bench_now_sec() - start);
+    
+    mpt_proof_t multiproof;
+    start = bench_now_sec();
+    if (mpt_tree_prove_many(&tree, proof_keys, proof_key_lens, proof_count, &multiproof) != 0) return 1;
+    bench_report("prove_many", proof_count, bench_now_sec() - start);
+    printf("proofs verified=%zu single bytes=%zu multiproof bytes=%zu nodes=%zu\n",
+           verified, single_bytes, multiproof.data_len, multiproof.node_count);
+    mpt_proof_free(&multiproof);
+    free(proof_key_lens);
+    free(proof_keys);
+    
+    printf("keys=%zu hits=%zu root=", tree.size, hits);
+    for (size_t i = 0; i < 8; i++) printf("%02x", root[i]);
+    printf("...\n");
+    printf("arena slabs=%zu bytes_in_use=%zu bytes/key=%.1f\n",
+           tree.arena.slab_count, tree.arena.bytes_in_use,
+           (double)tree.arena.bytes_in_use / (double)tree.size);
+    
+    start = bench_now_sec();
+    mpt_tree_destroy(&tree);
+    mpt_rcu_destroy(&rcu);
+    bench_report("mpt_tree_destroy", count, bench_now_sec() - start);
+    
+    const char* store_path = "/tmp/mpt_tree_bench.store";
+    unlink(store_path);
+    mpt_store_t store;
+    mpt_tree_t stored;
+    if (mpt_store_open(&store, store_path) != 0) return 1;
+    if (mpt_tree_open(&stored, &store, count / 8) != 0) return 1;
+    start = bench_now_sec();
+    for (size_t i = 0; i < count; i++) {
+        memcpy(value, &i, sizeof(i));
+        mpt_tree_insert(&stored, keys + i * BENCH_KEY_LEN, BENCH_KEY_LEN, value, BENCH_VALUE_LEN);
+    }
+    if (mpt_tree_commit(&stored) != 0) return 1;
+    bench_report("store insert+commit", count, bench_now_sec() - start);
+    mpt_tree_destroy(&stored);
+    mpt_store_close(&store);
+    
+    start = bench_now_sec();
+    if (mpt_store_open(&store, store_path) != 0) return 1;
+    if (mpt_tree_open(&stored, &store, count / 8) != 0) return 1;
+    printf("store reopen %.3f s file bytes=%zu nodes=%zu\n",
+           bench_now_sec() - start, store.end, store.index_count);
+    
+    size_t store_hits = 0;
+    start = bench_now_sec();
+    for (size_t i = 0; i < count; i++) {
+        size_t value_len = BENCH_VALUE_LEN;
+        if (mpt_tree_get(&stored, keys + order[i] * BENCH_KEY_LEN, BENCH_KEY_LEN,
+                         value, &value_len) == 0) {
+            store_hits++;
+        }
+    }
+    bench_report("store get (cold)", count, bench_now_sec() - start);
+    printf("store hits=%zu cache hits=%zu misses=%zu resident bytes=%zu\n",
+           store_hits, stored.cache.hits, stored.cache.misses, stored.arena.bytes_in_use);
+    
+    if (mpt_tree_set_retention(&stored, 4) != 0) return 1;
+    size_t rounds = 200;
+    size_t per_round = update_count / 50;
+    size_t peak_end = 0;
+    start = bench_now_sec();
+    for (size_t r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < per_round; i++) {
+            size_t idx = (size_t)(bench_rand() % count);
+            memcpy(value, &r, sizeof(r));
+            mpt_tree_insert(&stored, keys + idx * BENCH_KEY_LEN, BENCH_KEY_LEN, value, BENCH_VALUE_LEN);
+        }
+        if (mpt_tree_commit(&stored) != 0) return 1;
+        if (store.end > peak_end) peak_end = store.end;
+    }
+    bench_report("store update+commit (K=4)", rounds * per_round, bench_now_sec() - start);
+    size_t retained = 0;
+    for (size_t i = 0; i < stored.version_count; i++) {
+        size_t value_len = BENCH_VALUE_LEN;
+        if (mpt_tree_get_at(&stored, stored.versions[i].root_hash, keys, BENCH_KEY_LEN,
+                            value, &value_len) == 0) {
+            retained++;
+        }
+    }
+    printf("store rounds=%zu file bytes=%zu peak=%zu nodes=%zu versions queryable=%zu/%zu\n",
+           rounds, store.end, peak_end, store.index_count, retained, stored.version_count);
+    mpt_tree_destroy(&stored);
+    mpt_store_close(&store);
+    unlink(store_path);
+    
+    free(order);
+    free(keys);
+    return (imported_ok && hits == count && many_hits == count && read_hits == count && store_hits == count) ? 0 : 1;
+}
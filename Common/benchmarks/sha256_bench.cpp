@@ -0,0 +1,152 @@
+#include "mpt_tree_common.h"
+#include "../platform/platform_crypto.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_SHA_BYTES (256 * 1024 * 1024)
+#define BENCH_MANY_COUNT 64
+
+typedef struct {
+    const char* message;
+    size_t repeat;
+    const char* digest;
+} bench_vector_t;
+
+static const bench_vector_t bench_vectors[] = {
+    { "", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 1,
+      "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" },
+    { "a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" }
+};
+
+static const char* bench_impl_names[] = { "scalar", "bmi2", "sha-ni" };
+
+static double bench_now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int bench_check_vectors(void) {
+    for (size_t v = 0; v < sizeof(bench_vectors) / sizeof(bench_vectors[0]); v++) {
+        size_t part = strlen(bench_vectors[v].message);
+        size_t len = part * bench_vectors[v].repeat;
+        uint8_t* message = (uint8_t*)malloc(len + 1);
+        if (message == NULL) return -1;
+        for (size_t i = 0; i < bench_vectors[v].repeat; i++) {
+            memcpy(message + i * part, bench_vectors[v].message, part);
+        }
+        
+        uint8_t hash[32];
+        char hex[65];
+        platform_sha256(message, len, hash);
+        for (size_t i = 0; i < 32; i++) {
+            snprintf(hex + 2 * i, 3, "%02x", hash[i]);
+        }
+        free(message);
+        
+        if (strcmp(hex, bench_vectors[v].digest) != 0) {
+            fprintf(stderr, "vector %zu mismatch: %s\n", v, hex);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void bench_throughput(const char* impl, size_t len) {
+    uint8_t* data = (uint8_t*)malloc(len);
+    if (data == NULL) return;
+    memset(data, 0x5A, len);
+    
+    uint8_t hash[32];
+    size_t iterations = BENCH_SHA_BYTES / len / 4;
+    double start = bench_now_sec();
+    for (size_t i = 0; i < iterations; i++) {
+        platform_sha256(data, len, hash);
+        data[0] = hash[0];
+    }
+    double seconds = bench_now_sec() - start;
+    printf("%-8s %6zu B %10zu ops %10.1f ns/op %10.1f MB/s\n",
+           impl, len, iterations, seconds * 1e9 / (double)iterations,
+           (double)(iterations * len) / seconds / 1e6);
+    free(data);
+}
+
+static int bench_many(size_t lanes, size_t len) {
+    uint8_t* data = (uint8_t*)malloc(BENCH_MANY_COUNT * len);
+    if (data == NULL) return -1;
+    for (size_t i = 0; i < BENCH_MANY_COUNT * len; i++) {
+        data[i] = (uint8_t)(i * 31 + 7);
+    }
+    
+    const uint8_t* messages[BENCH_MANY_COUNT];
+    size_t lens[BENCH_MANY_COUNT];
+    uint8_t hashes[BENCH_MANY_COUNT][32];
+    uint8_t* outputs[BENCH_MANY_COUNT];
+    for (size_t i = 0; i < BENCH_MANY_COUNT; i++) {
+        messages[i] = data + i * len;
+        lens[i] = len - i % 3;
+        outputs[i] = hashes[i];
+    }
+    
+    platform_sha256_many(messages, lens, outputs, BENCH_MANY_COUNT);
+    for (size_t i = 0; i < BENCH_MANY_COUNT; i++) {
+        uint8_t expected[32];
+        platform_sha256(messages[i], lens[i], expected);
+        if (memcmp(expected, hashes[i], 32) != 0) {
+            free(data);
+            return -1;
+        }
+    }
+    
+    size_t iterations = BENCH_SHA_BYTES / len / BENCH_MANY_COUNT / 4;
+    double start = bench_now_sec();
+    for (size_t i = 0; i < iterations; i++) {
+        platform_sha256_many(messages, lens, outputs, BENCH_MANY_COUNT);
+    }
+    double seconds = bench_now_sec() - start;
+    size_t messages_hashed = iterations * BENCH_MANY_COUNT;
+    printf("many x%-2zu %6zu B %10zu msgs %9.1f ns/msg %10.1f MB/s\n",
+           lanes, len, messages_hashed, seconds * 1e9 / (double)messages_hashed,
+           (double)(messages_hashed * len) / seconds / 1e6);
+    free(data);
+    return 0;
+}
+
+int main(void) {
+    printf("default implementation: %s\n", bench_impl_names[platform_sha256_get_impl()]);
+    
+    int failed = 0;
+    for (int impl = PLATFORM_SHA256_SCALAR; impl <= PLATFORM_SHA256_SHANI; impl++) {
+        if (platform_sha256_set_impl((platform_sha256_impl_t)impl) != 0) {
+            printf("%-8s unsupported on this CPU\n", bench_impl_names[impl]);
+            continue;
+        }
+        if (bench_check_vectors() != 0) {
+            printf("%-8s FAILED NIST vectors\n", bench_impl_names[impl]);
+            failed = 1;
+            continue;
+        }
+        bench_throughput(bench_impl_names[impl], 64);
+        bench_throughput(bench_impl_names[impl], 1024);
+    }
+    
+    printf("default lanes: %zu\n", platform_sha256_get_lanes());
+    size_t lane_options[] = { 1, 8, 16 };
+    for (size_t i = 0; i < sizeof(lane_options) / sizeof(lane_options[0]); i++) {
+        if (platform_sha256_set_lanes(lane_options[i]) != 0) {
+            printf("many x%-2zu unsupported on this CPU\n", lane_options[i]);
+            continue;
+        }
+        if (bench_many(lane_options[i], 64) != 0 || bench_many(lane_options[i], 1024) != 0) {
+            printf("many x%-2zu FAILED against single-buffer hashes\n", lane_options[i]);
+            failed = 1;
+        }
+    }
+    return failed;
+}
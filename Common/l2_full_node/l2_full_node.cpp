@@ -1,13 +1,9 @@
 #include "l2_full_node.h"
 #include "../mpt_tree/mpt_tree_common.h"
+#include "../platform/platform_alloc.h"
 #include <string.h>
 #include <stdlib.h>
 
-#ifndef platform_malloc
-#define platform_malloc malloc
-#define platform_free free
-#endif
-
 int l2_full_node_init(l2_full_node_state_t* node) {
     if (node == NULL) return -1;
     
@@ -19,7 +15,52 @@ int l2_full_node_init(l2_full_node_state_t* node) {
         node->latest_block_numbers[i] = 0;
         node->block_counts[i] = 0;
     }
+    node->block_limit = MAX_BLOCK_HEADERS;
+    node->cache_limit = MAX_VERIFICATION_CACHE;
+    
+    return 0;
+}
+
+void l2_full_node_destroy(l2_full_node_state_t* node) {
+    if (node == NULL) return;
+    
+    for (size_t i = 0; i < MAX_L2_CHAINS; i++) {
+        if (node->block_headers[i]) platform_free(node->block_headers[i]);
+    }
+    if (node->verification_cache) platform_free(node->verification_cache);
+    memset(node, 0, sizeof(l2_full_node_state_t));
+}
+
+int l2_full_node_set_limits(l2_full_node_state_t* node, size_t block_limit, size_t cache_limit) {
+    if (node == NULL || cache_limit < node->cache_count) return -1;
     
+    for (size_t i = 0; i < MAX_L2_CHAINS; i++) {
+        if (block_limit < node->block_counts[i]) return -1;
+    }
+    node->block_limit = block_limit;
+    node->cache_limit = cache_limit;
+    return 0;
+}
+
+static int l2_full_node_reserve_headers(l2_full_node_state_t* node, uint32_t chain_id, size_t needed) {
+    void* headers = node->block_headers[chain_id];
+    if (platform_array_reserve(&headers, &node->block_capacity[chain_id], needed,
+                               sizeof(l2_block_header_t), L2_BLOCK_HEADERS_INITIAL,
+                               node->block_limit) != 0) {
+        return -1;
+    }
+    node->block_headers[chain_id] = (l2_block_header_t*)headers;
+    return 0;
+}
+
+static int l2_full_node_reserve_cache(l2_full_node_state_t* node, size_t needed) {
+    void* cache = node->verification_cache;
+    if (platform_array_reserve(&cache, &node->cache_capacity, needed,
+                               sizeof(l2_verification_cache_entry_t), L2_VERIFICATION_CACHE_INITIAL,
+                               node->cache_limit) != 0) {
+        return -1;
+    }
+    node->verification_cache = (l2_verification_cache_entry_t*)cache;
     return 0;
 }
 
@@ -31,7 +72,9 @@ int l2_full_node_sync_block_headers(l2_full_node_state_t* node,
     if (from_block > to_block) return -1;
     
     
-    if (node->block_counts[chain_id] + (to_block - from_block + 1) > MAX_BLOCK_HEADERS) {
+    if (to_block - from_block >= node->block_limit ||
+        l2_full_node_reserve_headers(node, chain_id,
+                                     node->block_counts[chain_id] + (to_block - from_block + 1)) != 0) {
         return -1;  
     }
     
@@ -43,7 +86,7 @@ int l2_full_node_sync_block_headers(l2_full_node_state_t* node,
     
     for (uint64_t block_num = from_block; block_num <= to_block; block_num++) {
         size_t idx = node->block_counts[chain_id];
-        if (idx >= MAX_BLOCK_HEADERS) break;
+        if (idx >= node->block_capacity[chain_id]) break;
         
         l2_block_header_t* header = &node->block_headers[chain_id][idx];
         memset(header, 0, sizeof(l2_block_header_t));
@@ -87,31 +130,18 @@ int l2_full_node_sync_block_headers(l2_full_node_state_t* node,
 void l2_full_node_compute_log_hash(const l2_log_entry_t* log, uint8_t* hash) {
     if (log == NULL || hash == NULL) return;
     
-    
-    uint8_t buffer[1024];
-    size_t offset = 0;
-    
-    
-    memcpy(buffer + offset, log->tx_hash, 32);
-    offset += 32;
-    
-    uint32_t log_index_bytes[1] = {log->log_index};
-    memcpy(buffer + offset, log_index_bytes, 4);
-    offset += 4;
-    
-    memcpy(buffer + offset, log->contract_address, 20);
-    offset += 20;
+    platform_sha256_ctx_t ctx;
+    platform_sha256_init(&ctx);
+    platform_sha256_update(&ctx, log->tx_hash, 32);
+    platform_sha256_update(&ctx, (const uint8_t*)&log->log_index, 4);
+    platform_sha256_update(&ctx, log->contract_address, 20);
     
     for (size_t i = 0; i < log->topic_count && i < 4; i++) {
-        memcpy(buffer + offset, log->topics[i], 32);
-        offset += 32;
+        platform_sha256_update(&ctx, log->topics[i], 32);
     }
     
-    memcpy(buffer + offset, log->data, log->data_len);
-    offset += log->data_len;
-    
-    
-    platform_sha256(buffer, offset, hash);
+    platform_sha256_update(&ctx, log->data, log->data_len);
+    platform_sha256_final(&ctx, hash);
 }
 
 bool l2_full_node_verify_merkle_proof(const uint8_t* leaf_hash,
@@ -141,11 +171,59 @@ bool l2_full_node_verify_merkle_proof(const uint8_t* leaf_hash,
     return memcmp(computed_hash, proof->receipts_root, 32) == 0;
 }
 
-bool l2_full_node_verify_log_existence(l2_full_node_state_t* node,
-                                       const l2_log_entry_t* log,
-                                       const log_existence_proof_t* proof) {
-    if (node == NULL || log == NULL || proof == NULL) return false;
-    
+void l2_full_node_verify_merkle_proofs(const uint8_t* const* leaf_hashes,
+                                       const log_existence_proof_t* const* proofs,
+                                       size_t count, bool* results) {
+    if (leaf_hashes == NULL || proofs == NULL || results == NULL) return;
+    
+    for (size_t base = 0; base < count; base += L2_VERIFY_LANES) {
+        size_t batch = (count - base < L2_VERIFY_LANES) ? count - base : L2_VERIFY_LANES;
+        uint8_t computed[L2_VERIFY_LANES][32];
+        size_t levels = 0;
+        for (size_t j = 0; j < batch; j++) {
+            memcpy(computed[j], leaf_hashes[base + j], 32);
+            size_t length = proofs[base + j]->proof_length < 32 ? proofs[base + j]->proof_length : 32;
+            if (length > levels) levels = length;
+        }
+        
+        for (size_t i = 0; i < levels; i++) {
+            uint8_t buffers[L2_VERIFY_LANES][64];
+            const uint8_t* data[L2_VERIFY_LANES];
+            size_t lens[L2_VERIFY_LANES];
+            uint8_t* hashes[L2_VERIFY_LANES];
+            size_t lanes = 0;
+            
+            for (size_t j = 0; j < batch; j++) {
+                const log_existence_proof_t* proof = proofs[base + j];
+                if (i >= proof->proof_length) continue;
+                
+                if (memcmp(computed[j], proof->proof[i], 32) < 0) {
+                    memcpy(buffers[lanes], computed[j], 32);
+                    memcpy(buffers[lanes] + 32, proof->proof[i], 32);
+                } else {
+                    memcpy(buffers[lanes], proof->proof[i], 32);
+                    memcpy(buffers[lanes] + 32, computed[j], 32);
+                }
+                data[lanes] = buffers[lanes];
+                lens[lanes] = 64;
+                hashes[lanes] = computed[j];
+                lanes++;
+            }
+            
+            platform_sha256_many(data, lens, hashes, lanes);
+        }
+        
+        for (size_t j = 0; j < batch; j++) {
+            results[base + j] = memcmp(computed[j], proofs[base + j]->receipts_root, 32) == 0;
+        }
+    }
+}
+
+static bool l2_full_node_prepare_log(l2_full_node_state_t* node,
+                                     const l2_log_entry_t* log,
+                                     const log_existence_proof_t* proof,
+                                     uint8_t* log_hash) {
+    if (log->chain_id >= MAX_L2_CHAINS) return false;
     
     l2_block_header_t* header = NULL;
     for (size_t i = 0; i < node->block_counts[log->chain_id]; i++) {
@@ -165,14 +243,66 @@ bool l2_full_node_verify_log_existence(l2_full_node_state_t* node,
         return false;
     }
     
+    l2_full_node_compute_log_hash(log, log_hash);
+    return true;
+}
+
+bool l2_full_node_verify_log_existence(l2_full_node_state_t* node,
+                                       const l2_log_entry_t* log,
+                                       const log_existence_proof_t* proof) {
+    if (node == NULL || log == NULL || proof == NULL) return false;
     
     uint8_t log_hash[32];
-    l2_full_node_compute_log_hash(log, log_hash);
+    if (!l2_full_node_prepare_log(node, log, proof, log_hash)) return false;
     
     
     return l2_full_node_verify_merkle_proof(log_hash, proof);
 }
 
+typedef struct {
+    size_t index[L2_VERIFY_LANES];
+    bool prepared[L2_VERIFY_LANES];
+    uint8_t log_hashes[L2_VERIFY_LANES][32];
+    size_t count;
+} l2_verify_batch_t;
+
+static void l2_full_node_flush_batch(l2_full_node_state_t* node,
+                                     const l2_log_entry_t* logs,
+                                     const log_existence_proof_t* proofs,
+                                     bool* verification_results,
+                                     l2_verify_batch_t* batch) {
+    const uint8_t* leaf_hashes[L2_VERIFY_LANES];
+    const log_existence_proof_t* batch_proofs[L2_VERIFY_LANES];
+    bool batch_results[L2_VERIFY_LANES];
+    size_t prepared = 0;
+    
+    for (size_t k = 0; k < batch->count; k++) {
+        if (!batch->prepared[k]) continue;
+        leaf_hashes[prepared] = batch->log_hashes[k];
+        batch_proofs[prepared] = &proofs[batch->index[k]];
+        prepared++;
+    }
+    l2_full_node_verify_merkle_proofs(leaf_hashes, batch_proofs, prepared, batch_results);
+    
+    prepared = 0;
+    for (size_t k = 0; k < batch->count; k++) {
+        size_t i = batch->index[k];
+        verification_results[i] = batch->prepared[k] && batch_results[prepared++];
+        
+        
+        if (l2_full_node_reserve_cache(node, node->cache_count + 1) == 0) {
+            memcpy(node->verification_cache[node->cache_count].tx_hash, 
+                   logs[i].tx_hash, 32);
+            memcpy(&node->verification_cache[node->cache_count].proof, 
+                   &proofs[i], sizeof(log_existence_proof_t));
+            node->verification_cache[node->cache_count].is_verified = verification_results[i];
+            node->verification_cache[node->cache_count].verified_by_tee = 0;  
+            node->cache_count++;
+        }
+    }
+    batch->count = 0;
+}
+
 int l2_full_node_distributed_verify_logs(l2_full_node_state_t* node,
                                          const l2_log_entry_t* logs,
                                          size_t log_count,
@@ -189,10 +319,19 @@ int l2_full_node_distributed_verify_logs(l2_full_node_state_t* node,
     }
     
     
+    l2_verify_batch_t batch;
+    batch.count = 0;
+    
     for (size_t i = 0; i < log_count; i++) {
+        for (size_t k = 0; k < batch.count; k++) {
+            if (memcmp(logs[batch.index[k]].tx_hash, logs[i].tx_hash, 32) == 0) {
+                l2_full_node_flush_batch(node, logs, proofs, verification_results, &batch);
+                break;
+            }
+        }
         
         bool found_in_cache = false;
-        for (size_t j = 0; j < node->cache_count && j < 10000; j++) {
+        for (size_t j = 0; j < node->cache_count; j++) {
             if (memcmp(node->verification_cache[j].tx_hash, logs[i].tx_hash, 32) == 0) {
                 if (node->verification_cache[j].is_verified) {
                     verification_results[i] = true;
@@ -206,23 +345,20 @@ int l2_full_node_distributed_verify_logs(l2_full_node_state_t* node,
         }
         
         if (!found_in_cache) {
-            
-            verification_results[i] = l2_full_node_verify_log_existence(
-                node, &logs[i], &proofs[i]);
-            
-            
-            if (node->cache_count < 10000) {
-                memcpy(node->verification_cache[node->cache_count].tx_hash, 
-                       logs[i].tx_hash, 32);
-                memcpy(&node->verification_cache[node->cache_count].proof, 
-                       &proofs[i], sizeof(log_existence_proof_t));
-                node->verification_cache[node->cache_count].is_verified = verification_results[i];
-                node->verification_cache[node->cache_count].verified_by_tee = 0;  
-                node->cache_count++;
+            batch.index[batch.count] = i;
+            batch.prepared[batch.count] = l2_full_node_prepare_log(node, &logs[i], &proofs[i],
+                                                                   batch.log_hashes[batch.count]);
+            batch.count++;
+            if (batch.count == L2_VERIFY_LANES) {
+                l2_full_node_flush_batch(node, logs, proofs, verification_results, &batch);
             }
         }
     }
     
+    if (batch.count > 0) {
+        l2_full_node_flush_batch(node, logs, proofs, verification_results, &batch);
+    }
+    
     return 0;
 }
 
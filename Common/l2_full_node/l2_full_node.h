@@ -7,7 +7,11 @@
 
 #define MAX_L2_CHAINS 16
 #define MAX_BLOCK_HEADERS 10000
+#define MAX_VERIFICATION_CACHE 10000
+#define L2_BLOCK_HEADERS_INITIAL 64
+#define L2_VERIFICATION_CACHE_INITIAL 64
 #define MAX_LOG_ENTRIES_PER_BLOCK 1000
+#define L2_VERIFY_LANES 16
 
 typedef struct {
     uint64_t block_number;
@@ -39,10 +43,19 @@ typedef struct {
     uint8_t receipts_root[32];  
 } log_existence_proof_t;
 
+typedef struct {
+    uint8_t tx_hash[32];
+    log_existence_proof_t proof;
+    bool is_verified;
+    uint32_t verified_by_tee;  
+} l2_verification_cache_entry_t;
+
 typedef struct {
     
-    l2_block_header_t block_headers[MAX_L2_CHAINS][MAX_BLOCK_HEADERS];
+    l2_block_header_t* block_headers[MAX_L2_CHAINS];
     size_t block_counts[MAX_L2_CHAINS];
+    size_t block_capacity[MAX_L2_CHAINS];
+    size_t block_limit;
     uint64_t latest_block_numbers[MAX_L2_CHAINS];
     
     
@@ -51,17 +64,18 @@ typedef struct {
     uint64_t sync_end_block[MAX_L2_CHAINS];
     
     
-    struct {
-        uint8_t tx_hash[32];
-        log_existence_proof_t proof;
-        bool is_verified;
-        uint32_t verified_by_tee;  
-    } verification_cache[10000];
+    l2_verification_cache_entry_t* verification_cache;
     size_t cache_count;
+    size_t cache_capacity;
+    size_t cache_limit;
 } l2_full_node_state_t;
 
 int l2_full_node_init(l2_full_node_state_t* node);
 
+void l2_full_node_destroy(l2_full_node_state_t* node);
+
+int l2_full_node_set_limits(l2_full_node_state_t* node, size_t block_limit, size_t cache_limit);
+
 int l2_full_node_sync_block_headers(l2_full_node_state_t* node,
                                     uint32_t chain_id,
                                     uint64_t from_block,
@@ -88,4 +102,8 @@ void l2_full_node_compute_log_hash(const l2_log_entry_t* log, uint8_t* hash);
 bool l2_full_node_verify_merkle_proof(const uint8_t* leaf_hash,
                                        const log_existence_proof_t* proof);
 
+void l2_full_node_verify_merkle_proofs(const uint8_t* const* leaf_hashes,
+                                       const log_existence_proof_t* const* proofs,
+                                       size_t count, bool* results);
+
 #endif
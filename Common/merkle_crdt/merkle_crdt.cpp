@@ -1,5 +1,6 @@
 #include "merkle_crdt.h"
 #include "../mpt_tree/mpt_tree_common.h"
+#include "../platform/platform_alloc.h"
 #include <string.h>
 #include <stdlib.h>
 #include <vector>
@@ -11,23 +12,15 @@
 static void operation_hash(const operation_t* op, uint8_t* hash) {
     if (op == NULL || hash == NULL) return;
     
-    uint8_t buffer[512];
-    size_t offset = 0;
-    
-    memcpy(buffer + offset, &op->operation_id, sizeof(uint64_t));
-    offset += sizeof(uint64_t);
-    memcpy(buffer + offset, &op->tx_id, sizeof(uint64_t));
-    offset += sizeof(uint64_t);
-    memcpy(buffer + offset, &op->type, sizeof(operation_type_t));
-    offset += sizeof(operation_type_t);
-    memcpy(buffer + offset, op->token_address, 42);
-    offset += 42;
-    memcpy(buffer + offset, op->account, 20);
-    offset += 20;
-    memcpy(buffer + offset, op->amount, 32);
-    offset += 32;
-    
-    platform_sha256(buffer, offset, (uint8_t*)hash);
+    platform_sha256_ctx_t ctx;
+    platform_sha256_init(&ctx);
+    platform_sha256_update(&ctx, (const uint8_t*)&op->operation_id, sizeof(uint64_t));
+    platform_sha256_update(&ctx, (const uint8_t*)&op->tx_id, sizeof(uint64_t));
+    platform_sha256_update(&ctx, (const uint8_t*)&op->type, sizeof(operation_type_t));
+    platform_sha256_update(&ctx, op->token_address, 42);
+    platform_sha256_update(&ctx, op->account, 20);
+    platform_sha256_update(&ctx, op->amount, 32);
+    platform_sha256_final(&ctx, hash);
 }
 
 static uint32_t conflict_index_hash(const uint8_t* account, const uint8_t* token) {
@@ -45,18 +38,103 @@ static uint32_t conflict_index_hash(const uint8_t* account, const uint8_t* token
 }
 
 int merkle_crdt_init(merkle_crdt_dag_t* dag) {
+    return merkle_crdt_init_alloc(dag, NULL, NULL);
+}
+
+int merkle_crdt_init_alloc(merkle_crdt_dag_t* dag,
+                           struct platform_alloc* node_alloc,
+                           struct platform_alloc* index_alloc) {
     if (dag == NULL) return -1;
     
     memset(dag, 0, sizeof(merkle_crdt_dag_t));
     dag->head = NULL;
+    dag->node_limit = MAX_DAG_NODES;
+    dag->node_alloc = node_alloc;
+    dag->index_alloc = index_alloc;
+    
+    return 0;
+}
+
+int merkle_crdt_set_node_limit(merkle_crdt_dag_t* dag, size_t limit) {
+    if (dag == NULL || limit < dag->node_count) return -1;
     
+    dag->node_limit = limit;
     return 0;
 }
 
-static dag_node_t* dag_node_create(const operation_t* op) {
+static int merkle_crdt_reserve(merkle_crdt_dag_t* dag, size_t needed) {
+    void* nodes = dag->nodes;
+    void* ids = dag->node_id_map;
+    int rc = platform_array_reserve(&nodes, &dag->node_capacity, needed, sizeof(dag_node_t*),
+                                    DAG_NODES_INITIAL, dag->node_limit);
+    if (rc == 0) {
+        rc = platform_array_reserve(&ids, &dag->node_id_capacity, needed, sizeof(uint64_t),
+                                    DAG_NODES_INITIAL, dag->node_limit);
+    }
+    dag->nodes = (dag_node_t**)nodes;
+    dag->node_id_map = (uint64_t*)ids;
+    return rc;
+}
+
+int merkle_crdt_push_latest(merkle_crdt_dag_t* dag, dag_node_t* node) {
+    if (dag == NULL || node == NULL) return -1;
+    
+    void* latest = dag->latest_nodes;
+    int rc = platform_array_reserve(&latest, &dag->latest_capacity, dag->latest_count + 1,
+                                    sizeof(dag_node_t*), DAG_NODES_INITIAL, dag->node_limit);
+    dag->latest_nodes = (dag_node_t**)latest;
+    if (rc != 0) return -1;
+    
+    dag->latest_nodes[dag->latest_count++] = node;
+    return 0;
+}
+
+void merkle_crdt_reset(merkle_crdt_dag_t* dag) {
+    if (dag == NULL) return;
+    
+    if (platform_alloc_can_reset(dag->index_alloc)) {
+        platform_alloc_reset(dag->index_alloc);
+    } else {
+        for (size_t i = 0; i < CONFLICT_INDEX_SIZE; i++) {
+            conflict_index_entry_t* entry = dag->conflict_index[i];
+            while (entry != NULL) {
+                conflict_index_entry_t* next = entry->next;
+                platform_alloc_free(dag->index_alloc, entry);
+                entry = next;
+            }
+        }
+    }
+    
+    if (platform_alloc_can_reset(dag->node_alloc)) {
+        platform_alloc_reset(dag->node_alloc);
+    } else {
+        for (size_t i = 0; i < dag->node_count; i++) {
+            platform_alloc_free(dag->node_alloc, dag->nodes[i]);
+        }
+        platform_alloc_free(dag->node_alloc, dag->head);
+    }
+    
+    memset(dag->conflict_index, 0, sizeof(dag->conflict_index));
+    dag->node_count = 0;
+    dag->latest_count = 0;
+    dag->head = NULL;
+    memset(dag->head_hash, 0, sizeof(dag->head_hash));
+}
+
+void merkle_crdt_destroy(merkle_crdt_dag_t* dag) {
+    if (dag == NULL) return;
+    
+    merkle_crdt_reset(dag);
+    if (dag->nodes) platform_free(dag->nodes);
+    if (dag->latest_nodes) platform_free(dag->latest_nodes);
+    if (dag->node_id_map) platform_free(dag->node_id_map);
+    memset(dag, 0, sizeof(merkle_crdt_dag_t));
+}
+
+static dag_node_t* dag_node_create(merkle_crdt_dag_t* dag, const operation_t* op) {
     if (op == NULL) return NULL;
     
-    dag_node_t* node = (dag_node_t*)platform_malloc(sizeof(dag_node_t));
+    dag_node_t* node = (dag_node_t*)platform_alloc(dag->node_alloc, sizeof(dag_node_t));
     if (node == NULL) return NULL;
     
     memset(node, 0, sizeof(dag_node_t));
@@ -99,10 +177,10 @@ bool merkle_crdt_is_conflict(const operation_t* op1, const operation_t* op2) {
 int merkle_crdt_add_operation(merkle_crdt_dag_t* dag, const operation_t* op, uint64_t tx_sort_order) {
     if (dag == NULL || op == NULL) return -1;
     
-    if (dag->node_count >= MAX_DAG_NODES) return -1;
+    if (merkle_crdt_reserve(dag, dag->node_count + 1) != 0) return -1;
     
     
-    dag_node_t* new_node = dag_node_create(op);
+    dag_node_t* new_node = dag_node_create(dag, op);
     if (new_node == NULL) return -1;
     
     
@@ -114,9 +192,7 @@ int merkle_crdt_add_operation(merkle_crdt_dag_t* dag, const operation_t* op, uin
     dag->node_count++;
     
     
-    if (dag->latest_count < MAX_DAG_NODES) {
-        dag->latest_nodes[dag->latest_count++] = new_node;
-    }
+    merkle_crdt_push_latest(dag, new_node);
     
     
     uint32_t hash = conflict_index_hash(op->account, op->token_address);
@@ -147,7 +223,7 @@ int merkle_crdt_add_operation(merkle_crdt_dag_t* dag, const operation_t* op, uin
     
     
     if (op->type == OP_SUBTRACT || op->type == OP_ADD) {
-        conflict_index_entry_t* new_entry = (conflict_index_entry_t*)platform_malloc(sizeof(conflict_index_entry_t));
+        conflict_index_entry_t* new_entry = (conflict_index_entry_t*)platform_alloc(dag->index_alloc, sizeof(conflict_index_entry_t));
         if (new_entry != NULL) {
             new_entry->node = new_node;
             new_entry->next = dag->conflict_index[hash];
@@ -237,7 +313,7 @@ int merkle_crdt_update_parent_states(merkle_crdt_dag_t* dag,
         
         if (!parent->state_updated) {
             
-            uint8_t key[64];
+            uint8_t key[64] = {0};
             memcpy(key, parent->operation.account, 20);
             memcpy(key + 20, parent->operation.token_address, 42);
             
@@ -323,26 +399,21 @@ int merkle_crdt_connect_neighbors(merkle_crdt_dag_t* dag,
 void merkle_crdt_node_hash(dag_node_t* node, uint8_t* hash) {
     if (node == NULL || hash == NULL) return;
     
-    uint8_t buffer[2048];
-    size_t offset = 0;
-    
-    
-    memcpy(buffer + offset, node->operation.hash, 32);
-    offset += 32;
+    platform_sha256_ctx_t ctx;
+    platform_sha256_init(&ctx);
+    platform_sha256_update(&ctx, node->operation.hash, 32);
     
     
     for (size_t i = 0; i < node->parent_count; i++) {
-        memcpy(buffer + offset, node->parents[i]->merkle_hash, 32);
-        offset += 32;
+        platform_sha256_update(&ctx, node->parents[i]->merkle_hash, 32);
     }
     
     
     for (size_t i = 0; i < node->child_count; i++) {
-        memcpy(buffer + offset, node->children[i]->merkle_hash, 32);
-        offset += 32;
+        platform_sha256_update(&ctx, node->children[i]->merkle_hash, 32);
     }
     
-    platform_sha256(buffer, offset, hash);
+    platform_sha256_final(&ctx, hash);
 }
 
 int merkle_crdt_generate_head(merkle_crdt_dag_t* dag) {
@@ -350,7 +421,7 @@ int merkle_crdt_generate_head(merkle_crdt_dag_t* dag) {
     
     
     if (dag->head == NULL) {
-        dag->head = (dag_node_t*)platform_malloc(sizeof(dag_node_t));
+        dag->head = (dag_node_t*)platform_alloc(dag->node_alloc, sizeof(dag_node_t));
         if (dag->head == NULL) return -1;
         memset(dag->head, 0, sizeof(dag_node_t));
         dag->head->node_id = UINT64_MAX; 
@@ -403,6 +474,10 @@ int merkle_crdt_update_state(merkle_crdt_dag_t* dag, mpt_tree_t* token_tree) {
     
     if (dag->head == NULL) return -1;
     
+    uint8_t keys[MAX_CHILDREN][64];
+    uint8_t balances[MAX_CHILDREN][32];
+    mpt_kv_t updates[MAX_CHILDREN];
+    size_t update_count = 0;
     
     for (size_t i = 0; i < dag->head->child_count; i++) {
         dag_node_t* node = dag->head->children[i];
@@ -410,14 +485,27 @@ int merkle_crdt_update_state(merkle_crdt_dag_t* dag, mpt_tree_t* token_tree) {
         if (node->state_updated) continue;
         
         
-        uint8_t key[64];
+        uint8_t key[64] = {0};
         memcpy(key, node->operation.account, 20);
         memcpy(key + 20, node->operation.token_address, 42);
         
         
         uint8_t current_balance[32];
         size_t balance_len = 32;
-        int ret = mpt_tree_get(token_tree, key, 64, current_balance, &balance_len);
+        int ret = -1;
+        size_t slot = update_count;
+        for (size_t j = 0; j < update_count; j++) {
+            if (memcmp(keys[j], key, 64) == 0) {
+                slot = j;
+                break;
+            }
+        }
+        if (slot < update_count) {
+            memcpy(current_balance, balances[slot], 32);
+            ret = 0;
+        } else {
+            ret = mpt_tree_get(token_tree, key, 64, current_balance, &balance_len);
+        }
         
         uint8_t new_balance[32];
         memset(new_balance, 0, 32);
@@ -465,12 +553,20 @@ int merkle_crdt_update_state(merkle_crdt_dag_t* dag, mpt_tree_t* token_tree) {
         }
         
         
-        mpt_tree_insert(token_tree, key, 64, new_balance, 32);
+        if (slot == update_count) {
+            memcpy(keys[slot], key, 64);
+            updates[slot].key = keys[slot];
+            updates[slot].key_len = 64;
+            updates[slot].value = balances[slot];
+            updates[slot].value_len = 32;
+            update_count++;
+        }
+        memcpy(balances[slot], new_balance, 32);
         node->state_updated = true;
         node->is_processed = true;
     }
     
-    return 0;
+    return mpt_tree_insert_batch(token_tree, updates, update_count);
 }
 
 bool merkle_crdt_validate_tx(const operation_t* operations, size_t op_count,
@@ -484,13 +580,14 @@ bool merkle_crdt_validate_tx(const operation_t* operations, size_t op_count,
         uint8_t balance[32];
         bool exists;
     } temp_balances[100];
+    mpt_lookup_t lookups[100];
     size_t temp_count = 0;
     
     
     for (size_t i = 0; i < op_count; i++) {
         const operation_t* op = &operations[i];
         
-        uint8_t key[64];
+        uint8_t key[64] = {0};
         memcpy(key, op->account, 20);
         memcpy(key + 20, op->token_address, 42);
         
@@ -505,22 +602,27 @@ bool merkle_crdt_validate_tx(const operation_t* operations, size_t op_count,
         
         if (!found && temp_count < 100) {
             memcpy(temp_balances[temp_count].key, key, 64);
-            size_t balance_len = 32;
-            if (mpt_tree_get(token_tree, key, 64, temp_balances[temp_count].balance, &balance_len) == 0) {
-                temp_balances[temp_count].exists = true;
-            } else {
-                memset(temp_balances[temp_count].balance, 0, 32);
-                temp_balances[temp_count].exists = false;
-            }
+            lookups[temp_count].key = temp_balances[temp_count].key;
+            lookups[temp_count].key_len = 64;
+            lookups[temp_count].value = temp_balances[temp_count].balance;
+            lookups[temp_count].value_len = 32;
             temp_count++;
         }
     }
     
+    if (temp_count > 0 && mpt_tree_get_many(token_tree, lookups, temp_count) != 0) return false;
+    for (size_t j = 0; j < temp_count; j++) {
+        temp_balances[j].exists = (lookups[j].result == 0);
+        if (!temp_balances[j].exists) {
+            memset(temp_balances[j].balance, 0, 32);
+        }
+    }
+    
     
     for (size_t i = 0; i < op_count; i++) {
         const operation_t* op = &operations[i];
         
-        uint8_t key[64];
+        uint8_t key[64] = {0};
         memcpy(key, op->account, 20);
         memcpy(key + 20, op->token_address, 42);
         
@@ -630,13 +732,14 @@ bool merkle_crdt_check_operation_failed(merkle_crdt_dag_t* dag,
         uint8_t balance[32];
         bool exists;
     } temp_balances[100];
+    mpt_lookup_t lookups[100];
     size_t temp_count = 0;
     
     
     for (size_t i = 0; i < tx_op_count; i++) {
         const operation_t* op = &tx_operations[i];
         
-        uint8_t key[64];
+        uint8_t key[64] = {0};
         memcpy(key, op->account, 20);
         memcpy(key + 20, op->token_address, 42);
         
@@ -651,22 +754,27 @@ bool merkle_crdt_check_operation_failed(merkle_crdt_dag_t* dag,
         
         if (!found && temp_count < 100) {
             memcpy(temp_balances[temp_count].key, key, 64);
-            size_t balance_len = 32;
-            if (mpt_tree_get(token_tree, key, 64, temp_balances[temp_count].balance, &balance_len) == 0) {
-                temp_balances[temp_count].exists = true;
-            } else {
-                memset(temp_balances[temp_count].balance, 0, 32);
-                temp_balances[temp_count].exists = false;
-            }
+            lookups[temp_count].key = temp_balances[temp_count].key;
+            lookups[temp_count].key_len = 64;
+            lookups[temp_count].value = temp_balances[temp_count].balance;
+            lookups[temp_count].value_len = 32;
             temp_count++;
         }
     }
     
+    if (temp_count > 0 && mpt_tree_get_many(token_tree, lookups, temp_count) != 0) return false;
+    for (size_t j = 0; j < temp_count; j++) {
+        temp_balances[j].exists = (lookups[j].result == 0);
+        if (!temp_balances[j].exists) {
+            memset(temp_balances[j].balance, 0, 32);
+        }
+    }
+    
     
     for (size_t i = 0; i < tx_op_count; i++) {
         const operation_t* op = &tx_operations[i];
         
-        uint8_t key[64];
+        uint8_t key[64] = {0};
         memcpy(key, op->account, 20);
         memcpy(key + 20, op->token_address, 42);
         
@@ -830,21 +938,7 @@ int merkle_crdt_create_reverse_operation(const operation_t* original_op,
     }
     
     
-    uint8_t buffer[512];
-    size_t offset = 0;
-    memcpy(buffer + offset, &reverse_op->operation_id, sizeof(uint64_t));
-    offset += sizeof(uint64_t);
-    memcpy(buffer + offset, &reverse_op->tx_id, sizeof(uint64_t));
-    offset += sizeof(uint64_t);
-    memcpy(buffer + offset, &reverse_op->type, sizeof(operation_type_t));
-    offset += sizeof(operation_type_t);
-    memcpy(buffer + offset, reverse_op->token_address, 42);
-    offset += 42;
-    memcpy(buffer + offset, reverse_op->account, 20);
-    offset += 20;
-    memcpy(buffer + offset, reverse_op->amount, 32);
-    offset += 32;
-    platform_sha256(buffer, offset, reverse_op->hash);
+    operation_hash(reverse_op, reverse_op->hash);
     
     return 0;
 }
@@ -9,6 +9,7 @@
 
 #define MAX_OPERATION_DATA_LEN 256
 #define MAX_DAG_NODES 100000
+#define DAG_NODES_INITIAL 256
 #define MAX_PARENTS 16
 #define MAX_CHILDREN 32
 #define MAX_REJECT_NODES 10000
@@ -67,27 +68,46 @@ typedef struct conflict_index_entry {
 } conflict_index_entry_t;
 
 typedef struct {
-    dag_node_t* nodes[MAX_DAG_NODES];
+    dag_node_t** nodes;
     size_t node_count;
+    size_t node_capacity;
+    size_t node_limit;
     
     
     dag_node_t* head;
     uint8_t head_hash[32];
     
     
-    dag_node_t* latest_nodes[MAX_DAG_NODES];
+    dag_node_t** latest_nodes;
     size_t latest_count;
+    size_t latest_capacity;
     
     
-    uint64_t node_id_map[MAX_DAG_NODES];
+    uint64_t* node_id_map;
+    size_t node_id_capacity;
     
     
     
     conflict_index_entry_t* conflict_index[CONFLICT_INDEX_SIZE];
+    
+    struct platform_alloc* node_alloc;
+    struct platform_alloc* index_alloc;
 } merkle_crdt_dag_t;
 
 int merkle_crdt_init(merkle_crdt_dag_t* dag);
 
+int merkle_crdt_init_alloc(merkle_crdt_dag_t* dag,
+                           struct platform_alloc* node_alloc,
+                           struct platform_alloc* index_alloc);
+
+void merkle_crdt_reset(merkle_crdt_dag_t* dag);
+
+void merkle_crdt_destroy(merkle_crdt_dag_t* dag);
+
+int merkle_crdt_set_node_limit(merkle_crdt_dag_t* dag, size_t limit);
+
+int merkle_crdt_push_latest(merkle_crdt_dag_t* dag, dag_node_t* node);
+
 int merkle_crdt_add_operation(merkle_crdt_dag_t* dag, const operation_t* op, uint64_t tx_sort_order);
 
 bool merkle_crdt_is_conflict(const operation_t* op1, const operation_t* op2);
@@ -0,0 +1,104 @@
+#include "mpt_arena.h"
+#include "mpt_tree_common.h"
+#include "../platform/platform_alloc.h"
+#include <string.h>
+
+#define MPT_ARENA_SLAB_HEADER \
+    ((sizeof(mpt_arena_slab_t) + MPT_ARENA_ALIGN - 1) & ~(size_t)(MPT_ARENA_ALIGN - 1))
+
+static size_t mpt_arena_class_of(size_t size) {
+    return (size + MPT_ARENA_ALIGN - 1) / MPT_ARENA_ALIGN - 1;
+}
+
+void mpt_arena_init(mpt_arena_t* arena) {
+    if (arena == NULL) return;
+    
+    memset(arena, 0, sizeof(mpt_arena_t));
+}
+
+void mpt_arena_init_alloc(mpt_arena_t* arena, struct platform_alloc* backing) {
+    if (arena == NULL) return;
+    
+    mpt_arena_init(arena);
+    arena->backing = backing;
+}
+
+static mpt_arena_slab_t* mpt_arena_new_slab(mpt_arena_t* arena) {
+    mpt_arena_slab_t* slab = (mpt_arena_slab_t*)platform_alloc(arena->backing, MPT_ARENA_SLAB_SIZE);
+    if (slab == NULL) return NULL;
+    
+    slab->next = arena->slabs;
+    slab->used = MPT_ARENA_SLAB_HEADER;
+    arena->slabs = slab;
+    arena->slab_count++;
+    return slab;
+}
+
+void* mpt_arena_alloc(mpt_arena_t* arena, size_t size) {
+    if (arena == NULL || size == 0 || size > MPT_ARENA_MAX_ALLOC) return NULL;
+    
+    size_t cls = mpt_arena_class_of(size);
+    size_t slot_size = (cls + 1) * MPT_ARENA_ALIGN;
+    
+    mpt_arena_free_slot_t* slot = arena->free_lists[cls];
+    if (slot != NULL) {
+        arena->free_lists[cls] = slot->next;
+        arena->bytes_in_use += slot_size;
+        return slot;
+    }
+    
+    mpt_arena_slab_t* slab = arena->slabs;
+    if (slab == NULL || slab->used + slot_size > MPT_ARENA_SLAB_SIZE) {
+        slab = mpt_arena_new_slab(arena);
+        if (slab == NULL) return NULL;
+    }
+    
+    void* ptr = (uint8_t*)slab + slab->used;
+    slab->used += slot_size;
+    arena->bytes_in_use += slot_size;
+    return ptr;
+}
+
+void mpt_arena_free(mpt_arena_t* arena, void* ptr, size_t size) {
+    if (arena == NULL || ptr == NULL || size == 0 || size > MPT_ARENA_MAX_ALLOC) return;
+    
+    size_t cls = mpt_arena_class_of(size);
+    mpt_arena_free_slot_t* slot = (mpt_arena_free_slot_t*)ptr;
+    slot->next = arena->free_lists[cls];
+    arena->free_lists[cls] = slot;
+    arena->bytes_in_use -= (cls + 1) * MPT_ARENA_ALIGN;
+}
+
+void mpt_arena_reset(mpt_arena_t* arena) {
+    if (arena == NULL) return;
+    
+    mpt_arena_slab_t* keep = arena->slabs;
+    if (keep != NULL) {
+        mpt_arena_slab_t* slab = keep->next;
+        while (slab != NULL) {
+            mpt_arena_slab_t* next = slab->next;
+            platform_alloc_free(arena->backing, slab);
+            slab = next;
+        }
+        keep->next = NULL;
+        keep->used = MPT_ARENA_SLAB_HEADER;
+    }
+    
+    memset(arena->free_lists, 0, sizeof(arena->free_lists));
+    arena->slabs = keep;
+    arena->slab_count = (keep != NULL) ? 1 : 0;
+    arena->bytes_in_use = 0;
+}
+
+void mpt_arena_destroy(mpt_arena_t* arena) {
+    if (arena == NULL) return;
+    
+    mpt_arena_slab_t* slab = arena->slabs;
+    while (slab != NULL) {
+        mpt_arena_slab_t* next = slab->next;
+        platform_alloc_free(arena->backing, slab);
+        slab = next;
+    }
+    
+    memset(arena, 0, sizeof(mpt_arena_t));
+}
@@ -0,0 +1,44 @@
+#ifndef _MPT_ARENA_H_
+#define _MPT_ARENA_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MPT_ARENA_SLAB_SIZE (64 * 1024)
+#define MPT_ARENA_ALIGN 8
+#define MPT_ARENA_MAX_ALLOC 1024
+#define MPT_ARENA_CLASS_COUNT (MPT_ARENA_MAX_ALLOC / MPT_ARENA_ALIGN)
+
+typedef struct mpt_arena_slab {
+    struct mpt_arena_slab* next;
+    size_t used;
+} mpt_arena_slab_t;
+
+typedef struct mpt_arena_free_slot {
+    struct mpt_arena_free_slot* next;
+} mpt_arena_free_slot_t;
+
+struct platform_alloc;
+
+typedef struct {
+    mpt_arena_slab_t* slabs;
+    mpt_arena_free_slot_t* free_lists[MPT_ARENA_CLASS_COUNT];
+    size_t slab_count;
+    size_t bytes_in_use;
+    struct platform_alloc* backing;
+} mpt_arena_t;
+
+void mpt_arena_init(mpt_arena_t* arena);
+
+void mpt_arena_init_alloc(mpt_arena_t* arena, struct platform_alloc* backing);
+
+void* mpt_arena_alloc(mpt_arena_t* arena, size_t size);
+
+void mpt_arena_free(mpt_arena_t* arena, void* ptr, size_t size);
+
+void mpt_arena_reset(mpt_arena_t* arena);
+
+void mpt_arena_destroy(mpt_arena_t* arena);
+
+#endif
@@ -0,0 +1,330 @@
+#include "mpt_journal.h"
+#include "mpt_tree_common.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static void mpt_journal_store_le(uint8_t* dst, uint64_t value, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t mpt_journal_load_le(const uint8_t* src, size_t len) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < len; i++) {
+        value |= (uint64_t)src[i] << (8 * i);
+    }
+    return value;
+}
+
+static int mpt_journal_reserve(mpt_journal_t* journal, size_t len) {
+    size_t needed = MPT_JOURNAL_BATCH_HEADER + journal->buffer_len + len;
+    if (needed <= journal->buffer_capacity) return 0;
+    if (needed > 0xFFFFFFFF) return -1;
+    
+    size_t capacity = journal->buffer_capacity ? journal->buffer_capacity : MPT_JOURNAL_BUFFER_INITIAL;
+    while (capacity < needed) capacity *= 2;
+    
+    uint8_t* buffer = (uint8_t*)platform_malloc(capacity);
+    if (buffer == NULL) return -1;
+    if (journal->buffer) {
+        memcpy(buffer, journal->buffer, MPT_JOURNAL_BATCH_HEADER + journal->buffer_len);
+        platform_free(journal->buffer);
+    }
+    journal->buffer = buffer;
+    journal->buffer_capacity = capacity;
+    return 0;
+}
+
+static int mpt_journal_write(int fd, const uint8_t* data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t written = pwrite(fd, data, len, (off_t)offset);
+        if (written <= 0) return -1;
+        data += written;
+        len -= (size_t)written;
+        offset += (uint64_t)written;
+    }
+    return 0;
+}
+
+static int mpt_journal_read(int fd, uint8_t* data, size_t len) {
+    uint64_t offset = 0;
+    while (len > 0) {
+        ssize_t got = pread(fd, data, len, (off_t)offset);
+        if (got <= 0) return -1;
+        data += got;
+        len -= (size_t)got;
+        offset += (uint64_t)got;
+    }
+    return 0;
+}
+
+static void mpt_journal_seal(uint8_t* batch, size_t len) {
+    mpt_journal_store_le(batch, len, 4);
+    platform_sha256(batch + MPT_JOURNAL_BATCH_HEADER, len, batch + 4);
+}
+
+static int mpt_journal_parse(const uint8_t* payload, size_t len, size_t* pos,
+                             mpt_journal_record_type_t* type,
+                             const uint8_t** key, size_t* key_len,
+                             const uint8_t** value, size_t* value_len) {
+    size_t at = *pos;
+    *type = (mpt_journal_record_type_t)payload[at++];
+    *key = NULL;
+    *key_len = 0;
+    *value = NULL;
+    *value_len = 0;
+    
+    if (*type == MPT_JOURNAL_CHECKPOINT) {
+        if (at + MPT_JOURNAL_CHECKPOINT_RECORD - 1 > len) return -1;
+        *value = payload + at;
+        *value_len = MPT_JOURNAL_CHECKPOINT_RECORD - 1;
+        *pos = at + *value_len;
+        return 0;
+    }
+    if (*type == MPT_JOURNAL_CLEAR) {
+        *pos = at;
+        return 0;
+    }
+    if (*type != MPT_JOURNAL_PUT && *type != MPT_JOURNAL_DELETE) return -1;
+    
+    if (at >= len) return -1;
+    *key_len = payload[at++];
+    if (at + *key_len > len) return -1;
+    *key = payload + at;
+    at += *key_len;
+    
+    if (*type == MPT_JOURNAL_PUT) {
+        if (at + 2 > len) return -1;
+        *value_len = (size_t)mpt_journal_load_le(payload + at, 2);
+        at += 2;
+        if (at + *value_len > len) return -1;
+        *value = payload + at;
+        at += *value_len;
+    }
+    
+    *pos = at;
+    return 0;
+}
+
+static int mpt_journal_walk(mpt_journal_t* journal, const uint8_t* payload, size_t len,
+                            uint64_t base, mpt_journal_apply_fn apply, void* ctx) {
+    size_t pos = 0;
+    while (pos < len) {
+        uint64_t at = base + pos;
+        mpt_journal_record_type_t type;
+        const uint8_t* key;
+        const uint8_t* value;
+        size_t key_len;
+        size_t value_len;
+        if (mpt_journal_parse(payload, len, &pos, &type, &key, &key_len, &value, &value_len) != 0) {
+            return -1;
+        }
+        
+        if (type == MPT_JOURNAL_CHECKPOINT) {
+            if (apply == NULL) {
+                journal->generation = mpt_journal_load_le(value, 8);
+                memcpy(journal->checkpoint_root, value + 8, MPT_JOURNAL_HASH_SIZE);
+                journal->checkpoint_size = mpt_journal_load_le(value + 8 + MPT_JOURNAL_HASH_SIZE, 8);
+                journal->replay_offset = base + pos;
+            }
+            continue;
+        }
+        if (apply && at >= journal->replay_offset &&
+            apply(ctx, type, key, key_len, value, value_len) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int mpt_journal_scan(mpt_journal_t* journal, mpt_journal_apply_fn apply, void* ctx) {
+    struct stat st;
+    if (fstat(journal->fd, &st) != 0) return -1;
+    
+    size_t size = (size_t)st.st_size;
+    if (apply && size > journal->end) size = (size_t)journal->end;
+    
+    uint8_t* data = (uint8_t*)platform_malloc(size);
+    if (data == NULL) return -1;
+    if (mpt_journal_read(journal->fd, data, size) != 0 ||
+        memcmp(data, MPT_JOURNAL_MAGIC, MPT_JOURNAL_HEADER_SIZE) != 0) {
+        platform_free(data);
+        return -1;
+    }
+    
+    uint64_t offset = MPT_JOURNAL_HEADER_SIZE;
+    int ret = 0;
+    while (offset + MPT_JOURNAL_BATCH_HEADER <= size) {
+        const uint8_t* batch = data + offset;
+        size_t len = (size_t)mpt_journal_load_le(batch, 4);
+        if (len == 0 || offset + MPT_JOURNAL_BATCH_HEADER + len > size) break;
+        
+        uint8_t hash[MPT_JOURNAL_HASH_SIZE];
+        platform_sha256(batch + MPT_JOURNAL_BATCH_HEADER, len, hash);
+        if (memcmp(hash, batch + 4, MPT_JOURNAL_HASH_SIZE) != 0) break;
+        
+        uint64_t base = offset + MPT_JOURNAL_BATCH_HEADER;
+        if (mpt_journal_walk(journal, batch + MPT_JOURNAL_BATCH_HEADER, len, base, apply, ctx) != 0) {
+            if (apply) ret = -1;
+            break;
+        }
+        offset = base + len;
+        if (apply == NULL) journal->batches++;
+    }
+    platform_free(data);
+    
+    if (apply == NULL) {
+        journal->end = offset;
+        if ((uint64_t)st.st_size > offset && ftruncate(journal->fd, (off_t)offset) != 0) return -1;
+    }
+    return ret;
+}
+
+int mpt_journal_open(mpt_journal_t* journal, const char* path, uint64_t checkpoint_bytes) {
+    if (journal == NULL || path == NULL) return -1;
+    
+    memset(journal, 0, sizeof(mpt_journal_t));
+    journal->fd = -1;
+    if (strlen(path) >= MPT_JOURNAL_PATH_MAX) return -1;
+    strcpy(journal->path, path);
+    strcpy(journal->snapshot_path, path);
+    strcat(journal->snapshot_path, ".snap");
+    journal->checkpoint_bytes = checkpoint_bytes ? checkpoint_bytes : MPT_JOURNAL_CHECKPOINT_BYTES;
+    
+    journal->fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (journal->fd < 0) return -1;
+    
+    struct stat st;
+    if (fstat(journal->fd, &st) != 0) {
+        mpt_journal_close(journal);
+        return -1;
+    }
+    
+    if (st.st_size < MPT_JOURNAL_HEADER_SIZE) {
+        if (ftruncate(journal->fd, 0) != 0 ||
+            mpt_journal_write(journal->fd, (const uint8_t*)MPT_JOURNAL_MAGIC, MPT_JOURNAL_HEADER_SIZE, 0) != 0 ||
+            fdatasync(journal->fd) != 0) {
+            mpt_journal_close(journal);
+            return -1;
+        }
+    }
+    
+    if (mpt_journal_scan(journal, NULL, NULL) != 0 || mpt_journal_reserve(journal, 0) != 0) {
+        mpt_journal_close(journal);
+        return -1;
+    }
+    if (journal->replay_offset == 0) journal->replay_offset = MPT_JOURNAL_HEADER_SIZE;
+    
+    return 0;
+}
+
+void mpt_journal_close(mpt_journal_t* journal) {
+    if (journal == NULL) return;
+    
+    if (journal->buffer) platform_free(journal->buffer);
+    if (journal->fd >= 0) close(journal->fd);
+    memset(journal, 0, sizeof(mpt_journal_t));
+    journal->fd = -1;
+}
+
+int mpt_journal_put(mpt_journal_t* journal, const uint8_t* key, size_t key_len,
+                    const uint8_t* value, size_t value_len) {
+    if (journal == NULL || key == NULL || value == NULL) return -1;
+    if (key_len > 0xFF || value_len > 0xFFFF) return -1;
+    if (mpt_journal_reserve(journal, 4 + key_len + value_len) != 0) return -1;
+    
+    uint8_t* dst = journal->buffer + MPT_JOURNAL_BATCH_HEADER + journal->buffer_len;
+    dst[0] = MPT_JOURNAL_PUT;
+    dst[1] = (uint8_t)key_len;
+    memcpy(dst + 2, key, key_len);
+    mpt_journal_store_le(dst + 2 + key_len, value_len, 2);
+    memcpy(dst + 4 + key_len, value, value_len);
+    
+    journal->buffer_len += 4 + key_len + value_len;
+    return 0;
+}
+
+int mpt_journal_delete(mpt_journal_t* journal, const uint8_t* key, size_t key_len) {
+    if (journal == NULL || key == NULL) return -1;
+    if (key_len > 0xFF) return -1;
+    if (mpt_journal_reserve(journal, 2 + key_len) != 0) return -1;
+    
+    uint8_t* dst = journal->buffer + MPT_JOURNAL_BATCH_HEADER + journal->buffer_len;
+    dst[0] = MPT_JOURNAL_DELETE;
+    dst[1] = (uint8_t)key_len;
+    memcpy(dst + 2, key, key_len);
+    
+    journal->buffer_len += 2 + key_len;
+    return 0;
+}
+
+int mpt_journal_clear(mpt_journal_t* journal) {
+    if (journal == NULL) return -1;
+    if (mpt_journal_reserve(journal, 1) != 0) return -1;
+    
+    journal->buffer[MPT_JOURNAL_BATCH_HEADER + journal->buffer_len] = MPT_JOURNAL_CLEAR;
+    journal->buffer_len++;
+    return 0;
+}
+
+void mpt_journal_rewind(mpt_journal_t* journal, size_t mark) {
+    if (journal == NULL || mark > journal->buffer_len) return;
+    
+    journal->buffer_len = mark;
+}
+
+int mpt_journal_flush(mpt_journal_t* journal) {
+    if (journal == NULL || journal->fd < 0) return -1;
+    if (journal->buffer_len == 0) return 0;
+    
+    size_t len = MPT_JOURNAL_BATCH_HEADER + journal->buffer_len;
+    mpt_journal_seal(journal->buffer, journal->buffer_len);
+    if (mpt_journal_write(journal->fd, journal->buffer, len, journal->end) != 0) return -1;
+    if (fdatasync(journal->fd) != 0) return -1;
+    
+    journal->end += len;
+    journal->batches++;
+    journal->buffer_len = 0;
+    return 0;
+}
+
+int mpt_journal_checkpoint(mpt_journal_t* journal, uint64_t generation,
+                           const uint8_t* root_hash, uint64_t size) {
+    if (journal == NULL || journal->fd < 0 || root_hash == NULL) return -1;
+    
+    uint8_t batch[MPT_JOURNAL_BATCH_HEADER + MPT_JOURNAL_CHECKPOINT_RECORD];
+    uint8_t* record = batch + MPT_JOURNAL_BATCH_HEADER;
+    record[0] = MPT_JOURNAL_CHECKPOINT;
+    mpt_journal_store_le(record + 1, generation, 8);
+    memcpy(record + 9, root_hash, MPT_JOURNAL_HASH_SIZE);
+    mpt_journal_store_le(record + 9 + MPT_JOURNAL_HASH_SIZE, size, 8);
+    mpt_journal_seal(batch, MPT_JOURNAL_CHECKPOINT_RECORD);
+    
+    if (ftruncate(journal->fd, MPT_JOURNAL_HEADER_SIZE) != 0) return -1;
+    if (mpt_journal_write(journal->fd, batch, sizeof(batch), MPT_JOURNAL_HEADER_SIZE) != 0) return -1;
+    if (fdatasync(journal->fd) != 0) return -1;
+    
+    journal->end = MPT_JOURNAL_HEADER_SIZE + sizeof(batch);
+    journal->replay_offset = journal->end;
+    journal->batches++;
+    journal->buffer_len = 0;
+    journal->generation = generation;
+    memcpy(journal->checkpoint_root, root_hash, MPT_JOURNAL_HASH_SIZE);
+    journal->checkpoint_size = size;
+    return 0;
+}
+
+bool mpt_journal_needs_checkpoint(const mpt_journal_t* journal) {
+    if (journal == NULL) return false;
+    
+    return journal->end + journal->buffer_len >= journal->checkpoint_bytes;
+}
+
+int mpt_journal_replay(mpt_journal_t* journal, mpt_journal_apply_fn apply, void* ctx) {
+    if (journal == NULL || journal->fd < 0 || apply == NULL) return -1;
+    
+    return mpt_journal_scan(journal, apply, ctx);
+}
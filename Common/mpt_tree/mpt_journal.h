@@ -0,0 +1,66 @@
+#ifndef _MPT_JOURNAL_H_
+#define _MPT_JOURNAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MPT_JOURNAL_MAGIC "MPTJRNL1"
+#define MPT_JOURNAL_HEADER_SIZE 8
+#define MPT_JOURNAL_HASH_SIZE 32
+#define MPT_JOURNAL_BATCH_HEADER (4 + MPT_JOURNAL_HASH_SIZE)
+#define MPT_JOURNAL_CHECKPOINT_RECORD (1 + 8 + MPT_JOURNAL_HASH_SIZE + 8)
+#define MPT_JOURNAL_PATH_MAX 256
+#define MPT_JOURNAL_BUFFER_INITIAL 4096
+#define MPT_JOURNAL_CHECKPOINT_BYTES (16 * 1024 * 1024)
+
+typedef enum {
+    MPT_JOURNAL_PUT = 1,
+    MPT_JOURNAL_DELETE = 2,
+    MPT_JOURNAL_CLEAR = 3,
+    MPT_JOURNAL_CHECKPOINT = 4
+} mpt_journal_record_type_t;
+
+typedef int (*mpt_journal_apply_fn)(void* ctx, mpt_journal_record_type_t type,
+                                    const uint8_t* key, size_t key_len,
+                                    const uint8_t* value, size_t value_len);
+
+typedef struct mpt_journal {
+    char path[MPT_JOURNAL_PATH_MAX];
+    char snapshot_path[MPT_JOURNAL_PATH_MAX + 8];
+    int fd;
+    uint64_t end;
+    uint64_t replay_offset;
+    uint64_t batches;
+    uint64_t checkpoint_bytes;
+    uint8_t* buffer;
+    size_t buffer_len;
+    size_t buffer_capacity;
+    uint64_t generation;
+    uint8_t checkpoint_root[MPT_JOURNAL_HASH_SIZE];
+    uint64_t checkpoint_size;
+} mpt_journal_t;
+
+int mpt_journal_open(mpt_journal_t* journal, const char* path, uint64_t checkpoint_bytes);
+
+void mpt_journal_close(mpt_journal_t* journal);
+
+int mpt_journal_put(mpt_journal_t* journal, const uint8_t* key, size_t key_len,
+                    const uint8_t* value, size_t value_len);
+
+int mpt_journal_delete(mpt_journal_t* journal, const uint8_t* key, size_t key_len);
+
+int mpt_journal_clear(mpt_journal_t* journal);
+
+void mpt_journal_rewind(mpt_journal_t* journal, size_t mark);
+
+int mpt_journal_flush(mpt_journal_t* journal);
+
+int mpt_journal_checkpoint(mpt_journal_t* journal, uint64_t generation,
+                           const uint8_t* root_hash, uint64_t size);
+
+bool mpt_journal_needs_checkpoint(const mpt_journal_t* journal);
+
+int mpt_journal_replay(mpt_journal_t* journal, mpt_journal_apply_fn apply, void* ctx);
+
+#endif
@@ -0,0 +1,70 @@
+#include "mpt_rcu.h"
+#include <string.h>
+
+static void mpt_rcu_slot_release(void* arg) {
+    mpt_rcu_slot_t* slot = (mpt_rcu_slot_t*)arg;
+    __atomic_store_n(&slot->epoch, (uint64_t)MPT_RCU_IDLE, __ATOMIC_RELEASE);
+    __atomic_store_n(&slot->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static mpt_rcu_slot_t* mpt_rcu_slot_acquire(mpt_rcu_t* rcu) {
+    mpt_rcu_slot_t* slot = (mpt_rcu_slot_t*)pthread_getspecific(rcu->key);
+    if (slot) return slot;
+    
+    for (size_t i = 0; i < MPT_RCU_MAX_READERS; i++) {
+        uint32_t expected = 0;
+        if (__atomic_compare_exchange_n(&rcu->slots[i].in_use, &expected, 1, false,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            if (pthread_setspecific(rcu->key, &rcu->slots[i]) != 0) {
+                mpt_rcu_slot_release(&rcu->slots[i]);
+                return NULL;
+            }
+            return &rcu->slots[i];
+        }
+    }
+    return NULL;
+}
+
+int mpt_rcu_init(mpt_rcu_t* rcu) {
+    if (rcu == NULL) return -1;
+    
+    memset(rcu, 0, sizeof(mpt_rcu_t));
+    rcu->epoch = 1;
+    return pthread_key_create(&rcu->key, mpt_rcu_slot_release) == 0 ? 0 : -1;
+}
+
+void mpt_rcu_destroy(mpt_rcu_t* rcu) {
+    if (rcu == NULL) return;
+    
+    pthread_key_delete(rcu->key);
+    memset(rcu, 0, sizeof(mpt_rcu_t));
+}
+
+mpt_rcu_slot_t* mpt_rcu_read_lock(mpt_rcu_t* rcu) {
+    if (rcu == NULL) return NULL;
+    
+    mpt_rcu_slot_t* slot = mpt_rcu_slot_acquire(rcu);
+    if (slot == NULL) return NULL;
+    
+    __atomic_store_n(&slot->epoch, __atomic_load_n(&rcu->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    return slot;
+}
+
+void mpt_rcu_read_unlock(mpt_rcu_slot_t* slot) {
+    if (slot == NULL) return;
+    
+    __atomic_store_n(&slot->epoch, (uint64_t)MPT_RCU_IDLE, __ATOMIC_RELEASE);
+}
+
+uint64_t mpt_rcu_advance(mpt_rcu_t* rcu) {
+    return __atomic_add_fetch(&rcu->epoch, 1, __ATOMIC_SEQ_CST);
+}
+
+uint64_t mpt_rcu_min_epoch(const mpt_rcu_t* rcu) {
+    uint64_t min = UINT64_MAX;
+    for (size_t i = 0; i < MPT_RCU_MAX_READERS; i++) {
+        uint64_t epoch = __atomic_load_n(&rcu->slots[i].epoch, __ATOMIC_SEQ_CST);
+        if (epoch != MPT_RCU_IDLE && epoch < min) min = epoch;
+    }
+    return min;
+}
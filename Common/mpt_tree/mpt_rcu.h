@@ -0,0 +1,37 @@
+#ifndef _MPT_RCU_H_
+#define _MPT_RCU_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define MPT_RCU_MAX_READERS 64
+#define MPT_RCU_CACHE_LINE 64
+#define MPT_RCU_IDLE 0
+
+typedef struct {
+    uint64_t epoch;
+    uint32_t in_use;
+    uint8_t pad[MPT_RCU_CACHE_LINE - sizeof(uint64_t) - sizeof(uint32_t)];
+} __attribute__((aligned(MPT_RCU_CACHE_LINE))) mpt_rcu_slot_t;
+
+typedef struct mpt_rcu {
+    mpt_rcu_slot_t slots[MPT_RCU_MAX_READERS];
+    uint64_t epoch;
+    pthread_key_t key;
+} mpt_rcu_t;
+
+int mpt_rcu_init(mpt_rcu_t* rcu);
+
+void mpt_rcu_destroy(mpt_rcu_t* rcu);
+
+mpt_rcu_slot_t* mpt_rcu_read_lock(mpt_rcu_t* rcu);
+
+void mpt_rcu_read_unlock(mpt_rcu_slot_t* slot);
+
+uint64_t mpt_rcu_advance(mpt_rcu_t* rcu);
+
+uint64_t mpt_rcu_min_epoch(const mpt_rcu_t* rcu);
+
+#endif
@@ -0,0 +1,420 @@
+#include "mpt_smt.h"
+#include "mpt_tree_common.h"
+#include <string.h>
+#include <pthread.h>
+
+static uint8_t mpt_smt_empty[MPT_SMT_DEPTH + 1][MPT_NODE_HASH_SIZE];
+static pthread_once_t mpt_smt_empty_once = PTHREAD_ONCE_INIT;
+
+static void mpt_smt_hash_pair(const uint8_t* left, const uint8_t* right, uint8_t* hash) {
+    uint8_t buffer[1 + 2 * MPT_NODE_HASH_SIZE];
+    buffer[0] = MPT_SMT_NODE_PREFIX;
+    memcpy(buffer + 1, left, MPT_NODE_HASH_SIZE);
+    memcpy(buffer + 1 + MPT_NODE_HASH_SIZE, right, MPT_NODE_HASH_SIZE);
+    platform_sha256(buffer, sizeof(buffer), hash);
+}
+
+static void mpt_smt_hash_leaf(const uint8_t* key, size_t key_len,
+                              const uint8_t* value, size_t value_len, uint8_t* hash) {
+    uint8_t buffer[2 + MPT_MAX_KEY_LEN + MPT_MAX_VALUE_LEN];
+    buffer[0] = MPT_SMT_LEAF_PREFIX;
+    buffer[1] = (uint8_t)key_len;
+    memcpy(buffer + 2, key, key_len);
+    memcpy(buffer + 2 + key_len, value, value_len);
+    platform_sha256(buffer, 2 + key_len + value_len, hash);
+}
+
+static void mpt_smt_empty_init(void) {
+    memset(mpt_smt_empty[0], 0, MPT_NODE_HASH_SIZE);
+    for (size_t height = 1; height <= MPT_SMT_DEPTH; height++) {
+        mpt_smt_hash_pair(mpt_smt_empty[height - 1], mpt_smt_empty[height - 1], mpt_smt_empty[height]);
+    }
+}
+
+const uint8_t* mpt_smt_empty_hash(size_t height) {
+    if (height > MPT_SMT_DEPTH) return NULL;
+    
+    pthread_once(&mpt_smt_empty_once, mpt_smt_empty_init);
+    return mpt_smt_empty[height];
+}
+
+static int mpt_smt_bit(const uint8_t* path, size_t index) {
+    return (path[index / 8] >> (7 - (index % 8))) & 1;
+}
+
+static size_t mpt_smt_common_bits(const uint8_t* a, const uint8_t* b, size_t limit) {
+    for (size_t i = 0; i < MPT_SMT_PATH_SIZE; i++) {
+        if (a[i] == b[i]) continue;
+        size_t bits = i * 8 + (size_t)__builtin_clz((unsigned)(a[i] ^ b[i]) << 24);
+        return (bits < limit) ? bits : limit;
+    }
+    return limit;
+}
+
+static void mpt_smt_fold(const uint8_t* hash, const uint8_t* path,
+                         size_t from, size_t to, uint8_t* out) {
+    memcpy(out, hash, MPT_NODE_HASH_SIZE);
+    for (size_t level = from; level > to; level--) {
+        const uint8_t* sibling = mpt_smt_empty[MPT_SMT_DEPTH - level];
+        if (mpt_smt_bit(path, level - 1)) {
+            mpt_smt_hash_pair(sibling, out, out);
+        } else {
+            mpt_smt_hash_pair(out, sibling, out);
+        }
+    }
+}
+
+static const uint8_t* mpt_smt_edge(mpt_smt_node_t* node, size_t depth) {
+    if (node->edge_depth != depth) {
+        mpt_smt_fold(node->hash, node->path, node->depth, depth, node->edge_hash);
+        node->edge_depth = (uint16_t)depth;
+    }
+    return node->edge_hash;
+}
+
+static size_t mpt_smt_node_size(const mpt_smt_node_t* node) {
+    return sizeof(mpt_smt_node_t) + node->key_len + node->value_len;
+}
+
+static void mpt_smt_node_free(mpt_smt_t* smt, mpt_smt_node_t* node) {
+    mpt_arena_free(&smt->arena, node, mpt_smt_node_size(node));
+}
+
+static mpt_smt_node_t* mpt_smt_leaf_create(mpt_smt_t* smt, const uint8_t* path,
+                                           const uint8_t* key, size_t key_len,
+                                           const uint8_t* value, size_t value_len) {
+    mpt_smt_node_t* leaf = (mpt_smt_node_t*)mpt_arena_alloc(&smt->arena,
+                                                             sizeof(mpt_smt_node_t) + key_len + value_len);
+    if (leaf == NULL) return NULL;
+    
+    memset(leaf, 0, sizeof(mpt_smt_node_t));
+    memcpy(leaf->path, path, MPT_SMT_PATH_SIZE);
+    leaf->depth = MPT_SMT_DEPTH;
+    leaf->edge_depth = MPT_SMT_EDGE_INVALID;
+    leaf->key_len = (uint8_t)key_len;
+    leaf->value_len = (uint16_t)value_len;
+    leaf->dirty = true;
+    memcpy(leaf->data, key, key_len);
+    memcpy(leaf->data + key_len, value, value_len);
+    return leaf;
+}
+
+static mpt_smt_node_t* mpt_smt_internal_create(mpt_smt_t* smt, const uint8_t* path, size_t depth) {
+    mpt_smt_node_t* node = (mpt_smt_node_t*)mpt_arena_alloc(&smt->arena, sizeof(mpt_smt_node_t));
+    if (node == NULL) return NULL;
+    
+    memset(node, 0, sizeof(mpt_smt_node_t));
+    memcpy(node->path, path, MPT_SMT_PATH_SIZE);
+    node->depth = (uint16_t)depth;
+    node->edge_depth = MPT_SMT_EDGE_INVALID;
+    node->dirty = true;
+    return node;
+}
+
+static bool mpt_smt_leaf_matches(const mpt_smt_node_t* leaf, const uint8_t* key, size_t key_len) {
+    return leaf->key_len == key_len && memcmp(leaf->data, key, key_len) == 0;
+}
+
+static void mpt_smt_touch(mpt_smt_t* smt, mpt_smt_node_t** trail, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        trail[i]->dirty = true;
+        trail[i]->edge_depth = MPT_SMT_EDGE_INVALID;
+    }
+    smt->dirty = true;
+}
+
+int mpt_smt_init(mpt_smt_t* smt) {
+    if (smt == NULL) return -1;
+    
+    memset(smt, 0, sizeof(mpt_smt_t));
+    mpt_arena_init(&smt->arena);
+    memcpy(smt->root_hash, mpt_smt_empty_hash(MPT_SMT_DEPTH), MPT_NODE_HASH_SIZE);
+    return 0;
+}
+
+void mpt_smt_destroy(mpt_smt_t* smt) {
+    if (smt == NULL) return;
+    
+    mpt_arena_destroy(&smt->arena);
+    memset(smt, 0, sizeof(mpt_smt_t));
+}
+
+void mpt_smt_reset(mpt_smt_t* smt) {
+    if (smt == NULL) return;
+    
+    mpt_arena_reset(&smt->arena);
+    smt->root = NULL;
+    smt->size = 0;
+    smt->dirty = false;
+    memcpy(smt->root_hash, mpt_smt_empty_hash(MPT_SMT_DEPTH), MPT_NODE_HASH_SIZE);
+}
+
+int mpt_smt_insert(mpt_smt_t* smt, const uint8_t* key, size_t key_len,
+                   const uint8_t* value, size_t value_len) {
+    if (smt == NULL || key == NULL || value == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN || value_len > MPT_MAX_VALUE_LEN) return -1;
+    
+    uint8_t path[MPT_SMT_PATH_SIZE];
+    platform_sha256(key, key_len, path);
+    
+    mpt_smt_node_t* leaf = mpt_smt_leaf_create(smt, path, key, key_len, value, value_len);
+    if (leaf == NULL) return -1;
+    
+    mpt_smt_node_t* trail[MPT_SMT_DEPTH];
+    size_t count = 0;
+    mpt_smt_node_t** link = &smt->root;
+    while (*link != NULL) {
+        mpt_smt_node_t* node = *link;
+        size_t common = mpt_smt_common_bits(path, node->path, node->depth);
+        
+        if (common < node->depth) {
+            mpt_smt_node_t* split = mpt_smt_internal_create(smt, path, common);
+            if (split == NULL) {
+                mpt_smt_node_free(smt, leaf);
+                return -1;
+            }
+            int bit = mpt_smt_bit(path, common);
+            split->children[bit] = leaf;
+            split->children[!bit] = node;
+            *link = split;
+            smt->size++;
+            mpt_smt_touch(smt, trail, count);
+            return 0;
+        }
+        
+        if (node->depth == MPT_SMT_DEPTH) {
+            if (!mpt_smt_leaf_matches(node, key, key_len)) {
+                mpt_smt_node_free(smt, leaf);
+                return -1;
+            }
+            *link = leaf;
+            mpt_smt_node_free(smt, node);
+            mpt_smt_touch(smt, trail, count);
+            return 0;
+        }
+        
+        trail[count++] = node;
+        link = &node->children[mpt_smt_bit(path, node->depth)];
+    }
+    
+    *link = leaf;
+    smt->size++;
+    mpt_smt_touch(smt, trail, count);
+    return 0;
+}
+
+int mpt_smt_get(const mpt_smt_t* smt, const uint8_t* key, size_t key_len,
+                uint8_t* value, size_t* value_len) {
+    if (smt == NULL || key == NULL || value == NULL || value_len == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN) return -1;
+    
+    uint8_t path[MPT_SMT_PATH_SIZE];
+    platform_sha256(key, key_len, path);
+    
+    const mpt_smt_node_t* node = smt->root;
+    while (node != NULL) {
+        if (mpt_smt_common_bits(path, node->path, node->depth) < node->depth) return -1;
+        if (node->depth == MPT_SMT_DEPTH) break;
+        node = node->children[mpt_smt_bit(path, node->depth)];
+    }
+    if (node == NULL || !mpt_smt_leaf_matches(node, key, key_len)) return -1;
+    
+    size_t copy_len = (*value_len < node->value_len) ? *value_len : node->value_len;
+    memcpy(value, node->data + node->key_len, copy_len);
+    *value_len = node->value_len;
+    return 0;
+}
+
+int mpt_smt_delete(mpt_smt_t* smt, const uint8_t* key, size_t key_len) {
+    if (smt == NULL || key == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN) return -1;
+    
+    uint8_t path[MPT_SMT_PATH_SIZE];
+    platform_sha256(key, key_len, path);
+    
+    mpt_smt_node_t* trail[MPT_SMT_DEPTH];
+    size_t count = 0;
+    mpt_smt_node_t** parent_link = NULL;
+    mpt_smt_node_t** link = &smt->root;
+    while (*link != NULL) {
+        mpt_smt_node_t* node = *link;
+        if (mpt_smt_common_bits(path, node->path, node->depth) < node->depth) return -1;
+        if (node->depth == MPT_SMT_DEPTH) break;
+        
+        trail[count++] = node;
+        parent_link = link;
+        link = &node->children[mpt_smt_bit(path, node->depth)];
+    }
+    
+    mpt_smt_node_t* leaf = *link;
+    if (leaf == NULL || !mpt_smt_leaf_matches(leaf, key, key_len)) return -1;
+    
+    if (parent_link == NULL) {
+        smt->root = NULL;
+    } else {
+        mpt_smt_node_t* parent = *parent_link;
+        *parent_link = parent->children[link == &parent->children[0] ? 1 : 0];
+        mpt_smt_node_free(smt, parent);
+        count--;
+    }
+    mpt_smt_node_free(smt, leaf);
+    
+    smt->size--;
+    mpt_smt_touch(smt, trail, count);
+    return 0;
+}
+
+static void mpt_smt_node_commit(mpt_smt_node_t* node) {
+    if (!node->dirty) return;
+    
+    if (node->depth == MPT_SMT_DEPTH) {
+        mpt_smt_hash_leaf(node->data, node->key_len, node->data + node->key_len,
+                          node->value_len, node->hash);
+    } else {
+        mpt_smt_node_commit(node->children[0]);
+        mpt_smt_node_commit(node->children[1]);
+        mpt_smt_hash_pair(mpt_smt_edge(node->children[0], node->depth + 1),
+                          mpt_smt_edge(node->children[1], node->depth + 1), node->hash);
+    }
+    node->dirty = false;
+}
+
+int mpt_smt_commit(mpt_smt_t* smt) {
+    if (smt == NULL) return -1;
+    if (!smt->dirty) return 0;
+    
+    if (smt->root) {
+        mpt_smt_node_commit(smt->root);
+        memcpy(smt->root_hash, mpt_smt_edge(smt->root, 0), MPT_NODE_HASH_SIZE);
+    } else {
+        memcpy(smt->root_hash, mpt_smt_empty_hash(MPT_SMT_DEPTH), MPT_NODE_HASH_SIZE);
+    }
+    smt->dirty = false;
+    return 0;
+}
+
+int mpt_smt_prove(mpt_smt_t* smt, const uint8_t* key, size_t key_len, mpt_proof_t* proof) {
+    if (smt == NULL || key == NULL || proof == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN) return -1;
+    
+    if (mpt_smt_commit(smt) != 0) return -1;
+    
+    uint8_t path[MPT_SMT_PATH_SIZE];
+    platform_sha256(key, key_len, path);
+    
+    uint8_t bitmap[MPT_SMT_PATH_SIZE];
+    uint8_t siblings[MPT_SMT_DEPTH][MPT_NODE_HASH_SIZE];
+    size_t count = 0;
+    memset(bitmap, 0, sizeof(bitmap));
+    
+    mpt_smt_node_t* node = smt->root;
+    const mpt_smt_node_t* leaf = NULL;
+    while (node != NULL) {
+        size_t common = mpt_smt_common_bits(path, node->path, node->depth);
+        if (common < node->depth) {
+            bitmap[common / 8] |= (uint8_t)(0x80 >> (common % 8));
+            mpt_smt_fold(node->hash, node->path, node->depth, common + 1, siblings[count++]);
+            break;
+        }
+        if (node->depth == MPT_SMT_DEPTH) {
+            if (mpt_smt_leaf_matches(node, key, key_len)) leaf = node;
+            break;
+        }
+        
+        int bit = mpt_smt_bit(path, node->depth);
+        bitmap[node->depth / 8] |= (uint8_t)(0x80 >> (node->depth % 8));
+        memcpy(siblings[count++], mpt_smt_edge(node->children[!bit], node->depth + 1), MPT_NODE_HASH_SIZE);
+        node = node->children[bit];
+    }
+    
+    size_t leaf_len = leaf ? 1 + 1 + key_len + 2 + leaf->value_len : 1;
+    memset(proof, 0, sizeof(mpt_proof_t));
+    proof->data_len = MPT_SMT_PATH_SIZE + count * MPT_NODE_HASH_SIZE + leaf_len;
+    proof->data = (uint8_t*)platform_malloc(proof->data_len);
+    if (proof->data == NULL) {
+        proof->data_len = 0;
+        return -1;
+    }
+    proof->node_count = count;
+    
+    uint8_t* out = proof->data;
+    memcpy(out, bitmap, MPT_SMT_PATH_SIZE);
+    out += MPT_SMT_PATH_SIZE;
+    memcpy(out, siblings, count * MPT_NODE_HASH_SIZE);
+    out += count * MPT_NODE_HASH_SIZE;
+    
+    *out++ = leaf ? 1 : 0;
+    if (leaf) {
+        *out++ = (uint8_t)key_len;
+        memcpy(out, key, key_len);
+        out += key_len;
+        *out++ = (uint8_t)(leaf->value_len & 0xFF);
+        *out++ = (uint8_t)(leaf->value_len >> 8);
+        memcpy(out, leaf->data + leaf->key_len, leaf->value_len);
+    }
+    return 0;
+}
+
+int mpt_smt_verify_proof(const uint8_t* root_hash, const uint8_t* key, size_t key_len,
+                         const mpt_proof_t* proof, bool* exists,
+                         uint8_t* value, size_t* value_len) {
+    if (root_hash == NULL || key == NULL || proof == NULL || exists == NULL) return -1;
+    if (value != NULL && value_len == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN) return -1;
+    if (proof->data == NULL || proof->data_len < MPT_SMT_PATH_SIZE + 1) return -1;
+    
+    const uint8_t* bitmap = proof->data;
+    size_t count = 0;
+    for (size_t i = 0; i < MPT_SMT_PATH_SIZE; i++) {
+        count += (size_t)__builtin_popcount(bitmap[i]);
+    }
+    
+    size_t offset = MPT_SMT_PATH_SIZE + count * MPT_NODE_HASH_SIZE;
+    if (proof->data_len < offset + 1) return -1;
+    const uint8_t* siblings = proof->data + MPT_SMT_PATH_SIZE;
+    const uint8_t* leaf = proof->data + offset;
+    size_t leaf_len = proof->data_len - offset;
+    
+    uint8_t hash[MPT_NODE_HASH_SIZE];
+    const uint8_t* found = NULL;
+    size_t found_len = 0;
+    if (leaf[0] == 0) {
+        if (leaf_len != 1) return -1;
+        memcpy(hash, mpt_smt_empty_hash(0), MPT_NODE_HASH_SIZE);
+    } else if (leaf[0] == 1) {
+        if (leaf_len < 4 || leaf[1] != key_len || leaf_len < 4 + key_len) return -1;
+        if (memcmp(leaf + 2, key, key_len) != 0) return -1;
+        found = leaf + 4 + key_len;
+        found_len = (size_t)leaf[2 + key_len] | ((size_t)leaf[3 + key_len] << 8);
+        if (found_len > MPT_MAX_VALUE_LEN || leaf_len != 4 + key_len + found_len) return -1;
+        
+        mpt_smt_hash_leaf(key, key_len, found, found_len, hash);
+    } else {
+        return -1;
+    }
+    
+    uint8_t path[MPT_SMT_PATH_SIZE];
+    platform_sha256(key, key_len, path);
+    
+    for (size_t level = MPT_SMT_DEPTH; level > 0; level--) {
+        const uint8_t* sibling = mpt_smt_empty_hash(MPT_SMT_DEPTH - level);
+        if (bitmap[(level - 1) / 8] & (0x80 >> ((level - 1) % 8))) {
+            sibling = siblings + --count * MPT_NODE_HASH_SIZE;
+        }
+        if (mpt_smt_bit(path, level - 1)) {
+            mpt_smt_hash_pair(sibling, hash, hash);
+        } else {
+            mpt_smt_hash_pair(hash, sibling, hash);
+        }
+    }
+    
+    if (memcmp(hash, root_hash, MPT_NODE_HASH_SIZE) != 0) return -1;
+    
+    *exists = (found != NULL);
+    if (found && value) {
+        size_t copy_len = (*value_len < found_len) ? *value_len : found_len;
+        memcpy(value, found, copy_len);
+        *value_len = found_len;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef _MPT_SMT_H_
+#define _MPT_SMT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "mpt_arena.h"
+#include "mpt_tree.h"
+
+#define MPT_SMT_DEPTH 256
+#define MPT_SMT_PATH_SIZE (MPT_SMT_DEPTH / 8)
+#define MPT_SMT_LEAF_PREFIX 0x00
+#define MPT_SMT_NODE_PREFIX 0x01
+#define MPT_SMT_EDGE_INVALID 0xFFFF
+
+typedef struct mpt_smt_node {
+    struct mpt_smt_node* children[2];
+    uint8_t path[MPT_SMT_PATH_SIZE];
+    uint8_t hash[MPT_NODE_HASH_SIZE];
+    uint8_t edge_hash[MPT_NODE_HASH_SIZE];
+    uint16_t depth;
+    uint16_t edge_depth;
+    uint16_t value_len;
+    uint8_t key_len;
+    bool dirty;
+    uint8_t data[];
+} mpt_smt_node_t;
+
+typedef struct mpt_smt {
+    mpt_smt_node_t* root;
+    mpt_arena_t arena;
+    uint8_t root_hash[MPT_NODE_HASH_SIZE];
+    size_t size;
+    bool dirty;
+} mpt_smt_t;
+
+int mpt_smt_init(mpt_smt_t* smt);
+
+void mpt_smt_destroy(mpt_smt_t* smt);
+
+void mpt_smt_reset(mpt_smt_t* smt);
+
+int mpt_smt_insert(mpt_smt_t* smt, const uint8_t* key, size_t key_len,
+                   const uint8_t* value, size_t value_len);
+
+int mpt_smt_get(const mpt_smt_t* smt, const uint8_t* key, size_t key_len,
+                uint8_t* value, size_t* value_len);
+
+int mpt_smt_delete(mpt_smt_t* smt, const uint8_t* key, size_t key_len);
+
+int mpt_smt_commit(mpt_smt_t* smt);
+
+int mpt_smt_prove(mpt_smt_t* smt, const uint8_t* key, size_t key_len, mpt_proof_t* proof);
+
+int mpt_smt_verify_proof(const uint8_t* root_hash, const uint8_t* key, size_t key_len,
+                         const mpt_proof_t* proof, bool* exists,
+                         uint8_t* value, size_t* value_len);
+
+const uint8_t* mpt_smt_empty_hash(size_t height);
+
+#endif
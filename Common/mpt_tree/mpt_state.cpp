@@ -0,0 +1,231 @@
+#include "mpt_state.h"
+#include "mpt_rcu.h"
+#include "mpt_tree_common.h"
+#include <string.h>
+
+static size_t mpt_state_bucket(const uint8_t* token_address, size_t capacity) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for (size_t i = 0; i < MPT_STATE_TOKEN_LEN; i++) {
+        hash = (hash ^ token_address[i]) * 0x100000001B3ULL;
+    }
+    return (size_t)hash & (capacity - 1);
+}
+
+static bool mpt_state_empty_root(const uint8_t* root_hash) {
+    for (size_t i = 0; i < MPT_NODE_HASH_SIZE; i++) {
+        if (root_hash[i] != 0) return false;
+    }
+    return true;
+}
+
+static mpt_state_index_t* mpt_state_index_create(size_t capacity) {
+    mpt_state_index_t* index = (mpt_state_index_t*)platform_malloc(sizeof(mpt_state_index_t));
+    if (index == NULL) return NULL;
+    
+    index->slots = (mpt_state_token_t**)platform_malloc(capacity * sizeof(mpt_state_token_t*));
+    if (index->slots == NULL) {
+        platform_free(index);
+        return NULL;
+    }
+    memset(index->slots, 0, capacity * sizeof(mpt_state_token_t*));
+    index->capacity = capacity;
+    index->prev = NULL;
+    return index;
+}
+
+static void mpt_state_index_put(mpt_state_index_t* index, mpt_state_token_t* token) {
+    size_t mask = index->capacity - 1;
+    size_t i = mpt_state_bucket(token->address, index->capacity);
+    
+    while (index->slots[i] != NULL) i = (i + 1) & mask;
+    __atomic_store_n(&index->slots[i], token, __ATOMIC_RELEASE);
+}
+
+static int mpt_state_index_grow(mpt_state_t* state) {
+    mpt_state_index_t* index = mpt_state_index_create(state->index->capacity * 2);
+    if (index == NULL) return -1;
+    
+    for (size_t i = 0; i < state->token_count; i++) {
+        mpt_state_index_put(index, state->tokens[i]);
+    }
+    index->prev = state->index;
+    __atomic_store_n(&state->index, index, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static int mpt_state_reserve(mpt_state_t* state) {
+    if (state->token_count < state->token_capacity) return 0;
+    
+    size_t capacity = state->token_capacity ? state->token_capacity * 2 : MPT_STATE_TOKENS_INITIAL;
+    mpt_state_token_t** tokens = (mpt_state_token_t**)platform_malloc(capacity * sizeof(mpt_state_token_t*));
+    mpt_state_token_t** dirty = (mpt_state_token_t**)platform_malloc(capacity * sizeof(mpt_state_token_t*));
+    if (tokens == NULL || dirty == NULL) {
+        if (tokens) platform_free(tokens);
+        if (dirty) platform_free(dirty);
+        return -1;
+    }
+    
+    if (state->tokens) {
+        memcpy(tokens, state->tokens, state->token_count * sizeof(mpt_state_token_t*));
+        memcpy(dirty, state->dirty, state->dirty_count * sizeof(mpt_state_token_t*));
+        platform_free(state->tokens);
+        platform_free(state->dirty);
+    }
+    state->tokens = tokens;
+    state->dirty = dirty;
+    state->token_capacity = capacity;
+    return 0;
+}
+
+static mpt_state_token_t* mpt_state_lookup(const mpt_state_t* state, const uint8_t* token_address) {
+    const mpt_state_index_t* index = __atomic_load_n(&state->index, __ATOMIC_ACQUIRE);
+    size_t mask = index->capacity - 1;
+    size_t i = mpt_state_bucket(token_address, index->capacity);
+    
+    mpt_state_token_t* token;
+    while ((token = __atomic_load_n(&index->slots[i], __ATOMIC_ACQUIRE)) != NULL) {
+        if (memcmp(token->address, token_address, MPT_STATE_TOKEN_LEN) == 0) return token;
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+static mpt_state_token_t* mpt_state_token_create(mpt_state_t* state, const uint8_t* token_address) {
+    if (mpt_state_reserve(state) != 0) return NULL;
+    if ((state->token_count + 1) * 2 > state->index->capacity &&
+        mpt_state_index_grow(state) != 0) {
+        return NULL;
+    }
+    
+    mpt_state_token_t* token = (mpt_state_token_t*)platform_malloc(sizeof(mpt_state_token_t));
+    if (token == NULL) return NULL;
+    memset(token, 0, sizeof(mpt_state_token_t));
+    memcpy(token->address, token_address, MPT_STATE_TOKEN_LEN);
+    
+    if (mpt_tree_init_alloc(&token->tree, state->alloc) != 0) {
+        platform_free(token);
+        return NULL;
+    }
+    if (state->rcu && mpt_tree_attach_rcu(&token->tree, state->rcu) != 0) {
+        mpt_tree_destroy(&token->tree);
+        platform_free(token);
+        return NULL;
+    }
+    
+    state->tokens[state->token_count++] = token;
+    mpt_state_index_put(state->index, token);
+    return token;
+}
+
+int mpt_state_init(mpt_state_t* state, struct mpt_rcu* rcu) {
+    return mpt_state_init_alloc(state, rcu, NULL);
+}
+
+int mpt_state_init_alloc(mpt_state_t* state, struct mpt_rcu* rcu, struct platform_alloc* alloc) {
+    if (state == NULL) return -1;
+    
+    memset(state, 0, sizeof(mpt_state_t));
+    state->rcu = rcu;
+    state->alloc = alloc;
+    
+    if (mpt_tree_init_alloc(&state->roots, alloc) != 0) return -1;
+    
+    state->index = mpt_state_index_create(MPT_STATE_INDEX_INITIAL);
+    if (state->index == NULL) {
+        mpt_tree_destroy(&state->roots);
+        return -1;
+    }
+    
+    return 0;
+}
+
+void mpt_state_destroy(mpt_state_t* state) {
+    if (state == NULL) return;
+    
+    for (size_t i = 0; i < state->token_count; i++) {
+        mpt_tree_destroy(&state->tokens[i]->tree);
+        platform_free(state->tokens[i]);
+    }
+    if (state->tokens) platform_free(state->tokens);
+    if (state->dirty) platform_free(state->dirty);
+    
+    mpt_state_index_t* index = state->index;
+    while (index != NULL) {
+        mpt_state_index_t* prev = index->prev;
+        platform_free(index->slots);
+        platform_free(index);
+        index = prev;
+    }
+    
+    mpt_tree_destroy(&state->roots);
+    memset(state, 0, sizeof(mpt_state_t));
+}
+
+mpt_tree_t* mpt_state_find(const mpt_state_t* state, const uint8_t* token_address) {
+    if (state == NULL || token_address == NULL) return NULL;
+    
+    mpt_state_token_t* token = mpt_state_lookup(state, token_address);
+    return token ? &token->tree : NULL;
+}
+
+mpt_tree_t* mpt_state_open(mpt_state_t* state, const uint8_t* token_address) {
+    if (state == NULL || token_address == NULL) return NULL;
+    
+    mpt_state_token_t* token = mpt_state_lookup(state, token_address);
+    if (token == NULL) {
+        token = mpt_state_token_create(state, token_address);
+        if (token == NULL) return NULL;
+    }
+    
+    if (!token->dirty) {
+        token->dirty = true;
+        state->dirty[state->dirty_count++] = token;
+    }
+    return &token->tree;
+}
+
+int mpt_state_commit(mpt_state_t* state) {
+    if (state == NULL) return -1;
+    
+    size_t pending = 0;
+    for (size_t i = 0; i < state->dirty_count; i++) {
+        mpt_state_token_t* token = state->dirty[i];
+        
+        if (mpt_tree_commit(&token->tree) != 0) {
+            state->dirty[pending++] = token;
+            continue;
+        }
+        if (memcmp(token->root_hash, token->tree.root_hash, MPT_NODE_HASH_SIZE) == 0) {
+            token->dirty = false;
+            continue;
+        }
+        
+        int ret;
+        if (mpt_state_empty_root(token->tree.root_hash)) {
+            ret = mpt_tree_delete(&state->roots, token->address, MPT_STATE_TOKEN_LEN);
+        } else {
+            ret = mpt_tree_insert(&state->roots, token->address, MPT_STATE_TOKEN_LEN,
+                                  token->tree.root_hash, MPT_NODE_HASH_SIZE);
+        }
+        if (ret != 0) {
+            state->dirty[pending++] = token;
+            continue;
+        }
+        
+        memcpy(token->root_hash, token->tree.root_hash, MPT_NODE_HASH_SIZE);
+        token->dirty = false;
+    }
+    state->dirty_count = pending;
+    
+    if (mpt_tree_commit(&state->roots) != 0) return -1;
+    return pending == 0 ? 0 : -1;
+}
+
+int mpt_state_get_root_hash(mpt_state_t* state, uint8_t* root_hash) {
+    if (state == NULL || root_hash == NULL) return -1;
+    
+    if (mpt_state_commit(state) != 0) return -1;
+    
+    memcpy(root_hash, state->roots.root_hash, MPT_NODE_HASH_SIZE);
+    return 0;
+}
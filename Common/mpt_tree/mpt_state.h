@@ -0,0 +1,52 @@
+#ifndef _MPT_STATE_H_
+#define _MPT_STATE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "mpt_tree.h"
+
+#define MPT_STATE_TOKEN_LEN 42
+#define MPT_STATE_TOKENS_INITIAL 16
+#define MPT_STATE_INDEX_INITIAL 32
+
+typedef struct {
+    uint8_t address[MPT_STATE_TOKEN_LEN];
+    mpt_tree_t tree;
+    uint8_t root_hash[MPT_NODE_HASH_SIZE];
+    bool dirty;
+} mpt_state_token_t;
+
+typedef struct mpt_state_index {
+    struct mpt_state_index* prev;
+    mpt_state_token_t** slots;
+    size_t capacity;
+} mpt_state_index_t;
+
+typedef struct mpt_state {
+    mpt_tree_t roots;
+    mpt_state_token_t** tokens;
+    mpt_state_token_t** dirty;
+    size_t token_count;
+    size_t token_capacity;
+    size_t dirty_count;
+    mpt_state_index_t* index;
+    struct mpt_rcu* rcu;
+    struct platform_alloc* alloc;
+} mpt_state_t;
+
+int mpt_state_init(mpt_state_t* state, struct mpt_rcu* rcu);
+
+int mpt_state_init_alloc(mpt_state_t* state, struct mpt_rcu* rcu, struct platform_alloc* alloc);
+
+void mpt_state_destroy(mpt_state_t* state);
+
+mpt_tree_t* mpt_state_find(const mpt_state_t* state, const uint8_t* token_address);
+
+mpt_tree_t* mpt_state_open(mpt_state_t* state, const uint8_t* token_address);
+
+int mpt_state_commit(mpt_state_t* state);
+
+int mpt_state_get_root_hash(mpt_state_t* state, uint8_t* root_hash);
+
+#endif
@@ -0,0 +1,293 @@
+#include "mpt_store.h"
+#include "mpt_tree_common.h"
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static size_t mpt_store_bucket(const uint8_t* hash, size_t capacity) {
+    uint64_t key;
+    memcpy(&key, hash, sizeof(key));
+    return (size_t)key & (capacity - 1);
+}
+
+static mpt_store_slot_t* mpt_store_find(const mpt_store_t* store, const uint8_t* hash) {
+    size_t mask = store->index_capacity - 1;
+    size_t i = mpt_store_bucket(hash, store->index_capacity);
+    
+    while (store->index[i].offset != 0) {
+        if (memcmp(store->index[i].hash, hash, MPT_STORE_HASH_SIZE) == 0) break;
+        i = (i + 1) & mask;
+    }
+    return &store->index[i];
+}
+
+static int mpt_store_index_resize(mpt_store_t* store, size_t capacity) {
+    mpt_store_slot_t* index = (mpt_store_slot_t*)platform_malloc(capacity * sizeof(mpt_store_slot_t));
+    if (index == NULL) return -1;
+    memset(index, 0, capacity * sizeof(mpt_store_slot_t));
+    
+    mpt_store_slot_t* old = store->index;
+    size_t old_capacity = store->index_capacity;
+    store->index = index;
+    store->index_capacity = capacity;
+    
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].offset != 0) {
+            *mpt_store_find(store, old[i].hash) = old[i];
+        }
+    }
+    
+    if (old) platform_free(old);
+    return 0;
+}
+
+static int mpt_store_index_add(mpt_store_t* store, const uint8_t* hash, uint64_t offset) {
+    if ((store->index_count + 1) * 2 > store->index_capacity &&
+        mpt_store_index_resize(store, store->index_capacity * 2) != 0) {
+        return -1;
+    }
+    
+    mpt_store_slot_t* slot = mpt_store_find(store, hash);
+    if (slot->offset == 0) {
+        memcpy(slot->hash, hash, MPT_STORE_HASH_SIZE);
+        slot->offset = offset;
+        store->index_count++;
+    }
+    return 0;
+}
+
+static int mpt_store_reserve(mpt_store_t* store, size_t len) {
+    if (store->end + len <= store->map_size) return 0;
+    
+    size_t new_size = store->map_size * 2;
+    while (store->end + len > new_size) new_size *= 2;
+    
+    if (ftruncate(store->fd, (off_t)new_size) != 0) return -1;
+    
+    void* map = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+    if (map == MAP_FAILED) return -1;
+    
+    munmap(store->map, store->map_size);
+    store->map = (uint8_t*)map;
+    store->map_size = new_size;
+    return 0;
+}
+
+static int mpt_store_append(mpt_store_t* store, mpt_store_record_type_t type, const uint8_t* hash,
+                            const uint8_t* data, size_t len, uint64_t* offset) {
+    if (len > 0xFFFF) return -1;
+    if (mpt_store_reserve(store, MPT_STORE_RECORD_HEADER + len) != 0) return -1;
+    
+    uint8_t* dst = store->map + store->end;
+    memcpy(dst + 1, hash, MPT_STORE_HASH_SIZE);
+    dst[1 + MPT_STORE_HASH_SIZE] = (uint8_t)(len & 0xFF);
+    dst[2 + MPT_STORE_HASH_SIZE] = (uint8_t)(len >> 8);
+    memcpy(dst + MPT_STORE_RECORD_HEADER, data, len);
+    dst[0] = (uint8_t)type;
+    
+    *offset = store->end;
+    store->end += MPT_STORE_RECORD_HEADER + len;
+    return 0;
+}
+
+static int mpt_store_root_add(mpt_store_t* store, const uint8_t* hash, uint64_t size) {
+    if (store->root_count == store->root_capacity) {
+        size_t capacity = store->root_capacity ? store->root_capacity * 2 : MPT_STORE_ROOTS_INITIAL;
+        mpt_store_root_t* roots = (mpt_store_root_t*)platform_malloc(capacity * sizeof(mpt_store_root_t));
+        if (roots == NULL) return -1;
+        if (store->roots) {
+            memcpy(roots, store->roots, store->root_count * sizeof(mpt_store_root_t));
+            platform_free(store->roots);
+        }
+        store->roots = roots;
+        store->root_capacity = capacity;
+    }
+    
+    memcpy(store->roots[store->root_count].hash, hash, MPT_STORE_HASH_SIZE);
+    store->roots[store->root_count].size = size;
+    store->root_count++;
+    
+    memcpy(store->root_hash, hash, MPT_STORE_HASH_SIZE);
+    store->root_size = size;
+    store->has_root = true;
+    return 0;
+}
+
+static int mpt_store_scan(mpt_store_t* store) {
+    size_t offset = MPT_STORE_HEADER_SIZE;
+    
+    while (offset + MPT_STORE_RECORD_HEADER <= store->map_size) {
+        const uint8_t* record = store->map + offset;
+        size_t len = (size_t)record[1 + MPT_STORE_HASH_SIZE] | ((size_t)record[2 + MPT_STORE_HASH_SIZE] << 8);
+        if (offset + MPT_STORE_RECORD_HEADER + len > store->map_size) break;
+        
+        if (record[0] == MPT_STORE_RECORD_NODE) {
+            if (mpt_store_index_add(store, record + 1, offset) != 0) return -1;
+        } else if (record[0] == MPT_STORE_RECORD_ROOT && len == sizeof(uint64_t)) {
+            const uint8_t* payload = record + MPT_STORE_RECORD_HEADER;
+            uint64_t size = 0;
+            for (size_t i = 0; i < sizeof(uint64_t); i++) {
+                size |= (uint64_t)payload[i] << (8 * i);
+            }
+            if (mpt_store_root_add(store, record + 1, size) != 0) return -1;
+        } else {
+            break;
+        }
+        offset += MPT_STORE_RECORD_HEADER + len;
+    }
+    
+    store->end = offset;
+    store->live_end = offset;
+    if (store->end < store->map_size && store->map[store->end] != 0) {
+        memset(store->map + store->end, 0, store->map_size - store->end);
+    }
+    return 0;
+}
+
+int mpt_store_open(mpt_store_t* store, const char* path) {
+    if (store == NULL || path == NULL) return -1;
+    
+    memset(store, 0, sizeof(mpt_store_t));
+    store->fd = -1;
+    if (strlen(path) >= MPT_STORE_PATH_MAX) return -1;
+    strcpy(store->path, path);
+    
+    store->fd = open(path, O_RDWR | O_CREAT, 0600);
+    if (store->fd < 0) return -1;
+    
+    struct stat st;
+    if (fstat(store->fd, &st) != 0) {
+        mpt_store_close(store);
+        return -1;
+    }
+    
+    size_t size = (size_t)st.st_size;
+    bool fresh = (size == 0);
+    if (fresh) {
+        size = MPT_STORE_INITIAL_SIZE;
+        if (ftruncate(store->fd, (off_t)size) != 0) {
+            mpt_store_close(store);
+            return -1;
+        }
+    }
+    if (size < MPT_STORE_HEADER_SIZE) {
+        mpt_store_close(store);
+        return -1;
+    }
+    
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+    if (map == MAP_FAILED) {
+        mpt_store_close(store);
+        return -1;
+    }
+    store->map = (uint8_t*)map;
+    store->map_size = size;
+    
+    if (fresh) {
+        memcpy(store->map, MPT_STORE_MAGIC, 8);
+    } else if (memcmp(store->map, MPT_STORE_MAGIC, 8) != 0) {
+        mpt_store_close(store);
+        return -1;
+    }
+    
+    if (mpt_store_index_resize(store, MPT_STORE_INDEX_INITIAL) != 0 ||
+        mpt_store_scan(store) != 0) {
+        mpt_store_close(store);
+        return -1;
+    }
+    
+    return 0;
+}
+
+void mpt_store_close(mpt_store_t* store) {
+    if (store == NULL) return;
+    
+    if (store->map) munmap(store->map, store->map_size);
+    if (store->index) platform_free(store->index);
+    if (store->roots) platform_free(store->roots);
+    if (store->fd >= 0) close(store->fd);
+    memset(store, 0, sizeof(mpt_store_t));
+    store->fd = -1;
+}
+
+bool mpt_store_contains(const mpt_store_t* store, const uint8_t* hash) {
+    if (store == NULL || hash == NULL) return false;
+    
+    return mpt_store_find(store, hash)->offset != 0;
+}
+
+int mpt_store_get(const mpt_store_t* store, const uint8_t* hash,
+                  const uint8_t** data, size_t* len) {
+    if (store == NULL || hash == NULL || data == NULL || len == NULL) return -1;
+    
+    const mpt_store_slot_t* slot = mpt_store_find(store, hash);
+    if (slot->offset == 0) return -1;
+    
+    const uint8_t* record = store->map + slot->offset;
+    *len = (size_t)record[1 + MPT_STORE_HASH_SIZE] | ((size_t)record[2 + MPT_STORE_HASH_SIZE] << 8);
+    *data = record + MPT_STORE_RECORD_HEADER;
+    return 0;
+}
+
+int mpt_store_put(mpt_store_t* store, const uint8_t* hash, const uint8_t* data, size_t len) {
+    if (store == NULL || hash == NULL || data == NULL) return -1;
+    
+    if (mpt_store_contains(store, hash)) return 0;
+    
+    uint64_t offset;
+    if (mpt_store_append(store, MPT_STORE_RECORD_NODE, hash, data, len, &offset) != 0) return -1;
+    return mpt_store_index_add(store, hash, offset);
+}
+
+int mpt_store_set_root(mpt_store_t* store, const uint8_t* root_hash, uint64_t size) {
+    if (store == NULL || root_hash == NULL) return -1;
+    
+    if (mpt_store_sync(store) != 0) return -1;
+    
+    uint8_t payload[sizeof(uint64_t)];
+    for (size_t i = 0; i < sizeof(uint64_t); i++) {
+        payload[i] = (uint8_t)(size >> (8 * i));
+    }
+    
+    uint64_t offset;
+    if (mpt_store_append(store, MPT_STORE_RECORD_ROOT, root_hash, payload, sizeof(payload), &offset) != 0) {
+        return -1;
+    }
+    if (mpt_store_sync(store) != 0) return -1;
+    
+    return mpt_store_root_add(store, root_hash, size);
+}
+
+int mpt_store_sync(mpt_store_t* store) {
+    if (store == NULL || store->map == NULL) return -1;
+    
+    return msync(store->map, store->end, MS_SYNC) == 0 ? 0 : -1;
+}
+
+bool mpt_store_needs_compaction(const mpt_store_t* store) {
+    if (store == NULL || store->end < MPT_STORE_COMPACT_MIN) return false;
+    
+    return store->end >= store->live_end * 2;
+}
+
+int mpt_store_replace(mpt_store_t* store, mpt_store_t* fresh) {
+    if (store == NULL || fresh == NULL) return -1;
+    
+    if (mpt_store_sync(fresh) != 0) return -1;
+    if (rename(fresh->path, store->path) != 0) return -1;
+    
+    char path[MPT_STORE_PATH_MAX];
+    strcpy(path, store->path);
+    mpt_store_close(store);
+    
+    *store = *fresh;
+    strcpy(store->path, path);
+    store->live_end = store->end;
+    
+    memset(fresh, 0, sizeof(mpt_store_t));
+    fresh->fd = -1;
+    return 0;
+}
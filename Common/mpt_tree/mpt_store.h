@@ -0,0 +1,70 @@
+#ifndef _MPT_STORE_H_
+#define _MPT_STORE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define MPT_STORE_MAGIC "MPTSTOR1"
+#define MPT_STORE_HEADER_SIZE 16
+#define MPT_STORE_INITIAL_SIZE (1024 * 1024)
+#define MPT_STORE_INDEX_INITIAL 1024
+#define MPT_STORE_HASH_SIZE 32
+#define MPT_STORE_RECORD_HEADER (1 + MPT_STORE_HASH_SIZE + 2)
+#define MPT_STORE_PATH_MAX 256
+#define MPT_STORE_ROOTS_INITIAL 16
+#define MPT_STORE_COMPACT_MIN (4 * 1024 * 1024)
+
+typedef enum {
+    MPT_STORE_RECORD_NODE = 1,
+    MPT_STORE_RECORD_ROOT = 2
+} mpt_store_record_type_t;
+
+typedef struct {
+    uint8_t hash[MPT_STORE_HASH_SIZE];
+    uint64_t offset;
+} mpt_store_slot_t;
+
+typedef struct {
+    uint8_t hash[MPT_STORE_HASH_SIZE];
+    uint64_t size;
+} mpt_store_root_t;
+
+typedef struct mpt_store {
+    char path[MPT_STORE_PATH_MAX];
+    int fd;
+    uint8_t* map;
+    size_t map_size;
+    size_t end;
+    mpt_store_slot_t* index;
+    size_t index_capacity;
+    size_t index_count;
+    uint8_t root_hash[MPT_STORE_HASH_SIZE];
+    uint64_t root_size;
+    bool has_root;
+    mpt_store_root_t* roots;
+    size_t root_count;
+    size_t root_capacity;
+    size_t live_end;
+} mpt_store_t;
+
+int mpt_store_open(mpt_store_t* store, const char* path);
+
+void mpt_store_close(mpt_store_t* store);
+
+bool mpt_store_contains(const mpt_store_t* store, const uint8_t* hash);
+
+int mpt_store_get(const mpt_store_t* store, const uint8_t* hash,
+                  const uint8_t** data, size_t* len);
+
+int mpt_store_put(mpt_store_t* store, const uint8_t* hash, const uint8_t* data, size_t len);
+
+int mpt_store_set_root(mpt_store_t* store, const uint8_t* root_hash, uint64_t size);
+
+int mpt_store_sync(mpt_store_t* store);
+
+bool mpt_store_needs_compaction(const mpt_store_t* store);
+
+int mpt_store_replace(mpt_store_t* store, mpt_store_t* fresh);
+
+#endif
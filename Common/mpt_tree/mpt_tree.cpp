@@ -1,198 +1,3295 @@
 #include "mpt_tree.h"
 #include "mpt_tree_common.h"
+#include "mpt_store.h"
+#include "mpt_rcu.h"
+#include "mpt_smt.h"
+#include "mpt_journal.h"
+#include "../thread_pool/thread_pool.h"
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
 
-static uint8_t nibble_to_hex(uint8_t nibble) {
-    if (nibble < 10) return '0' + nibble;
-    return 'a' + (nibble - 10);
+static size_t key_to_nibbles(const uint8_t* key, size_t key_len, uint8_t* nibbles) {
+    for (size_t i = 0; i < key_len; i++) {
+        nibbles[2 * i] = key[i] >> 4;
+        nibbles[2 * i + 1] = key[i] & 0x0F;
+    }
+    return key_len * 2;
+}
+
+static size_t common_prefix_len(const uint8_t* a, size_t a_len,
+                                const uint8_t* b, size_t b_len) {
+    size_t n = (a_len < b_len) ? a_len : b_len;
+    size_t i = 0;
+    while (i < n && a[i] == b[i]) i++;
+    return i;
+}
+
+static size_t packed_len(size_t path_len) {
+    return (path_len + 1) / 2;
+}
+
+static void pack_nibbles(const uint8_t* nibbles, size_t len, uint8_t* out) {
+    for (size_t i = 0; i < len; i += 2) {
+        uint8_t hi = nibbles[i];
+        uint8_t lo = (i + 1 < len) ? nibbles[i + 1] : 0;
+        out[i / 2] = (uint8_t)((hi << 4) | lo);
+    }
+}
+
+static void unpack_nibbles(const uint8_t* packed, size_t len, uint8_t* nibbles) {
+    for (size_t i = 0; i < len; i++) {
+        nibbles[i] = (i & 1) ? (packed[i / 2] & 0x0F) : (packed[i / 2] >> 4);
+    }
+}
+
+static bool packed_path_equals(const uint8_t* packed, size_t packed_nibbles,
+                               const uint8_t* nibbles, size_t len) {
+    if (packed_nibbles != len) return false;
+    for (size_t i = 0; i + 1 < len; i += 2) {
+        if (packed[i / 2] != (uint8_t)((nibbles[i] << 4) | nibbles[i + 1])) return false;
+    }
+    if ((len & 1) && (packed[len / 2] >> 4) != nibbles[len - 1]) return false;
+    return true;
+}
+
+static bool packed_path_is_prefix(const uint8_t* packed, size_t packed_nibbles,
+                                  const uint8_t* nibbles, size_t len) {
+    if (packed_nibbles > len) return false;
+    return packed_path_equals(packed, packed_nibbles, nibbles, packed_nibbles);
+}
+
+static uint8_t key_nibble(const uint8_t* key, size_t pos) {
+    return (pos & 1) ? (key[pos / 2] & 0x0F) : (key[pos / 2] >> 4);
+}
+
+static bool packed_path_matches_key(const uint8_t* packed, size_t len,
+                                    const uint8_t* key, size_t pos) {
+    const uint8_t* src = key + pos / 2;
+    size_t full = len / 2;
+    if ((pos & 1) == 0) {
+        if (memcmp(packed, src, full) != 0) return false;
+    } else {
+        for (size_t i = 0; i < full; i++) {
+            if (packed[i] != (uint8_t)((src[i] << 4) | (src[i + 1] >> 4))) return false;
+        }
+    }
+    return !(len & 1) || (packed[full] >> 4) == key_nibble(key, pos + len - 1);
+}
+
+static size_t branch_child_count(const mpt_branch_t* branch) {
+    return (size_t)__builtin_popcount(branch->node.bitmap);
+}
+
+static size_t branch_child_index(uint16_t bitmap, uint8_t nibble) {
+    return (size_t)__builtin_popcount(bitmap & ((1u << nibble) - 1));
+}
+
+static mpt_leaf_t* branch_value(const mpt_branch_t* branch) {
+    if (!(branch->node.flags & MPT_NODE_HAS_VALUE)) return NULL;
+    return (mpt_leaf_t*)branch->children[branch_child_count(branch)];
+}
+
+static const uint8_t* leaf_value(const mpt_leaf_t* leaf, size_t* value_len) {
+    const uint8_t* value = leaf->data + packed_len(leaf->node.path_len);
+    if (leaf->node.flags & MPT_NODE_INLINE_VALUE) {
+        *value_len = MPT_INLINE_VALUE_LEN;
+        return value;
+    }
+    *value_len = (size_t)value[0] | ((size_t)value[1] << 8);
+    return value + 2;
+}
+
+static size_t leaf_size(size_t path_len, size_t value_len) {
+    size_t size = sizeof(mpt_leaf_t) + packed_len(path_len) + value_len;
+    if (value_len != MPT_INLINE_VALUE_LEN) size += 2;
+    return size;
+}
+
+static size_t branch_size(size_t slots) {
+    return sizeof(mpt_branch_t) + slots * sizeof(mpt_node_t*);
+}
+
+static size_t mpt_node_size(const mpt_node_t* node) {
+    switch (MPT_NODE_TYPE(node)) {
+        case MPT_NODE_LEAF: {
+            size_t value_len;
+            leaf_value((const mpt_leaf_t*)node, &value_len);
+            return leaf_size(node->path_len, value_len);
+        }
+        
+        case MPT_NODE_EXTENSION:
+            return sizeof(mpt_extension_t) + packed_len(node->path_len);
+        
+        case MPT_NODE_BRANCH: {
+            const mpt_branch_t* branch = (const mpt_branch_t*)node;
+            size_t slots = branch_child_count(branch);
+            if (node->flags & MPT_NODE_HAS_VALUE) slots++;
+            return branch_size(slots);
+        }
+        
+        case MPT_NODE_EMPTY:
+            return sizeof(mpt_node_t);
+        
+        default:
+            return 0;
+    }
+}
+
+static size_t mpt_node_encode(const mpt_node_t* node, uint8_t* buffer) {
+    size_t offset = 0;
+    
+    buffer[offset++] = (uint8_t)MPT_NODE_TYPE(node);
+    
+    switch (MPT_NODE_TYPE(node)) {
+        case MPT_NODE_LEAF: {
+            const mpt_leaf_t* leaf = (const mpt_leaf_t*)node;
+            size_t value_len;
+            const uint8_t* value = leaf_value(leaf, &value_len);
+            buffer[offset++] = leaf->node.path_len;
+            memcpy(buffer + offset, leaf->data, packed_len(leaf->node.path_len));
+            offset += packed_len(leaf->node.path_len);
+            buffer[offset++] = (uint8_t)(value_len & 0xFF);
+            buffer[offset++] = (uint8_t)(value_len >> 8);
+            memcpy(buffer + offset, value, value_len);
+            offset += value_len;
+            break;
+        }
+        
+        case MPT_NODE_EXTENSION: {
+            const mpt_extension_t* ext = (const mpt_extension_t*)node;
+            buffer[offset++] = ext->node.path_len;
+            memcpy(buffer + offset, ext->path, packed_len(ext->node.path_len));
+            offset += packed_len(ext->node.path_len);
+            if (ext->next) {
+                memcpy(buffer + offset, ext->next->hash, MPT_NODE_HASH_SIZE);
+                offset += MPT_NODE_HASH_SIZE;
+            }
+            break;
+        }
+        
+        case MPT_NODE_BRANCH: {
+            const mpt_branch_t* branch = (const mpt_branch_t*)node;
+            size_t count = branch_child_count(branch);
+            buffer[offset++] = (uint8_t)(branch->node.bitmap & 0xFF);
+            buffer[offset++] = (uint8_t)(branch->node.bitmap >> 8);
+            for (size_t i = 0; i < count; i++) {
+                memcpy(buffer + offset, branch->children[i]->hash, MPT_NODE_HASH_SIZE);
+                offset += MPT_NODE_HASH_SIZE;
+            }
+            const mpt_leaf_t* value_leaf = branch_value(branch);
+            buffer[offset++] = value_leaf ? 1 : 0;
+            if (value_leaf) {
+                size_t value_len;
+                const uint8_t* value = leaf_value(value_leaf, &value_len);
+                buffer[offset++] = (uint8_t)(value_len & 0xFF);
+                buffer[offset++] = (uint8_t)(value_len >> 8);
+                memcpy(buffer + offset, value, value_len);
+                offset += value_len;
+            }
+            break;
+        }
+        
+        default:
+            break;
+    }
+    
+    return offset;
+}
+
+static void mpt_node_hash_value(platform_sha256_ctx_t* ctx, const mpt_leaf_t* leaf) {
+    size_t value_len;
+    const uint8_t* value = leaf_value(leaf, &value_len);
+    uint8_t len_bytes[2] = { (uint8_t)(value_len & 0xFF), (uint8_t)(value_len >> 8) };
+    platform_sha256_update(ctx, len_bytes, sizeof(len_bytes));
+    platform_sha256_update(ctx, value, value_len);
+}
+
+static void mpt_node_rehash(mpt_node_t* node) {
+    platform_sha256_ctx_t ctx;
+    platform_sha256_init(&ctx);
+    
+    uint8_t header[3];
+    header[0] = (uint8_t)MPT_NODE_TYPE(node);
+    
+    switch (MPT_NODE_TYPE(node)) {
+        case MPT_NODE_LEAF: {
+            const mpt_leaf_t* leaf = (const mpt_leaf_t*)node;
+            header[1] = leaf->node.path_len;
+            platform_sha256_update(&ctx, header, 2);
+            platform_sha256_update(&ctx, leaf->data, packed_len(leaf->node.path_len));
+            mpt_node_hash_value(&ctx, leaf);
+            break;
+        }
+        
+        case MPT_NODE_EXTENSION: {
+            const mpt_extension_t* ext = (const mpt_extension_t*)node;
+            header[1] = ext->node.path_len;
+            platform_sha256_update(&ctx, header, 2);
+            platform_sha256_update(&ctx, ext->path, packed_len(ext->node.path_len));
+            if (ext->next) {
+                platform_sha256_update(&ctx, ext->next->hash, MPT_NODE_HASH_SIZE);
+            }
+            break;
+        }
+        
+        case MPT_NODE_BRANCH: {
+            const mpt_branch_t* branch = (const mpt_branch_t*)node;
+            size_t count = branch_child_count(branch);
+            header[1] = (uint8_t)(branch->node.bitmap & 0xFF);
+            header[2] = (uint8_t)(branch->node.bitmap >> 8);
+            platform_sha256_update(&ctx, header, 3);
+            for (size_t i = 0; i < count; i++) {
+                platform_sha256_update(&ctx, branch->children[i]->hash, MPT_NODE_HASH_SIZE);
+            }
+            const mpt_leaf_t* value_leaf = branch_value(branch);
+            uint8_t has_value = value_leaf ? 1 : 0;
+            platform_sha256_update(&ctx, &has_value, 1);
+            if (value_leaf) mpt_node_hash_value(&ctx, value_leaf);
+            break;
+        }
+        
+        default:
+            platform_sha256_update(&ctx, header, 1);
+            break;
+    }
+    
+    platform_sha256_final(&ctx, node->hash);
+}
+
+__attribute__((noinline))
+static void mpt_node_rehash_many(mpt_node_t** nodes, size_t count) {
+    uint8_t buffers[MPT_HASH_LANES][MPT_MAX_NODE_ENCODING];
+    const uint8_t* data[MPT_HASH_LANES];
+    size_t lens[MPT_HASH_LANES];
+    uint8_t* hashes[MPT_HASH_LANES];
+    if (count == 0) return;
+    
+    for (size_t i = 0; i < count; i++) {
+        lens[i] = mpt_node_encode(nodes[i], buffers[i]);
+        data[i] = buffers[i];
+        hashes[i] = nodes[i]->hash;
+    }
+    platform_sha256_many(data, lens, hashes, count);
+    
+    for (size_t i = 0; i < count; i++) {
+        nodes[i]->flags &= (uint8_t)~MPT_NODE_DIRTY;
+    }
+}
+
+static void mpt_node_hash_children(mpt_node_t* node) {
+    if (MPT_NODE_TYPE(node) == MPT_NODE_EXTENSION) {
+        mpt_node_t* next = ((mpt_extension_t*)node)->next;
+        if (next && (next->flags & MPT_NODE_DIRTY)) {
+            mpt_node_hash_children(next);
+            mpt_node_rehash(next);
+            next->flags &= (uint8_t)~MPT_NODE_DIRTY;
+        }
+    } else if (MPT_NODE_TYPE(node) == MPT_NODE_BRANCH) {
+        mpt_branch_t* branch = (mpt_branch_t*)node;
+        size_t count = branch_child_count(branch);
+        mpt_node_t* dirty[MPT_HASH_LANES];
+        size_t dirty_count = 0;
+        
+        for (size_t i = 0; i < count; i++) {
+            mpt_node_t* child = branch->children[i];
+            if (!(child->flags & MPT_NODE_DIRTY)) continue;
+            mpt_node_hash_children(child);
+            dirty[dirty_count++] = child;
+        }
+        
+        if (dirty_count == 1) {
+            mpt_node_rehash(dirty[0]);
+            dirty[0]->flags &= (uint8_t)~MPT_NODE_DIRTY;
+        } else if (dirty_count > 1) {
+            mpt_node_rehash_many(dirty, dirty_count);
+        }
+    }
+}
+
+void mpt_node_hash(mpt_node_t* node, uint8_t* hash) {
+    if (node == NULL || hash == NULL) return;
+    
+    if (node->flags & MPT_NODE_DIRTY) {
+        mpt_node_hash_children(node);
+        mpt_node_rehash(node);
+        node->flags &= (uint8_t)~MPT_NODE_DIRTY;
+    }
+    
+    memcpy(hash, node->hash, MPT_NODE_HASH_SIZE);
+}
+
+typedef struct {
+    thread_pool_task_t task;
+    thread_pool_t* pool;
+    mpt_node_t* node;
+    size_t weight;
+} mpt_hash_job_t;
+
+static void mpt_node_hash_parallel(thread_pool_t* pool, mpt_node_t* node, size_t weight);
+
+static void mpt_hash_job_run(void* arg) {
+    mpt_hash_job_t* job = (mpt_hash_job_t*)arg;
+    mpt_node_hash_parallel(job->pool, job->node, job->weight);
+}
+
+static void mpt_node_hash_parallel(thread_pool_t* pool, mpt_node_t* node, size_t weight) {
+    if (!(node->flags & MPT_NODE_DIRTY)) return;
+    
+    if (weight < MPT_PARALLEL_GRAIN) {
+        uint8_t hash[MPT_NODE_HASH_SIZE];
+        mpt_node_hash(node, hash);
+        return;
+    }
+    
+    if (MPT_NODE_TYPE(node) == MPT_NODE_EXTENSION) {
+        mpt_node_t* next = ((mpt_extension_t*)node)->next;
+        if (next) mpt_node_hash_parallel(pool, next, weight);
+    } else if (MPT_NODE_TYPE(node) == MPT_NODE_BRANCH) {
+        mpt_branch_t* branch = (mpt_branch_t*)node;
+        size_t count = branch_child_count(branch);
+        mpt_hash_job_t jobs[16];
+        size_t job_count = 0;
+        
+        for (size_t i = 0; i < count; i++) {
+            if (branch->children[i]->flags & MPT_NODE_DIRTY) {
+                jobs[job_count].pool = pool;
+                jobs[job_count].node = branch->children[i];
+                jobs[job_count].weight = weight / count;
+                job_count++;
+            }
+        }
+        
+        for (size_t i = 1; i < job_count; i++) {
+            thread_pool_spawn(pool, &jobs[i].task, mpt_hash_job_run, &jobs[i]);
+        }
+        if (job_count > 0) {
+            mpt_hash_job_run(&jobs[0]);
+        }
+        for (size_t i = 1; i < job_count; i++) {
+            thread_pool_wait(pool, &jobs[i].task);
+        }
+    }
+    
+    mpt_node_rehash(node);
+    node->flags &= (uint8_t)~MPT_NODE_DIRTY;
+}
+
+static mpt_node_t* mpt_node_create(mpt_arena_t* arena, mpt_node_type_t type, size_t size) {
+    mpt_node_t* node = (mpt_node_t*)mpt_arena_alloc(arena, size);
+    if (node == NULL) return NULL;
+    
+    memset(node, 0, size);
+    node->refs = 1;
+    node->flags = (uint8_t)type | MPT_NODE_DIRTY;
+    return node;
+}
+
+static void mpt_node_release(mpt_arena_t* arena, mpt_node_t* node) {
+    mpt_arena_free(arena, node, mpt_node_size(node));
+}
+
+static void mpt_node_ref_children(mpt_node_t* node) {
+    if (MPT_NODE_TYPE(node) == MPT_NODE_EXTENSION) {
+        mpt_node_t* next = ((mpt_extension_t*)node)->next;
+        if (next) next->refs++;
+    } else if (MPT_NODE_TYPE(node) == MPT_NODE_BRANCH) {
+        mpt_branch_t* branch = (mpt_branch_t*)node;
+        size_t slots = branch_child_count(branch) + ((node->flags & MPT_NODE_HAS_VALUE) ? 1 : 0);
+        for (size_t i = 0; i < slots; i++) {
+            branch->children[i]->refs++;
+        }
+    }
+}
+
+static void mpt_node_unref(mpt_arena_t* arena, mpt_node_t* node) {
+    if (node == NULL || --node->refs > 0) return;
+    
+    if (MPT_NODE_TYPE(node) == MPT_NODE_EXTENSION) {
+        mpt_node_unref(arena, ((mpt_extension_t*)node)->next);
+    } else if (MPT_NODE_TYPE(node) == MPT_NODE_BRANCH) {
+        mpt_branch_t* branch = (mpt_branch_t*)node;
+        size_t slots = branch_child_count(branch) + ((node->flags & MPT_NODE_HAS_VALUE) ? 1 : 0);
+        for (size_t i = 0; i < slots; i++) {
+            mpt_node_unref(arena, branch->children[i]);
+        }
+    }
+    mpt_node_release(arena, node);
+}
+
+static void mpt_node_retire(mpt_arena_t* arena, mpt_node_t* node) {
+    if (node->refs == 1) {
+        mpt_node_release(arena, node);
+        return;
+    }
+    mpt_node_ref_children(node);
+    node->refs--;
+}
+
+static mpt_node_t* mpt_node_make_mut(mpt_arena_t* arena, mpt_node_t** slot) {
+    mpt_node_t* node = *slot;
+    if (node->refs == 1) return node;
+    
+    size_t size = mpt_node_size(node);
+    mpt_node_t* copy = (mpt_node_t*)mpt_arena_alloc(arena, size);
+    if (copy == NULL) return NULL;
+    
+    memcpy(copy, node, size);
+    copy->refs = 1;
+    mpt_node_ref_children(copy);
+    node->refs--;
+    *slot = copy;
+    return copy;
+}
+
+static mpt_node_t* mpt_leaf_create(mpt_arena_t* arena,
+                                   const uint8_t* path, size_t path_len,
+                                   const uint8_t* value, size_t value_len) {
+    mpt_leaf_t* leaf = (mpt_leaf_t*)mpt_node_create(arena, MPT_NODE_LEAF,
+                                                    leaf_size(path_len, value_len));
+    if (leaf == NULL) return NULL;
+    
+    leaf->node.path_len = (uint8_t)path_len;
+    pack_nibbles(path, path_len, leaf->data);
+    uint8_t* dst = leaf->data + packed_len(path_len);
+    if (value_len == MPT_INLINE_VALUE_LEN) {
+        leaf->node.flags |= MPT_NODE_INLINE_VALUE;
+    } else {
+        *dst++ = (uint8_t)(value_len & 0xFF);
+        *dst++ = (uint8_t)(value_len >> 8);
+    }
+    memcpy(dst, value, value_len);
+    return &leaf->node;
+}
+
+static mpt_node_t* mpt_wrap_extension(mpt_arena_t* arena,
+                                      const uint8_t* path, size_t path_len,
+                                      mpt_node_t* child) {
+    if (path_len == 0) return child;
+    
+    mpt_extension_t* ext = (mpt_extension_t*)mpt_node_create(arena, MPT_NODE_EXTENSION,
+                                                             sizeof(mpt_extension_t) + packed_len(path_len));
+    if (ext == NULL) return NULL;
+    
+    ext->node.path_len = (uint8_t)path_len;
+    pack_nibbles(path, path_len, ext->path);
+    ext->next = child;
+    return &ext->node;
+}
+
+static mpt_branch_t* mpt_branch_create(mpt_arena_t* arena, uint16_t bitmap, bool has_value) {
+    size_t slots = (size_t)__builtin_popcount(bitmap) + (has_value ? 1 : 0);
+    
+    mpt_branch_t* branch = (mpt_branch_t*)mpt_node_create(arena, MPT_NODE_BRANCH, branch_size(slots));
+    if (branch == NULL) return NULL;
+    
+    branch->node.bitmap = bitmap;
+    if (has_value) branch->node.flags |= MPT_NODE_HAS_VALUE;
+    return branch;
+}
+
+static mpt_branch_t* mpt_branch_resize(mpt_arena_t* arena, mpt_node_t** slot,
+                                       uint16_t bitmap, bool has_value) {
+    mpt_branch_t* old = (mpt_branch_t*)*slot;
+    mpt_branch_t* branch = mpt_branch_create(arena, bitmap, has_value);
+    if (branch == NULL) return NULL;
+    
+    uint16_t shared = (uint16_t)(bitmap & old->node.bitmap);
+    for (uint8_t nibble = 0; nibble < 16; nibble++) {
+        if (shared & (1u << nibble)) {
+            branch->children[branch_child_index(bitmap, nibble)] =
+                old->children[branch_child_index(old->node.bitmap, nibble)];
+        }
+    }
+    mpt_leaf_t* value_leaf = branch_value(old);
+    if (has_value && value_leaf) {
+        branch->children[branch_child_count(branch)] = &value_leaf->node;
+    }
+    
+    mpt_node_retire(arena, &old->node);
+    *slot = &branch->node;
+    return branch;
+}
+
+static mpt_node_t* mpt_split_branch(mpt_arena_t* arena, const uint8_t* prefix, size_t prefix_len,
+                                    int a_nibble, mpt_node_t* a, int b_nibble, mpt_node_t* b) {
+    uint16_t bitmap = 0;
+    if (a_nibble >= 0) bitmap |= (uint16_t)(1u << a_nibble);
+    if (b_nibble >= 0) bitmap |= (uint16_t)(1u << b_nibble);
+    mpt_branch_t* branch = mpt_branch_create(arena, bitmap, a_nibble < 0 || b_nibble < 0);
+    if (branch == NULL) return NULL;
+    
+    size_t value_slot = branch_child_count(branch);
+    branch->children[(a_nibble < 0) ? value_slot : branch_child_index(bitmap, (uint8_t)a_nibble)] = a;
+    branch->children[(b_nibble < 0) ? value_slot : branch_child_index(bitmap, (uint8_t)b_nibble)] = b;
+    
+    mpt_node_t* split = mpt_wrap_extension(arena, prefix, prefix_len, &branch->node);
+    if (split == NULL) {
+        mpt_node_release(arena, &branch->node);
+        return NULL;
+    }
+    return split;
+}
+
+static mpt_node_t* mpt_stub_create(mpt_arena_t* arena, const uint8_t* hash) {
+    mpt_node_t* stub = mpt_node_create(arena, MPT_NODE_EMPTY, sizeof(mpt_node_t));
+    if (stub == NULL) return NULL;
+    
+    stub->flags = (uint8_t)MPT_NODE_EMPTY;
+    memcpy(stub->hash, hash, MPT_NODE_HASH_SIZE);
+    return stub;
+}
+
+static mpt_node_t* mpt_node_decode(mpt_arena_t* arena, const uint8_t* data, size_t len) {
+    if (len < 2) return NULL;
+    
+    uint8_t path[MPT_MAX_PATH_LEN];
+    mpt_node_t* node = NULL;
+    
+    switch (data[0]) {
+        case MPT_NODE_LEAF: {
+            size_t path_len = data[1];
+            size_t offset = 2 + packed_len(path_len);
+            if (path_len > MPT_MAX_PATH_LEN || len < offset + 2) return NULL;
+            size_t value_len = (size_t)data[offset] | ((size_t)data[offset + 1] << 8);
+            if (value_len > MPT_MAX_VALUE_LEN || len != offset + 2 + value_len) return NULL;
+            unpack_nibbles(data + 2, path_len, path);
+            node = mpt_leaf_create(arena, path, path_len, data + offset + 2, value_len);
+            break;
+        }
+        
+        case MPT_NODE_EXTENSION: {
+            size_t path_len = data[1];
+            size_t offset = 2 + packed_len(path_len);
+            if (path_len == 0 || path_len > MPT_MAX_PATH_LEN || len != offset + MPT_NODE_HASH_SIZE) return NULL;
+            mpt_node_t* next = mpt_stub_create(arena, data + offset);
+            if (next == NULL) return NULL;
+            unpack_nibbles(data + 2, path_len, path);
+            node = mpt_wrap_extension(arena, path, path_len, next);
+            if (node == NULL) mpt_node_release(arena, next);
+            break;
+        }
+        
+        case MPT_NODE_BRANCH: {
+            if (len < 4) return NULL;
+            uint16_t bitmap = (uint16_t)(data[1] | (data[2] << 8));
+            size_t count = (size_t)__builtin_popcount(bitmap);
+            size_t offset = 3 + count * MPT_NODE_HASH_SIZE;
+            if (len < offset + 1 || data[offset] > 1) return NULL;
+            bool has_value = (data[offset] == 1);
+            size_t value_len = 0;
+            if (has_value) {
+                if (len < offset + 3) return NULL;
+                value_len = (size_t)data[offset + 1] | ((size_t)data[offset + 2] << 8);
+                if (value_len > MPT_MAX_VALUE_LEN || len != offset + 3 + value_len) return NULL;
+            } else if (len != offset + 1) {
+                return NULL;
+            }
+            
+            mpt_branch_t* branch = mpt_branch_create(arena, bitmap, has_value);
+            if (branch == NULL) return NULL;
+            for (size_t i = 0; i < count; i++) {
+                branch->children[i] = mpt_stub_create(arena, data + 3 + i * MPT_NODE_HASH_SIZE);
+                if (branch->children[i] == NULL) {
+                    mpt_node_unref(arena, &branch->node);
+                    return NULL;
+                }
+            }
+            if (has_value) {
+                branch->children[count] = mpt_leaf_create(arena, data, 0, data + offset + 3, value_len);
+                if (branch->children[count] == NULL) {
+                    mpt_node_unref(arena, &branch->node);
+                    return NULL;
+                }
+            }
+            node = &branch->node;
+            break;
+        }
+        
+        default:
+            return NULL;
+    }
+    
+    if (node) node->flags &= (uint8_t)~MPT_NODE_DIRTY;
+    return node;
+}
+
+static size_t mpt_cache_bucket(const mpt_node_cache_t* cache, const uint8_t* hash) {
+    uint64_t key;
+    memcpy(&key, hash, sizeof(key));
+    return (size_t)key & (cache->bucket_count - 1);
+}
+
+static int mpt_cache_init(mpt_node_cache_t* cache, size_t capacity) {
+    size_t bucket_count = MPT_CACHE_MIN_BUCKETS;
+    while (bucket_count < capacity * 2) bucket_count *= 2;
+    
+    cache->buckets = (mpt_cache_entry_t**)platform_malloc(bucket_count * sizeof(mpt_cache_entry_t*));
+    if (cache->buckets == NULL) return -1;
+    
+    memset(cache->buckets, 0, bucket_count * sizeof(mpt_cache_entry_t*));
+    cache->bucket_count = bucket_count;
+    cache->capacity = capacity;
+    return 0;
+}
+
+static void mpt_cache_unlink(mpt_node_cache_t* cache, mpt_cache_entry_t* entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else cache->lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else cache->lru_tail = entry->lru_prev;
+}
+
+static void mpt_cache_push_front(mpt_node_cache_t* cache, mpt_cache_entry_t* entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head) cache->lru_head->lru_prev = entry;
+    else cache->lru_tail = entry;
+    cache->lru_head = entry;
+}
+
+static void mpt_cache_trim(mpt_tree_t* tree) {
+    mpt_node_cache_t* cache = &tree->cache;
+    
+    while (cache->count > cache->capacity) {
+        mpt_cache_entry_t* entry = cache->lru_tail;
+        mpt_cache_entry_t** link = &cache->buckets[mpt_cache_bucket(cache, entry->node->hash)];
+        while (*link != entry) link = &(*link)->next;
+        *link = entry->next;
+        
+        mpt_cache_unlink(cache, entry);
+        mpt_node_unref(&tree->arena, entry->node);
+        platform_free(entry);
+        cache->count--;
+    }
+}
+
+static void mpt_cache_clear(mpt_node_cache_t* cache) {
+    mpt_cache_entry_t* entry = cache->lru_head;
+    while (entry) {
+        mpt_cache_entry_t* next = entry->lru_next;
+        platform_free(entry);
+        entry = next;
+    }
+    
+    if (cache->buckets) memset(cache->buckets, 0, cache->bucket_count * sizeof(mpt_cache_entry_t*));
+    cache->lru_head = NULL;
+    cache->lru_tail = NULL;
+    cache->count = 0;
+}
+
+static mpt_node_t* mpt_node_load(mpt_tree_t* tree, const uint8_t* hash) {
+    mpt_node_cache_t* cache = &tree->cache;
+    if (tree->store == NULL) return NULL;
+    
+    size_t bucket = mpt_cache_bucket(cache, hash);
+    for (mpt_cache_entry_t* entry = cache->buckets[bucket]; entry != NULL; entry = entry->next) {
+        if (memcmp(entry->node->hash, hash, MPT_NODE_HASH_SIZE) == 0) {
+            mpt_cache_unlink(cache, entry);
+            mpt_cache_push_front(cache, entry);
+            cache->hits++;
+            return entry->node;
+        }
+    }
+    cache->misses++;
+    
+    const uint8_t* data;
+    size_t len;
+    if (mpt_store_get(tree->store, hash, &data, &len) != 0) return NULL;
+    
+    uint8_t check[MPT_NODE_HASH_SIZE];
+    platform_sha256(data, len, check);
+    if (memcmp(check, hash, MPT_NODE_HASH_SIZE) != 0) return NULL;
+    
+    mpt_node_t* node = mpt_node_decode(&tree->arena, data, len);
+    if (node == NULL) return NULL;
+    memcpy(node->hash, hash, MPT_NODE_HASH_SIZE);
+    
+    mpt_cache_entry_t* entry = (mpt_cache_entry_t*)platform_malloc(sizeof(mpt_cache_entry_t));
+    if (entry == NULL) {
+        mpt_node_unref(&tree->arena, node);
+        return NULL;
+    }
+    
+    entry->node = node;
+    entry->next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    mpt_cache_push_front(cache, entry);
+    cache->count++;
+    return node;
+}
+
+static int mpt_node_resolve(mpt_tree_t* tree, mpt_node_t** slot) {
+    mpt_node_t* stub = *slot;
+    if (stub == NULL || MPT_NODE_TYPE(stub) != MPT_NODE_EMPTY) return 0;
+    
+    mpt_node_t* node = mpt_node_load(tree, stub->hash);
+    if (node == NULL) return -1;
+    
+    node->refs++;
+    mpt_node_unref(&tree->arena, stub);
+    *slot = node;
+    return 0;
+}
+
+static int mpt_node_persist(mpt_tree_t* tree, const mpt_node_t* node) {
+    if (MPT_NODE_TYPE(node) == MPT_NODE_EMPTY || mpt_store_contains(tree->store, node->hash)) return 0;
+    
+    if (MPT_NODE_TYPE(node) == MPT_NODE_EXTENSION) {
+        const mpt_node_t* next = ((const mpt_extension_t*)node)->next;
+        if (next && mpt_node_persist(tree, next) != 0) return -1;
+    } else if (MPT_NODE_TYPE(node) == MPT_NODE_BRANCH) {
+        const mpt_branch_t* branch = (const mpt_branch_t*)node;
+        size_t count = branch_child_count(branch);
+        for (size_t i = 0; i < count; i++) {
+            if (mpt_node_persist(tree, branch->children[i]) != 0) return -1;
+        }
+    }
+    
+    uint8_t buffer[MPT_MAX_NODE_ENCODING];
+    size_t len = mpt_node_encode(node, buffer);
+    return mpt_store_put(tree->store, node->hash, buffer, len);
+}
+
+static int mpt_node_insert(mpt_tree_t* tree, mpt_node_t** slot,
+                           const uint8_t* path, size_t path_len,
+                           const uint8_t* value, size_t value_len, bool* inserted) {
+    mpt_arena_t* arena = &tree->arena;
+    if (mpt_node_resolve(tree, slot) != 0) return -1;
+    mpt_node_t* node = *slot;
+    
+    if (node == NULL) {
+        node = mpt_leaf_create(arena, path, path_len, value, value_len);
+        if (node == NULL) return -1;
+        *slot = node;
+        *inserted = true;
+        return 0;
+    }
+    
+    switch (MPT_NODE_TYPE(node)) {
+        case MPT_NODE_LEAF: {
+            mpt_leaf_t* leaf = (mpt_leaf_t*)node;
+            uint8_t leaf_path[MPT_MAX_PATH_LEN];
+            size_t leaf_len = leaf->node.path_len;
+            unpack_nibbles(leaf->data, leaf_len, leaf_path);
+            
+            size_t old_len;
+            const uint8_t* old_value = leaf_value(leaf, &old_len);
+            size_t common = common_prefix_len(leaf_path, leaf_len, path, path_len);
+            
+            if (common == leaf_len && common == path_len) {
+                if (old_len == value_len && node->refs == 1) {
+                    memcpy((uint8_t*)old_value, value, value_len);
+                    node->flags |= MPT_NODE_DIRTY;
+                } else {
+                    mpt_node_t* replacement = mpt_leaf_create(arena, path, path_len, value, value_len);
+                    if (replacement == NULL) return -1;
+                    mpt_node_unref(arena, node);
+                    *slot = replacement;
+                }
+                *inserted = false;
+                return 0;
+            }
+            
+            int old_nibble = (common < leaf_len) ? leaf_path[common] : -1;
+            size_t old_rest = (common < leaf_len) ? leaf_len - common - 1 : 0;
+            mpt_node_t* old_child = mpt_leaf_create(arena, leaf_path + leaf_len - old_rest, old_rest,
+                                                    old_value, old_len);
+            if (old_child == NULL) return -1;
+            
+            int new_nibble = (common < path_len) ? path[common] : -1;
+            size_t new_rest = (common < path_len) ? path_len - common - 1 : 0;
+            mpt_node_t* new_child = mpt_leaf_create(arena, path + path_len - new_rest, new_rest,
+                                                    value, value_len);
+            if (new_child == NULL) {
+                mpt_node_release(arena, old_child);
+                return -1;
+            }
+            
+            mpt_node_t* split = mpt_split_branch(arena, path, common,
+                                                 old_nibble, old_child, new_nibble, new_child);
+            if (split == NULL) {
+                mpt_node_release(arena, old_child);
+                mpt_node_release(arena, new_child);
+                return -1;
+            }
+            
+            mpt_node_unref(arena, node);
+            *slot = split;
+            *inserted = true;
+            return 0;
+        }
+        
+        case MPT_NODE_EXTENSION: {
+            mpt_extension_t* ext = (mpt_extension_t*)node;
+            uint8_t ext_path[MPT_MAX_PATH_LEN];
+            size_t ext_len = ext->node.path_len;
+            unpack_nibbles(ext->path, ext_len, ext_path);
+            
+            size_t common = common_prefix_len(ext_path, ext_len, path, path_len);
+            
+            if (common == ext_len) {
+                node = mpt_node_make_mut(arena, slot);
+                if (node == NULL) return -1;
+                ext = (mpt_extension_t*)node;
+                int ret = mpt_node_insert(tree, &ext->next, path + common,
+                                          path_len - common, value, value_len, inserted);
+                if (ret != 0) return ret;
+                node->flags |= MPT_NODE_DIRTY;
+                return 0;
+            }
+            
+            size_t old_rest = ext_len - common - 1;
+            mpt_node_t* old_child = mpt_wrap_extension(arena, ext_path + common + 1, old_rest, ext->next);
+            if (old_child == NULL) return -1;
+            
+            int new_nibble = (common < path_len) ? path[common] : -1;
+            size_t new_rest = (common < path_len) ? path_len - common - 1 : 0;
+            mpt_node_t* new_child = mpt_leaf_create(arena, path + path_len - new_rest, new_rest,
+                                                    value, value_len);
+            if (new_child == NULL) {
+                if (old_rest > 0) mpt_node_release(arena, old_child);
+                return -1;
+            }
+            
+            mpt_node_t* split = mpt_split_branch(arena, path, common,
+                                                 ext_path[common], old_child, new_nibble, new_child);
+            if (split == NULL) {
+                if (old_rest > 0) mpt_node_release(arena, old_child);
+                mpt_node_release(arena, new_child);
+                return -1;
+            }
+            
+            mpt_node_retire(arena, node);
+            *slot = split;
+            *inserted = true;
+            return 0;
+        }
+        
+        case MPT_NODE_BRANCH: {
+            node = mpt_node_make_mut(arena, slot);
+            if (node == NULL) return -1;
+            mpt_branch_t* branch = (mpt_branch_t*)node;
+            
+            if (path_len == 0) {
+                mpt_node_t* value_leaf = mpt_leaf_create(arena, path, 0, value, value_len);
+                if (value_leaf == NULL) return -1;
+                
+                mpt_leaf_t* old_value = branch_value(branch);
+                *inserted = (old_value == NULL);
+                if (old_value == NULL) {
+                    branch = mpt_branch_resize(arena, slot, branch->node.bitmap, true);
+                    if (branch == NULL) {
+                        mpt_node_release(arena, value_leaf);
+                        return -1;
+                    }
+                } else {
+                    mpt_node_unref(arena, &old_value->node);
+                }
+                branch->children[branch_child_count(branch)] = value_leaf;
+                branch->node.flags |= MPT_NODE_DIRTY;
+                return 0;
+            }
+            
+            uint8_t nibble = path[0];
+            if (branch->node.bitmap & (1u << nibble)) {
+                int ret = mpt_node_insert(tree, &branch->children[branch_child_index(branch->node.bitmap, nibble)],
+                                          path + 1, path_len - 1, value, value_len, inserted);
+                if (ret != 0) return ret;
+                node->flags |= MPT_NODE_DIRTY;
+                return 0;
+            }
+            
+            mpt_node_t* child = mpt_leaf_create(arena, path + 1, path_len - 1, value, value_len);
+            if (child == NULL) return -1;
+            
+            branch = mpt_branch_resize(arena, slot, (uint16_t)(branch->node.bitmap | (1u << nibble)),
+                                       (branch->node.flags & MPT_NODE_HAS_VALUE) != 0);
+            if (branch == NULL) {
+                mpt_node_release(arena, child);
+                return -1;
+            }
+            branch->children[branch_child_index(branch->node.bitmap, nibble)] = child;
+            *inserted = true;
+            return 0;
+        }
+        
+        default:
+            return -1;
+    }
+}
+
+static mpt_node_t* mpt_node_prepend_path(mpt_arena_t* arena, const uint8_t* prefix, size_t prefix_len,
+                                         mpt_node_t* node) {
+    if (MPT_NODE_TYPE(node) == MPT_NODE_BRANCH) {
+        return mpt_wrap_extension(arena, prefix, prefix_len, node);
+    }
+    
+    uint8_t path[MPT_MAX_PATH_LEN];
+    memcpy(path, prefix, prefix_len);
+    
+    mpt_node_t* merged;
+    if (MPT_NODE_TYPE(node) == MPT_NODE_LEAF) {
+        mpt_leaf_t* leaf = (mpt_leaf_t*)node;
+        unpack_nibbles(leaf->data, leaf->node.path_len, path + prefix_len);
+        size_t value_len;
+        const uint8_t* value = leaf_value(leaf, &value_len);
+        merged = mpt_leaf_create(arena, path, prefix_len + leaf->node.path_len, value, value_len);
+    } else {
+        mpt_extension_t* ext = (mpt_extension_t*)node;
+        unpack_nibbles(ext->path, ext->node.path_len, path + prefix_len);
+        merged = mpt_wrap_extension(arena, path, prefix_len + ext->node.path_len, ext->next);
+    }
+    if (merged == NULL) return NULL;
+    
+    mpt_node_retire(arena, node);
+    return merged;
+}
+
+static int mpt_branch_normalize(mpt_tree_t* tree, mpt_node_t** slot) {
+    mpt_arena_t* arena = &tree->arena;
+    mpt_branch_t* branch = (mpt_branch_t*)*slot;
+    size_t child_count = branch_child_count(branch);
+    mpt_leaf_t* value_leaf = branch_value(branch);
+    
+    if (child_count == 0) {
+        if (value_leaf == NULL) {
+            mpt_node_retire(arena, &branch->node);
+            *slot = NULL;
+            return 0;
+        }
+        mpt_node_t* leaf = mpt_node_make_mut(arena, &branch->children[0]);
+        if (leaf == NULL) return -1;
+        leaf->flags |= MPT_NODE_DIRTY;
+        mpt_node_retire(arena, &branch->node);
+        *slot = leaf;
+        return 0;
+    }
+    
+    if (child_count == 1 && value_leaf == NULL) {
+        uint8_t nibble = (uint8_t)__builtin_ctz(branch->node.bitmap);
+        if (mpt_node_resolve(tree, &branch->children[0]) != 0) return -1;
+        mpt_node_t* merged = mpt_node_prepend_path(arena, &nibble, 1, branch->children[0]);
+        if (merged == NULL) return -1;
+        mpt_node_retire(arena, &branch->node);
+        *slot = merged;
+        return 0;
+    }
+    
+    branch->node.flags |= MPT_NODE_DIRTY;
+    return 0;
+}
+
+static int mpt_node_delete(mpt_tree_t* tree, mpt_node_t** slot,
+                           const uint8_t* path, size_t path_len) {
+    mpt_arena_t* arena = &tree->arena;
+    if (mpt_node_resolve(tree, slot) != 0) return -1;
+    mpt_node_t* node = *slot;
+    if (node == NULL) return -1;
+    
+    switch (MPT_NODE_TYPE(node)) {
+        case MPT_NODE_LEAF: {
+            mpt_leaf_t* leaf = (mpt_leaf_t*)node;
+            if (!packed_path_equals(leaf->data, leaf->node.path_len, path, path_len)) {
+                return -1;
+            }
+            mpt_node_unref(arena, node);
+            *slot = NULL;
+            return 0;
+        }
+        
+        case MPT_NODE_EXTENSION: {
+            mpt_extension_t* ext = (mpt_extension_t*)node;
+            size_t len = ext->node.path_len;
+            if (!packed_path_is_prefix(ext->path, len, path, path_len)) {
+                return -1;
+            }
+            
+            node = mpt_node_make_mut(arena, slot);
+            if (node == NULL) return -1;
+            ext = (mpt_extension_t*)node;
+            
+            int ret = mpt_node_delete(tree, &ext->next, path + len, path_len - len);
+            if (ret != 0) return ret;
+            
+            mpt_node_t* next = ext->next;
+            if (next == NULL) {
+                mpt_node_retire(arena, node);
+                *slot = NULL;
+            } else if (MPT_NODE_TYPE(next) == MPT_NODE_BRANCH) {
+                node->flags |= MPT_NODE_DIRTY;
+            } else {
+                uint8_t ext_path[MPT_MAX_PATH_LEN];
+                unpack_nibbles(ext->path, len, ext_path);
+                mpt_node_t* merged = mpt_node_prepend_path(arena, ext_path, len, next);
+                if (merged == NULL) return -1;
+                mpt_node_retire(arena, node);
+                *slot = merged;
+            }
+            return 0;
+        }
+        
+        case MPT_NODE_BRANCH: {
+            mpt_branch_t* branch = (mpt_branch_t*)node;
+            if (path_len == 0) {
+                if (branch_value(branch) == NULL) return -1;
+                
+                branch = (mpt_branch_t*)mpt_node_make_mut(arena, slot);
+                if (branch == NULL) return -1;
+                mpt_node_unref(arena, &branch_value(branch)->node);
+                if (mpt_branch_resize(arena, slot, branch->node.bitmap, false) == NULL) return -1;
+            } else {
+                uint8_t nibble = path[0];
+                if (!(branch->node.bitmap & (1u << nibble))) return -1;
+                
+                branch = (mpt_branch_t*)mpt_node_make_mut(arena, slot);
+                if (branch == NULL) return -1;
+                node = &branch->node;
+                
+                mpt_node_t** child = &branch->children[branch_child_index(branch->node.bitmap, nibble)];
+                int ret = mpt_node_delete(tree, child, path + 1, path_len - 1);
+                if (ret != 0) return ret;
+                
+                if (*child == NULL &&
+                    mpt_branch_resize(arena, slot, (uint16_t)(branch->node.bitmap & ~(1u << nibble)),
+                                      (node->flags & MPT_NODE_HAS_VALUE) != 0) == NULL) {
+                    return -1;
+                }
+            }
+            return mpt_branch_normalize(tree, slot);
+        }
+        
+        default:
+            return -1;
+    }
+}
+
+static inline const mpt_node_t* mpt_lookup_step(mpt_tree_t* tree, const mpt_node_t* node,
+                                                const uint8_t* key, size_t path_len, size_t* pos,
+                                                const uint8_t** found, size_t* found_len) {
+    switch (MPT_NODE_TYPE(node)) {
+        case MPT_NODE_LEAF: {
+            const mpt_leaf_t* leaf = (const mpt_leaf_t*)node;
+            if (leaf->node.path_len == path_len - *pos &&
+                packed_path_matches_key(leaf->data, leaf->node.path_len, key, *pos)) {
+                *found = leaf_value(leaf, found_len);
+            }
+            return NULL;
+        }
+        
+        case MPT_NODE_EXTENSION: {
+            const mpt_extension_t* ext = (const mpt_extension_t*)node;
+            if (ext->node.path_len > path_len - *pos ||
+                !packed_path_matches_key(ext->path, ext->node.path_len, key, *pos)) {
+                return NULL;
+            }
+            *pos += ext->node.path_len;
+            return ext->next;
+        }
+        
+        case MPT_NODE_BRANCH: {
+            const mpt_branch_t* branch = (const mpt_branch_t*)node;
+            if (*pos == path_len) {
+                const mpt_leaf_t* value_leaf = branch_value(branch);
+                if (value_leaf) {
+                    *found = leaf_value(value_leaf, found_len);
+                }
+                return NULL;
+            }
+            uint8_t nibble = key_nibble(key, (*pos)++);
+            if (!(branch->node.bitmap & (1u << nibble))) return NULL;
+            return branch->children[branch_child_index(branch->node.bitmap, nibble)];
+        }
+        
+        case MPT_NODE_EMPTY:
+            return mpt_node_load(tree, node->hash);
+        
+        default:
+            return NULL;
+    }
+}
+
+static int mpt_node_lookup(mpt_tree_t* tree, const mpt_node_t* node,
+                           const uint8_t* key, size_t key_len,
+                           uint8_t* value, size_t* value_len) {
+    size_t path_len = key_len * 2;
+    size_t pos = 0;
+    
+    const uint8_t* found = NULL;
+    size_t found_len = 0;
+    
+    while (node != NULL) {
+        node = mpt_lookup_step(tree, node, key, path_len, &pos, &found, &found_len);
+    }
+    
+    if (found == NULL) return -1;
+    
+    size_t copy_len = (*value_len < found_len) ? *value_len : found_len;
+    memcpy(value, found, copy_len);
+    *value_len = found_len;
+    return 0;
+}
+
+static int mpt_lookup_validate(const mpt_lookup_t* lookups, size_t count) {
+    if (lookups == NULL && count > 0) return -1;
+    for (size_t i = 0; i < count; i++) {
+        if (lookups[i].key == NULL || lookups[i].value == NULL) return -1;
+        if (lookups[i].key_len > MPT_MAX_KEY_LEN) return -1;
+    }
+    return 0;
+}
+
+static void mpt_node_lookup_many(mpt_tree_t* tree, const mpt_node_t* root,
+                                 mpt_lookup_t* lookups, size_t count) {
+    for (size_t base = 0; base < count; base += MPT_LOOKUP_LANES) {
+        size_t lanes = (count - base < MPT_LOOKUP_LANES) ? count - base : MPT_LOOKUP_LANES;
+        mpt_lookup_t* batch = lookups + base;
+        const mpt_node_t* nodes[MPT_LOOKUP_LANES];
+        size_t pos[MPT_LOOKUP_LANES];
+        size_t active = 0;
+        
+        for (size_t i = 0; i < lanes; i++) {
+            batch[i].result = -1;
+            nodes[i] = root;
+            pos[i] = 0;
+            if (nodes[i]) active++;
+        }
+        
+        while (active > 0) {
+            for (size_t i = 0; i < lanes; i++) {
+                if (nodes[i] == NULL) continue;
+                
+                const uint8_t* found = NULL;
+                size_t found_len = 0;
+                nodes[i] = mpt_lookup_step(tree, nodes[i], batch[i].key, batch[i].key_len * 2,
+                                           &pos[i], &found, &found_len);
+                
+                if (nodes[i] != NULL) {
+                    __builtin_prefetch(nodes[i]);
+                    __builtin_prefetch((const uint8_t*)nodes[i] + 64);
+                    continue;
+                }
+                
+                active--;
+                if (found != NULL) {
+                    size_t copy_len = (batch[i].value_len < found_len) ? batch[i].value_len : found_len;
+                    memcpy(batch[i].value, found, copy_len);
+                    batch[i].value_len = found_len;
+                    batch[i].result = 0;
+                }
+            }
+        }
+    }
+}
+
+static size_t kv_path_len(const mpt_kv_t* item) {
+    return item->key_len * 2;
+}
+
+static int mpt_kv_compare(const mpt_kv_t* a, const mpt_kv_t* b) {
+    size_t n = (a->key_len < b->key_len) ? a->key_len : b->key_len;
+    int cmp = memcmp(a->key, b->key, n);
+    if (cmp != 0) return cmp;
+    return (a->key_len > b->key_len) - (a->key_len < b->key_len);
+}
+
+static int mpt_kv_sort_compare(const void* a, const void* b) {
+    const mpt_kv_t* x = *(const mpt_kv_t* const*)a;
+    const mpt_kv_t* y = *(const mpt_kv_t* const*)b;
+    int cmp = mpt_kv_compare(x, y);
+    if (cmp != 0) return cmp;
+    return (x > y) - (x < y);
+}
+
+static size_t kv_common_prefix(const mpt_kv_t* a, const mpt_kv_t* b, size_t depth) {
+    size_t n = (kv_path_len(a) < kv_path_len(b)) ? kv_path_len(a) : kv_path_len(b);
+    size_t i = depth;
+    while (i < n && key_nibble(a->key, i) == key_nibble(b->key, i)) i++;
+    return i - depth;
+}
+
+static size_t kv_path_common_prefix(const uint8_t* path, size_t path_len,
+                                    const mpt_kv_t* item, size_t depth) {
+    size_t n = kv_path_len(item) - depth;
+    if (path_len < n) n = path_len;
+    size_t i = 0;
+    while (i < n && path[i] == key_nibble(item->key, depth + i)) i++;
+    return i;
+}
+
+static mpt_node_t* mpt_leaf_from_kv(mpt_arena_t* arena, const mpt_kv_t* item, size_t depth) {
+    uint8_t path[MPT_MAX_PATH_LEN];
+    size_t path_len = key_to_nibbles(item->key, item->key_len, path);
+    return mpt_leaf_create(arena, path + depth, path_len - depth, item->value, item->value_len);
+}
+
+static mpt_node_t* mpt_node_build(mpt_arena_t* arena, const mpt_kv_t* const* items,
+                                  size_t count, size_t depth) {
+    if (count == 1) return mpt_leaf_from_kv(arena, items[0], depth);
+    
+    size_t common = kv_common_prefix(items[0], items[count - 1], depth);
+    size_t split = depth + common;
+    size_t first = (kv_path_len(items[0]) == split) ? 1 : 0;
+    
+    uint16_t bitmap = 0;
+    for (size_t i = first; i < count; i++) {
+        bitmap |= (uint16_t)(1u << key_nibble(items[i]->key, split));
+    }
+    
+    mpt_branch_t* branch = mpt_branch_create(arena, bitmap, first == 1);
+    if (branch == NULL) return NULL;
+    
+    size_t slot = 0;
+    size_t i = first;
+    while (i < count) {
+        uint8_t nibble = key_nibble(items[i]->key, split);
+        size_t end = i + 1;
+        while (end < count && key_nibble(items[end]->key, split) == nibble) end++;
+        
+        mpt_node_t* child = mpt_node_build(arena, items + i, end - i, split + 1);
+        if (child == NULL) {
+            mpt_node_unref(arena, &branch->node);
+            return NULL;
+        }
+        branch->children[slot++] = child;
+        i = end;
+    }
+    
+    if (first) {
+        branch->children[slot] = mpt_leaf_from_kv(arena, items[0], split);
+        if (branch->children[slot] == NULL) {
+            mpt_node_unref(arena, &branch->node);
+            return NULL;
+        }
+    }
+    
+    uint8_t path[MPT_MAX_PATH_LEN];
+    key_to_nibbles(items[0]->key, items[0]->key_len, path);
+    mpt_node_t* node = mpt_wrap_extension(arena, path + depth, common, &branch->node);
+    if (node == NULL) mpt_node_unref(arena, &branch->node);
+    return node;
+}
+
+static int mpt_node_merge(mpt_tree_t* tree, mpt_node_t** slot, const mpt_kv_t* const* items,
+                          size_t count, size_t depth, size_t* inserted) {
+    mpt_arena_t* arena = &tree->arena;
+    if (mpt_node_resolve(tree, slot) != 0) return -1;
+    mpt_node_t* node = *slot;
+    
+    if (node == NULL) {
+        node = mpt_node_build(arena, items, count, depth);
+        if (node == NULL) return -1;
+        *slot = node;
+        *inserted += count;
+        return 0;
+    }
+    
+    if (count == 1) {
+        uint8_t path[MPT_MAX_PATH_LEN];
+        size_t path_len = key_to_nibbles(items[0]->key, items[0]->key_len, path);
+        bool added = false;
+        int ret = mpt_node_insert(tree, slot, path + depth, path_len - depth,
+                                  items[0]->value, items[0]->value_len, &added);
+        if (added) (*inserted)++;
+        return ret;
+    }
+    
+    switch (MPT_NODE_TYPE(node)) {
+        case MPT_NODE_LEAF:
+        case MPT_NODE_EXTENSION: {
+            bool is_leaf = (MPT_NODE_TYPE(node) == MPT_NODE_LEAF);
+            mpt_leaf_t* leaf = (mpt_leaf_t*)node;
+            mpt_extension_t* ext = (mpt_extension_t*)node;
+            
+            uint8_t node_path[MPT_MAX_PATH_LEN];
+            size_t node_len = is_leaf ? leaf->node.path_len : ext->node.path_len;
+            unpack_nibbles(is_leaf ? leaf->data : ext->path, node_len, node_path);
+            
+            size_t common = kv_path_common_prefix(node_path, node_len, items[0], depth);
+            size_t last = kv_path_common_prefix(node_path, node_len, items[count - 1], depth);
+            if (last < common) common = last;
+            
+            if (!is_leaf && common == node_len) {
+                node = mpt_node_make_mut(arena, slot);
+                if (node == NULL) return -1;
+                ext = (mpt_extension_t*)node;
+                int ret = mpt_node_merge(tree, &ext->next, items, count, depth + node_len, inserted);
+                if (ret != 0) return ret;
+                node->flags |= MPT_NODE_DIRTY;
+                return 0;
+            }
+            
+            int nibble = (common < node_len) ? node_path[common] : -1;
+            size_t rest_len = (common < node_len) ? node_len - common - 1 : 0;
+            mpt_node_t* rest;
+            if (is_leaf) {
+                size_t value_len;
+                const uint8_t* value = leaf_value(leaf, &value_len);
+                rest = mpt_leaf_create(arena, node_path + node_len - rest_len, rest_len, value, value_len);
+            } else {
+                rest = mpt_wrap_extension(arena, node_path + node_len - rest_len, rest_len, ext->next);
+            }
+            if (rest == NULL) return -1;
+            bool owns_rest = is_leaf || rest_len > 0;
+            
+            mpt_branch_t* branch = mpt_branch_create(arena, (nibble < 0) ? 0 : (uint16_t)(1u << nibble),
+                                                     nibble < 0);
+            if (branch == NULL) {
+                if (owns_rest) mpt_node_release(arena, rest);
+                return -1;
+            }
+            branch->children[0] = rest;
+            
+            mpt_node_t* top = mpt_wrap_extension(arena, node_path, common, &branch->node);
+            if (top == NULL) {
+                if (owns_rest) mpt_node_release(arena, rest);
+                mpt_node_release(arena, &branch->node);
+                return -1;
+            }
+            
+            mpt_node_retire(arena, node);
+            *slot = top;
+            mpt_node_t** inner = (common > 0) ? &((mpt_extension_t*)top)->next : slot;
+            return mpt_node_merge(tree, inner, items, count, depth + common, inserted);
+        }
+        
+        case MPT_NODE_BRANCH: {
+            node = mpt_node_make_mut(arena, slot);
+            if (node == NULL) return -1;
+            mpt_branch_t* branch = (mpt_branch_t*)node;
+            size_t first = (kv_path_len(items[0]) == depth) ? 1 : 0;
+            bool had_value = (node->flags & MPT_NODE_HAS_VALUE) != 0;
+            
+            uint16_t bitmap = branch->node.bitmap;
+            for (size_t i = first; i < count; i++) {
+                bitmap |= (uint16_t)(1u << key_nibble(items[i]->key, depth));
+            }
+            
+            if (bitmap != branch->node.bitmap || (first && !had_value)) {
+                branch = mpt_branch_resize(arena, slot, bitmap, had_value || first);
+                if (branch == NULL) return -1;
+            }
+            
+            if (first) {
+                mpt_node_t* value_leaf = mpt_leaf_from_kv(arena, items[0], depth);
+                if (value_leaf == NULL) return -1;
+                
+                mpt_leaf_t* old_value = branch_value(branch);
+                if (old_value != NULL) {
+                    mpt_node_unref(arena, &old_value->node);
+                } else {
+                    (*inserted)++;
+                }
+                branch->children[branch_child_count(branch)] = value_leaf;
+            }
+            
+            size_t i = first;
+            while (i < count) {
+                uint8_t nibble = key_nibble(items[i]->key, depth);
+                size_t end = i + 1;
+                while (end < count && key_nibble(items[end]->key, depth) == nibble) end++;
+                
+                int ret = mpt_node_merge(tree, &branch->children[branch_child_index(bitmap, nibble)],
+                                         items + i, end - i, depth + 1, inserted);
+                if (ret != 0) return ret;
+                i = end;
+            }
+            
+            branch->node.flags |= MPT_NODE_DIRTY;
+            return 0;
+        }
+        
+        default:
+            return -1;
+    }
+}
+
+static int mpt_kv_validate(const mpt_kv_t* items, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].key == NULL || items[i].value == NULL) return -1;
+        if (items[i].key_len > MPT_MAX_KEY_LEN || items[i].value_len > MPT_MAX_VALUE_LEN) return -1;
+    }
+    return 0;
+}
+
+static void mpt_tree_record_version(mpt_tree_t* tree, mpt_node_t* root,
+                                    const uint8_t* root_hash, size_t size) {
+    if (tree->version_count == tree->retain) {
+        mpt_node_unref(&tree->arena, tree->versions[0].root);
+        memmove(tree->versions, tree->versions + 1, (tree->version_count - 1) * sizeof(mpt_version_t));
+        tree->version_count--;
+    }
+    
+    mpt_version_t* version = &tree->versions[tree->version_count++];
+    version->root = root;
+    if (root) root->refs++;
+    memcpy(version->root_hash, root_hash, MPT_NODE_HASH_SIZE);
+    version->size = size;
+}
+
+static void mpt_tree_release_versions(mpt_tree_t* tree) {
+    for (size_t i = 0; i < tree->version_count; i++) {
+        mpt_node_unref(&tree->arena, tree->versions[i].root);
+    }
+    tree->version_count = 0;
+}
+
+static void mpt_tree_journal_items(mpt_tree_t* tree, const mpt_kv_t* items, size_t count) {
+    if (count == 0) {
+        tree->journal_stale = true;
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (mpt_journal_put(tree->journal, items[i].key, items[i].key_len,
+                            items[i].value, items[i].value_len) != 0) {
+            tree->journal_stale = true;
+            return;
+        }
+    }
+}
+
+int mpt_tree_init(mpt_tree_t* tree) {
+    if (tree == NULL) return -1;
+    
+    memset(tree, 0, sizeof(mpt_tree_t));
+    mpt_arena_init(&tree->arena);
+    tree->root = NULL;
+    
+    memset(tree->root_hash, 0, MPT_NODE_HASH_SIZE);
+    return 0;
+}
+
+static int mpt_tree_sparse_sync(mpt_tree_t* tree, int ret) {
+    tree->size = tree->smt->size;
+    tree->dirty = tree->smt->dirty;
+    memcpy(tree->root_hash, tree->smt->root_hash, MPT_NODE_HASH_SIZE);
+    return ret;
+}
+
+int mpt_tree_init_backend(mpt_tree_t* tree, mpt_backend_t backend) {
+    if (mpt_tree_init(tree) != 0) return -1;
+    if (backend == MPT_BACKEND_PATRICIA) return 0;
+    if (backend != MPT_BACKEND_SPARSE) return -1;
+    
+    tree->smt = (mpt_smt_t*)platform_malloc(sizeof(mpt_smt_t));
+    if (tree->smt == NULL) return -1;
+    if (mpt_smt_init(tree->smt) != 0) {
+        platform_free(tree->smt);
+        tree->smt = NULL;
+        return -1;
+    }
+    return mpt_tree_sparse_sync(tree, 0);
+}
+
+int mpt_tree_init_alloc(mpt_tree_t* tree, struct platform_alloc* alloc) {
+    if (mpt_tree_init(tree) != 0) return -1;
+    
+    mpt_arena_init_alloc(&tree->arena, alloc);
+    return 0;
+}
+
+int mpt_tree_open(mpt_tree_t* tree, mpt_store_t* store, size_t cache_capacity) {
+    if (tree == NULL || store == NULL) return -1;
+    
+    if (mpt_tree_init(tree) != 0) return -1;
+    if (mpt_cache_init(&tree->cache, cache_capacity) != 0) return -1;
+    tree->store = store;
+    
+    if (store->has_root && store->root_size > 0) {
+        tree->root = mpt_stub_create(&tree->arena, store->root_hash);
+        if (tree->root == NULL) {
+            mpt_tree_destroy(tree);
+            return -1;
+        }
+        memcpy(tree->root_hash, store->root_hash, MPT_NODE_HASH_SIZE);
+        tree->size = (size_t)store->root_size;
+    }
+    
+    return 0;
+}
+
+void mpt_tree_destroy(mpt_tree_t* tree) {
+    if (tree == NULL) return;
+    
+    mpt_cache_clear(&tree->cache);
+    if (tree->cache.buckets) platform_free(tree->cache.buckets);
+    if (tree->retired) platform_free(tree->retired);
+    if (tree->versions) platform_free(tree->versions);
+    if (tree->smt) {
+        mpt_smt_destroy(tree->smt);
+        platform_free(tree->smt);
+    }
+    mpt_arena_destroy(&tree->arena);
+    memset(tree, 0, sizeof(mpt_tree_t));
+}
+
+void mpt_tree_reset(mpt_tree_t* tree) {
+    if (tree == NULL) return;
+    
+    if (tree->smt) {
+        mpt_smt_reset(tree->smt);
+        mpt_tree_sparse_sync(tree, 0);
+        return;
+    }
+    
+    mpt_tree_release_versions(tree);
+    mpt_node_unref(&tree->arena, tree->root);
+    if (!tree->rcu && tree->cache.count == 0 && tree->arena.bytes_in_use == 0) {
+        mpt_arena_reset(&tree->arena);
+    }
+    tree->root = NULL;
+    tree->size = 0;
+    tree->dirty = (tree->store != NULL);
+    memset(tree->root_hash, 0, MPT_NODE_HASH_SIZE);
+    
+    if (tree->journal && mpt_journal_clear(tree->journal) != 0) tree->journal_stale = true;
+}
+
+int mpt_tree_insert(mpt_tree_t* tree, const uint8_t* key, size_t key_len,
+                     const uint8_t* value, size_t value_len) {
+    if (tree == NULL || key == NULL || value == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN || value_len > MPT_MAX_VALUE_LEN) return -1;
+    
+    if (tree->smt) {
+        return mpt_tree_sparse_sync(tree, mpt_smt_insert(tree->smt, key, key_len, value, value_len));
+    }
+    
+    uint8_t path[MPT_MAX_PATH_LEN];
+    size_t path_len = key_to_nibbles(key, key_len, path);
+    
+    mpt_cache_trim(tree);
+    bool inserted = false;
+    if (mpt_node_insert(tree, &tree->root, path, path_len, value, value_len, &inserted) != 0) {
+        return -1;
+    }
+    
+    tree->dirty = true;
+    if (inserted) tree->size++;
+    
+    if (tree->journal && mpt_journal_put(tree->journal, key, key_len, value, value_len) != 0) {
+        tree->journal_stale = true;
+    }
+    return 0;
+}
+
+int mpt_tree_get(mpt_tree_t* tree, const uint8_t* key, size_t key_len,
+                  uint8_t* value, size_t* value_len) {
+    if (tree == NULL || key == NULL || value == NULL || value_len == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN) return -1;
+    
+    if (tree->smt) return mpt_smt_get(tree->smt, key, key_len, value, value_len);
+    
+    mpt_cache_trim(tree);
+    return mpt_node_lookup(tree, tree->root, key, key_len, value, value_len);
 }
 
-static uint8_t hex_to_nibble(uint8_t hex) {
-    if (hex >= '0' && hex <= '9') return hex - '0';
-    if (hex >= 'a' && hex <= 'f') return hex - 'a' + 10;
-    if (hex >= 'A' && hex <= 'F') return hex - 'A' + 10;
+int mpt_tree_get_many(mpt_tree_t* tree, mpt_lookup_t* lookups, size_t count) {
+    if (tree == NULL || mpt_lookup_validate(lookups, count) != 0) return -1;
+    
+    if (tree->smt) {
+        for (size_t i = 0; i < count; i++) {
+            lookups[i].result = mpt_smt_get(tree->smt, lookups[i].key, lookups[i].key_len,
+                                            lookups[i].value, &lookups[i].value_len);
+        }
+        return 0;
+    }
+    
+    mpt_cache_trim(tree);
+    mpt_node_lookup_many(tree, tree->root, lookups, count);
+    return 0;
+}
+
+int mpt_tree_delete(mpt_tree_t* tree, const uint8_t* key, size_t key_len) {
+    if (tree == NULL || key == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN) return -1;
+    
+    if (tree->smt) return mpt_tree_sparse_sync(tree, mpt_smt_delete(tree->smt, key, key_len));
+    
+    uint8_t path[MPT_MAX_PATH_LEN];
+    size_t path_len = key_to_nibbles(key, key_len, path);
+    
+    mpt_cache_trim(tree);
+    if (mpt_node_delete(tree, &tree->root, path, path_len) != 0) {
+        return -1;
+    }
+    
+    tree->dirty = true;
+    tree->size--;
+    
+    if (tree->journal && mpt_journal_delete(tree->journal, key, key_len) != 0) {
+        tree->journal_stale = true;
+    }
+    return 0;
+}
+
+int mpt_tree_insert_batch(mpt_tree_t* tree, const mpt_kv_t* items, size_t count) {
+    if (tree == NULL || (items == NULL && count > 0)) return -1;
+    if (mpt_kv_validate(items, count) != 0) return -1;
+    if (count == 0) return 0;
+    
+    if (tree->smt) {
+        int ret = 0;
+        for (size_t i = 0; i < count && ret == 0; i++) {
+            ret = mpt_smt_insert(tree->smt, items[i].key, items[i].key_len, items[i].value, items[i].value_len);
+        }
+        return mpt_tree_sparse_sync(tree, ret);
+    }
+    
+    const mpt_kv_t** sorted = (const mpt_kv_t**)platform_malloc(count * sizeof(const mpt_kv_t*));
+    if (sorted == NULL) return -1;
+    
+    for (size_t i = 0; i < count; i++) {
+        sorted[i] = &items[i];
+    }
+    qsort(sorted, count, sizeof(const mpt_kv_t*), mpt_kv_sort_compare);
+    
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique > 0 && mpt_kv_compare(sorted[unique - 1], sorted[i]) == 0) {
+            sorted[unique - 1] = sorted[i];
+        } else {
+            sorted[unique++] = sorted[i];
+        }
+    }
+    
+    mpt_cache_trim(tree);
+    mpt_snapshot_t before;
+    mpt_tree_snapshot(tree, &before);
+    
+    size_t inserted = 0;
+    int ret = mpt_node_merge(tree, &tree->root, sorted, unique, 0, &inserted);
+    platform_free(sorted);
+    
+    if (ret != 0) {
+        mpt_tree_rollback(tree, &before);
+        mpt_tree_snapshot_release(tree, &before);
+        return ret;
+    }
+    mpt_tree_snapshot_release(tree, &before);
+    
+    tree->dirty = true;
+    tree->size += inserted;
+    
+    if (tree->journal) mpt_tree_journal_items(tree, items, count);
+    return 0;
+}
+
+int mpt_tree_build_sorted(mpt_tree_t* tree, const mpt_kv_t* items, size_t count) {
+    if (tree == NULL || (items == NULL && count > 0)) return -1;
+    if (mpt_kv_validate(items, count) != 0) return -1;
+    
+    for (size_t i = 1; i < count; i++) {
+        if (mpt_kv_compare(&items[i - 1], &items[i]) >= 0) return -1;
+    }
+    
+    mpt_tree_reset(tree);
+    if (count == 0) return 0;
+    
+    if (tree->smt) return mpt_tree_insert_batch(tree, items, count);
+    
+    const mpt_kv_t** sorted = (const mpt_kv_t**)platform_malloc(count * sizeof(const mpt_kv_t*));
+    if (sorted == NULL) return -1;
+    
+    for (size_t i = 0; i < count; i++) {
+        sorted[i] = &items[i];
+    }
+    
+    tree->root = mpt_node_build(&tree->arena, sorted, count, 0);
+    platform_free(sorted);
+    if (tree->root == NULL) {
+        if (tree->journal) tree->journal_stale = true;
+        return -1;
+    }
+    
+    tree->size = count;
+    tree->dirty = true;
+    
+    if (tree->journal) mpt_tree_journal_items(tree, items, count);
+    return 0;
+}
+
+void mpt_tree_set_thread_pool(mpt_tree_t* tree, thread_pool_t* pool) {
+    if (tree == NULL) return;
+    
+    tree->pool = pool;
+}
+
+static int mpt_tree_retired_reserve(mpt_tree_t* tree) {
+    if (tree->retired_count < tree->retired_capacity) return 0;
+    
+    size_t capacity = tree->retired_capacity ? tree->retired_capacity * 2 : MPT_RETIRED_INITIAL;
+    mpt_retired_t* retired = (mpt_retired_t*)platform_malloc(capacity * sizeof(mpt_retired_t));
+    if (retired == NULL) return -1;
+    
+    if (tree->retired) {
+        memcpy(retired, tree->retired, tree->retired_count * sizeof(mpt_retired_t));
+        platform_free(tree->retired);
+    }
+    tree->retired = retired;
+    tree->retired_capacity = capacity;
+    return 0;
+}
+
+static void mpt_tree_reclaim(mpt_tree_t* tree) {
+    uint64_t min_epoch = mpt_rcu_min_epoch(tree->rcu);
+    size_t kept = 0;
+    
+    for (size_t i = 0; i < tree->retired_count; i++) {
+        if (tree->retired[i].epoch <= min_epoch) {
+            mpt_node_unref(&tree->arena, tree->retired[i].root);
+        } else {
+            tree->retired[kept++] = tree->retired[i];
+        }
+    }
+    tree->retired_count = kept;
+}
+
+static int mpt_tree_publish(mpt_tree_t* tree) {
+    if (tree->root == tree->published) {
+        if (tree->retired_count > 0) mpt_tree_reclaim(tree);
+        return 0;
+    }
+    if (mpt_tree_retired_reserve(tree) != 0) return -1;
+    
+    if (tree->root) tree->root->refs++;
+    mpt_node_t* old = __atomic_exchange_n(&tree->published, tree->root, __ATOMIC_SEQ_CST);
+    uint64_t epoch = mpt_rcu_advance(tree->rcu);
+    
+    if (old) {
+        tree->retired[tree->retired_count].root = old;
+        tree->retired[tree->retired_count].epoch = epoch;
+        tree->retired_count++;
+    }
+    mpt_tree_reclaim(tree);
+    return 0;
+}
+
+static int mpt_encoding_children(const uint8_t* data, size_t len,
+                                 const uint8_t** hashes, size_t* count) {
+    if (len < 2) return -1;
+    
+    *hashes = NULL;
+    *count = 0;
+    if (data[0] == MPT_NODE_EXTENSION) {
+        size_t offset = 2 + packed_len(data[1]);
+        if (len != offset + MPT_NODE_HASH_SIZE) return -1;
+        *hashes = data + offset;
+        *count = 1;
+    } else if (data[0] == MPT_NODE_BRANCH) {
+        if (len < 3) return -1;
+        size_t children = (size_t)__builtin_popcount((unsigned)(data[1] | (data[2] << 8)));
+        if (len < 3 + children * MPT_NODE_HASH_SIZE) return -1;
+        *hashes = data + 3;
+        *count = children;
+    }
+    return 0;
+}
+
+static int mpt_node_copy_reachable(const mpt_store_t* src, mpt_store_t* dst, const uint8_t* hash) {
+    if (mpt_store_contains(dst, hash)) return 0;
+    
+    const uint8_t* data;
+    size_t len;
+    if (mpt_store_get(src, hash, &data, &len) != 0) return -1;
+    
+    const uint8_t* children;
+    size_t count;
+    if (mpt_encoding_children(data, len, &children, &count) != 0) return -1;
+    for (size_t i = 0; i < count; i++) {
+        if (mpt_node_copy_reachable(src, dst, children + i * MPT_NODE_HASH_SIZE) != 0) return -1;
+    }
+    
+    return mpt_store_put(dst, hash, data, len);
+}
+
+static int mpt_tree_compact_store(mpt_tree_t* tree) {
+    mpt_store_t* store = tree->store;
+    char path[MPT_STORE_PATH_MAX + 8];
+    snprintf(path, sizeof(path), "%s.compact", store->path);
+    unlink(path);
+    
+    mpt_store_t fresh;
+    if (mpt_store_open(&fresh, path) != 0) return -1;
+    
+    mpt_version_t current;
+    const mpt_version_t* versions = tree->versions;
+    size_t count = tree->version_count;
+    if (count == 0) {
+        memcpy(current.root_hash, tree->root_hash, MPT_NODE_HASH_SIZE);
+        current.size = tree->size;
+        versions = &current;
+        count = 1;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        if (versions[i].size > 0 &&
+            mpt_node_copy_reachable(store, &fresh, versions[i].root_hash) != 0) {
+            break;
+        }
+        if (mpt_store_set_root(&fresh, versions[i].root_hash, versions[i].size) != 0) break;
+        if (i + 1 == count) return mpt_store_replace(store, &fresh) == 0 ? 0 : -1;
+    }
+    
+    mpt_store_close(&fresh);
+    unlink(path);
+    return -1;
+}
+
+static int mpt_tree_journal_commit(mpt_tree_t* tree);
+
+int mpt_tree_commit(mpt_tree_t* tree) {
+    if (tree == NULL) return -1;
+    
+    if (tree->smt) return mpt_tree_sparse_sync(tree, mpt_smt_commit(tree->smt));
+    
+    if (!tree->dirty) {
+        if (tree->journal && mpt_tree_journal_commit(tree) != 0) return -1;
+        return tree->rcu ? mpt_tree_publish(tree) : 0;
+    }
+    
+    if (tree->root && tree->pool) {
+        mpt_node_hash_parallel(tree->pool, tree->root, tree->size);
+        memcpy(tree->root_hash, tree->root->hash, MPT_NODE_HASH_SIZE);
+    } else if (tree->root) {
+        mpt_node_hash(tree->root, tree->root_hash);
+    } else {
+        memset(tree->root_hash, 0, MPT_NODE_HASH_SIZE);
+    }
+    
+    if (tree->store) {
+        if (tree->root && mpt_node_persist(tree, tree->root) != 0) return -1;
+        if (mpt_store_set_root(tree->store, tree->root_hash, tree->size) != 0) return -1;
+        if (tree->root) {
+            mpt_node_t* stub = mpt_stub_create(&tree->arena, tree->root_hash);
+            if (stub == NULL) return -1;
+            mpt_node_unref(&tree->arena, tree->root);
+            tree->root = stub;
+        }
+        mpt_cache_trim(tree);
+    }
+    tree->dirty = false;
+    
+    if (tree->retain > 0) {
+        mpt_tree_record_version(tree, tree->root, tree->root_hash, tree->size);
+        if (tree->store && tree->snapshot_count == 0 && mpt_store_needs_compaction(tree->store) &&
+            mpt_tree_compact_store(tree) != 0) {
+            return -1;
+        }
+    }
+    
+    if (tree->journal && mpt_tree_journal_commit(tree) != 0) return -1;
+    return tree->rcu ? mpt_tree_publish(tree) : 0;
+}
+
+int mpt_tree_get_root_hash(mpt_tree_t* tree, uint8_t* root_hash) {
+    if (tree == NULL || root_hash == NULL) return -1;
+    
+    if (mpt_tree_commit(tree) != 0) return -1;
+    
+    memcpy(root_hash, tree->root_hash, MPT_NODE_HASH_SIZE);
+    return 0;
+}
+
+int mpt_tree_snapshot(mpt_tree_t* tree, mpt_snapshot_t* snapshot) {
+    if (tree == NULL || tree->smt || snapshot == NULL) return -1;
+    
+    snapshot->root = tree->root;
+    if (snapshot->root) snapshot->root->refs++;
+    memcpy(snapshot->root_hash, tree->root_hash, MPT_NODE_HASH_SIZE);
+    snapshot->size = tree->size;
+    snapshot->dirty = tree->dirty;
+    snapshot->journal_batch = tree->journal ? tree->journal->batches : UINT64_MAX;
+    snapshot->journal_mark = tree->journal ? tree->journal->buffer_len : 0;
+    tree->snapshot_count++;
+    return 0;
+}
+
+int mpt_tree_rollback(mpt_tree_t* tree, const mpt_snapshot_t* snapshot) {
+    if (tree == NULL || tree->smt || snapshot == NULL) return -1;
+    
+    if (snapshot->root) snapshot->root->refs++;
+    mpt_node_unref(&tree->arena, tree->root);
+    
+    tree->root = snapshot->root;
+    memcpy(tree->root_hash, snapshot->root_hash, MPT_NODE_HASH_SIZE);
+    tree->size = snapshot->size;
+    tree->dirty = snapshot->dirty || tree->store != NULL;
+    
+    if (tree->journal) {
+        if (snapshot->journal_batch == tree->journal->batches) {
+            mpt_journal_rewind(tree->journal, snapshot->journal_mark);
+        } else {
+            tree->journal_stale = true;
+        }
+    }
+    return 0;
+}
+
+void mpt_tree_snapshot_release(mpt_tree_t* tree, mpt_snapshot_t* snapshot) {
+    if (tree == NULL || snapshot == NULL) return;
+    
+    mpt_node_unref(&tree->arena, snapshot->root);
+    memset(snapshot, 0, sizeof(mpt_snapshot_t));
+    if (tree->snapshot_count > 0) tree->snapshot_count--;
+}
+
+int mpt_tree_snapshot_get(mpt_tree_t* tree, const mpt_snapshot_t* snapshot,
+                          const uint8_t* key, size_t key_len,
+                          uint8_t* value, size_t* value_len) {
+    if (tree == NULL || tree->smt || snapshot == NULL) return -1;
+    if (key == NULL || value == NULL || value_len == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN) return -1;
+    
+    mpt_cache_trim(tree);
+    return mpt_node_lookup(tree, snapshot->root, key, key_len, value, value_len);
+}
+
+int mpt_tree_snapshot_root_hash(mpt_tree_t* tree, mpt_snapshot_t* snapshot, uint8_t* root_hash) {
+    if (tree == NULL || tree->smt || snapshot == NULL || root_hash == NULL) return -1;
+    
+    if (snapshot->dirty) {
+        if (snapshot->root) {
+            mpt_node_hash(snapshot->root, snapshot->root_hash);
+        } else {
+            memset(snapshot->root_hash, 0, MPT_NODE_HASH_SIZE);
+        }
+        snapshot->dirty = false;
+    }
+    
+    memcpy(root_hash, snapshot->root_hash, MPT_NODE_HASH_SIZE);
+    return 0;
+}
+
+int mpt_tree_set_retention(mpt_tree_t* tree, size_t keep) {
+    if (tree == NULL || tree->smt) return -1;
+    
+    if (keep == 0) {
+        mpt_tree_release_versions(tree);
+        if (tree->versions) platform_free(tree->versions);
+        tree->versions = NULL;
+        tree->retain = 0;
+        return 0;
+    }
+    
+    mpt_version_t* versions = (mpt_version_t*)platform_malloc(keep * sizeof(mpt_version_t));
+    if (versions == NULL) return -1;
+    
+    size_t drop = (tree->version_count > keep) ? tree->version_count - keep : 0;
+    for (size_t i = 0; i < drop; i++) {
+        mpt_node_unref(&tree->arena, tree->versions[i].root);
+    }
+    if (tree->versions) {
+        memcpy(versions, tree->versions + drop, (tree->version_count - drop) * sizeof(mpt_version_t));
+        platform_free(tree->versions);
+    }
+    tree->versions = versions;
+    tree->version_count -= drop;
+    
+    bool seed = (tree->retain == 0);
+    tree->retain = keep;
+    if (!seed) return 0;
+    
+    if (tree->store && tree->store->root_count > 0) {
+        size_t first = (tree->store->root_count > keep) ? tree->store->root_count - keep : 0;
+        for (size_t i = first; i < tree->store->root_count; i++) {
+            const mpt_store_root_t* stored = &tree->store->roots[i];
+            mpt_node_t* root = NULL;
+            if (stored->size > 0) {
+                root = mpt_stub_create(&tree->arena, stored->hash);
+                if (root == NULL) return -1;
+            }
+            mpt_tree_record_version(tree, root, stored->hash, (size_t)stored->size);
+            mpt_node_unref(&tree->arena, root);
+        }
+    } else if (!tree->dirty) {
+        mpt_tree_record_version(tree, tree->root, tree->root_hash, tree->size);
+    }
+    return 0;
+}
+
+int mpt_tree_get_at(mpt_tree_t* tree, const uint8_t* root_hash,
+                    const uint8_t* key, size_t key_len,
+                    uint8_t* value, size_t* value_len) {
+    if (tree == NULL || tree->smt || root_hash == NULL) return -1;
+    if (key == NULL || value == NULL || value_len == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN) return -1;
+    
+    mpt_cache_trim(tree);
+    for (size_t i = tree->version_count; i > 0; i--) {
+        const mpt_version_t* version = &tree->versions[i - 1];
+        if (memcmp(version->root_hash, root_hash, MPT_NODE_HASH_SIZE) == 0) {
+            return mpt_node_lookup(tree, version->root, key, key_len, value, value_len);
+        }
+    }
+    
+    if (!tree->dirty && memcmp(tree->root_hash, root_hash, MPT_NODE_HASH_SIZE) == 0) {
+        return mpt_node_lookup(tree, tree->root, key, key_len, value, value_len);
+    }
+    return -1;
+}
+
+int mpt_tree_compact(mpt_tree_t* tree) {
+    if (tree == NULL || tree->store == NULL || tree->snapshot_count > 0) return -1;
+    
+    if (mpt_tree_commit(tree) != 0) return -1;
+    return mpt_tree_compact_store(tree);
+}
+
+int mpt_tree_attach_rcu(mpt_tree_t* tree, mpt_rcu_t* rcu) {
+    if (tree == NULL || rcu == NULL) return -1;
+    if (tree->store || tree->rcu || tree->smt) return -1;
+    
+    tree->rcu = rcu;
+    if (mpt_tree_commit(tree) != 0) {
+        tree->rcu = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int mpt_tree_read_get(mpt_tree_t* tree, const uint8_t* key, size_t key_len,
+                      uint8_t* value, size_t* value_len) {
+    if (tree == NULL || tree->rcu == NULL) return -1;
+    if (key == NULL || value == NULL || value_len == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN) return -1;
+    
+    mpt_rcu_slot_t* slot = mpt_rcu_read_lock(tree->rcu);
+    if (slot == NULL) return -1;
+    
+    const mpt_node_t* root = __atomic_load_n(&tree->published, __ATOMIC_SEQ_CST);
+    int ret = mpt_node_lookup(tree, root, key, key_len, value, value_len);
+    
+    mpt_rcu_read_unlock(slot);
+    return ret;
+}
+
+int mpt_tree_read_get_many(mpt_tree_t* tree, mpt_lookup_t* lookups, size_t count) {
+    if (tree == NULL || tree->rcu == NULL) return -1;
+    if (mpt_lookup_validate(lookups, count) != 0) return -1;
+    
+    mpt_rcu_slot_t* slot = mpt_rcu_read_lock(tree->rcu);
+    if (slot == NULL) return -1;
+    
+    const mpt_node_t* root = __atomic_load_n(&tree->published, __ATOMIC_SEQ_CST);
+    mpt_node_lookup_many(tree, root, lookups, count);
+    
+    mpt_rcu_read_unlock(slot);
+    return 0;
+}
+
+typedef enum {
+    MPT_PROOF_STEP_INVALID = -1,
+    MPT_PROOF_STEP_FOUND = 0,
+    MPT_PROOF_STEP_ABSENT = 1,
+    MPT_PROOF_STEP_CHILD = 2
+} mpt_proof_step_t;
+
+typedef struct {
+    const uint8_t* data;
+    size_t len;
+    uint8_t hash[MPT_NODE_HASH_SIZE];
+} mpt_proof_entry_t;
+
+static int mpt_node_path(mpt_tree_t* tree, const mpt_node_t* node, const uint8_t* key, size_t key_len,
+                         const mpt_node_t** nodes, size_t* count) {
+    size_t path_len = key_len * 2;
+    size_t pos = 0;
+    *count = 0;
+    
+    while (node != NULL) {
+        if (MPT_NODE_TYPE(node) == MPT_NODE_EMPTY) {
+            node = mpt_node_load(tree, node->hash);
+            if (node == NULL) return -1;
+        }
+        nodes[(*count)++] = node;
+        
+        switch (MPT_NODE_TYPE(node)) {
+            case MPT_NODE_EXTENSION: {
+                const mpt_extension_t* ext = (const mpt_extension_t*)node;
+                if (ext->node.path_len > path_len - pos ||
+                    !packed_path_matches_key(ext->path, ext->node.path_len, key, pos)) {
+                    node = NULL;
+                    break;
+                }
+                pos += ext->node.path_len;
+                node = ext->next;
+                break;
+            }
+            
+            case MPT_NODE_BRANCH: {
+                const mpt_branch_t* branch = (const mpt_branch_t*)node;
+                if (pos == path_len) {
+                    node = NULL;
+                    break;
+                }
+                uint8_t nibble = key_nibble(key, pos++);
+                if (!(branch->node.bitmap & (1u << nibble))) {
+                    node = NULL;
+                    break;
+                }
+                node = branch->children[branch_child_index(branch->node.bitmap, nibble)];
+                break;
+            }
+            
+            default:
+                node = NULL;
+                break;
+        }
+    }
+    
+    return 0;
+}
+
+static int mpt_proof_append(mpt_proof_t* proof, size_t* capacity, const mpt_node_t* node) {
+    if (proof->data_len + 2 + MPT_MAX_NODE_ENCODING > *capacity) {
+        size_t new_capacity = *capacity * 2 + 2 + MPT_MAX_NODE_ENCODING;
+        uint8_t* data = (uint8_t*)platform_malloc(new_capacity);
+        if (data == NULL) return -1;
+        if (proof->data) {
+            memcpy(data, proof->data, proof->data_len);
+            platform_free(proof->data);
+        }
+        proof->data = data;
+        *capacity = new_capacity;
+    }
+    
+    uint8_t* dst = proof->data + proof->data_len;
+    size_t len = mpt_node_encode(node, dst + 2);
+    dst[0] = (uint8_t)(len & 0xFF);
+    dst[1] = (uint8_t)(len >> 8);
+    proof->data_len += 2 + len;
+    proof->node_count++;
+    return 0;
+}
+
+static int mpt_proof_next(const mpt_proof_t* proof, size_t* offset,
+                          const uint8_t** data, size_t* len) {
+    if (proof->data_len - *offset < 2) return -1;
+    
+    const uint8_t* src = proof->data + *offset;
+    size_t node_len = (size_t)src[0] | ((size_t)src[1] << 8);
+    if (node_len == 0 || proof->data_len - *offset - 2 < node_len) return -1;
+    
+    *data = src + 2;
+    *len = node_len;
+    *offset += 2 + node_len;
+    return 0;
+}
+
+static mpt_proof_step_t mpt_proof_step(const uint8_t* data, size_t len,
+                                       const uint8_t* key, size_t key_len, size_t* pos,
+                                       const uint8_t** out, size_t* out_len) {
+    size_t path_len = key_len * 2;
+    
+    switch (data[0]) {
+        case MPT_NODE_LEAF: {
+            if (len < 2) return MPT_PROOF_STEP_INVALID;
+            size_t node_path_len = data[1];
+            size_t offset = 2 + packed_len(node_path_len);
+            if (len < offset + 2) return MPT_PROOF_STEP_INVALID;
+            size_t value_len = (size_t)data[offset] | ((size_t)data[offset + 1] << 8);
+            if (len != offset + 2 + value_len) return MPT_PROOF_STEP_INVALID;
+            if (node_path_len != path_len - *pos ||
+                !packed_path_matches_key(data + 2, node_path_len, key, *pos)) {
+                return MPT_PROOF_STEP_ABSENT;
+            }
+            *out = data + offset + 2;
+            *out_len = value_len;
+            return MPT_PROOF_STEP_FOUND;
+        }
+        
+        case MPT_NODE_EXTENSION: {
+            if (len < 2) return MPT_PROOF_STEP_INVALID;
+            size_t node_path_len = data[1];
+            size_t offset = 2 + packed_len(node_path_len);
+            if (node_path_len == 0 || len != offset + MPT_NODE_HASH_SIZE) return MPT_PROOF_STEP_INVALID;
+            if (node_path_len > path_len - *pos ||
+                !packed_path_matches_key(data + 2, node_path_len, key, *pos)) {
+                return MPT_PROOF_STEP_ABSENT;
+            }
+            *pos += node_path_len;
+            *out = data + offset;
+            *out_len = MPT_NODE_HASH_SIZE;
+            return MPT_PROOF_STEP_CHILD;
+        }
+        
+        case MPT_NODE_BRANCH: {
+            if (len < 3) return MPT_PROOF_STEP_INVALID;
+            uint16_t bitmap = (uint16_t)(data[1] | (data[2] << 8));
+            size_t offset = 3 + (size_t)__builtin_popcount(bitmap) * MPT_NODE_HASH_SIZE;
+            if (len < offset + 1 || data[offset] > 1) return MPT_PROOF_STEP_INVALID;
+            const uint8_t* value = NULL;
+            size_t value_len = 0;
+            if (data[offset]) {
+                if (len < offset + 3) return MPT_PROOF_STEP_INVALID;
+                value_len = (size_t)data[offset + 1] | ((size_t)data[offset + 2] << 8);
+                if (len != offset + 3 + value_len) return MPT_PROOF_STEP_INVALID;
+                value = data + offset + 3;
+            } else if (len != offset + 1) {
+                return MPT_PROOF_STEP_INVALID;
+            }
+            if (*pos == path_len) {
+                if (value == NULL) return MPT_PROOF_STEP_ABSENT;
+                *out = value;
+                *out_len = value_len;
+                return MPT_PROOF_STEP_FOUND;
+            }
+            uint8_t nibble = key_nibble(key, (*pos)++);
+            if (!(bitmap & (1u << nibble))) return MPT_PROOF_STEP_ABSENT;
+            *out = data + 3 + branch_child_index(bitmap, nibble) * MPT_NODE_HASH_SIZE;
+            *out_len = MPT_NODE_HASH_SIZE;
+            return MPT_PROOF_STEP_CHILD;
+        }
+        
+        default:
+            return MPT_PROOF_STEP_INVALID;
+    }
+}
+
+static bool mpt_proof_empty_root(const uint8_t* root_hash) {
+    for (size_t i = 0; i < MPT_NODE_HASH_SIZE; i++) {
+        if (root_hash[i] != 0) return false;
+    }
+    return true;
+}
+
+static int mpt_node_hash_sort_compare(const void* a, const void* b) {
+    const mpt_node_t* na = *(const mpt_node_t* const*)a;
+    const mpt_node_t* nb = *(const mpt_node_t* const*)b;
+    return memcmp(na->hash, nb->hash, MPT_NODE_HASH_SIZE);
+}
+
+static int mpt_proof_entry_search(const void* key, const void* entry) {
+    return memcmp(key, ((const mpt_proof_entry_t*)entry)->hash, MPT_NODE_HASH_SIZE);
+}
+
+int mpt_tree_prove(mpt_tree_t* tree, const uint8_t* key, size_t key_len, mpt_proof_t* proof) {
+    if (tree == NULL || key == NULL || proof == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN) return -1;
+    
+    if (tree->smt) return mpt_smt_prove(tree->smt, key, key_len, proof);
+    if (mpt_tree_commit(tree) != 0) return -1;
+    
+    mpt_cache_trim(tree);
+    const mpt_node_t* nodes[MPT_PROOF_MAX_DEPTH];
+    size_t count;
+    if (mpt_node_path(tree, tree->root, key, key_len, nodes, &count) != 0) return -1;
+    
+    memset(proof, 0, sizeof(mpt_proof_t));
+    size_t capacity = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (mpt_proof_append(proof, &capacity, nodes[i]) != 0) {
+            mpt_proof_free(proof);
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+int mpt_tree_prove_many(mpt_tree_t* tree, const uint8_t* const* keys, const size_t* key_lens,
+                        size_t count, mpt_proof_t* proof) {
+    if (tree == NULL || tree->smt || proof == NULL) return -1;
+    if ((keys == NULL || key_lens == NULL) && count > 0) return -1;
+    for (size_t i = 0; i < count; i++) {
+        if (keys[i] == NULL || key_lens[i] > MPT_MAX_KEY_LEN) return -1;
+    }
+    
+    if (mpt_tree_commit(tree) != 0) return -1;
+    
+    memset(proof, 0, sizeof(mpt_proof_t));
+    if (tree->root == NULL || count == 0) return 0;
+    
+    mpt_cache_trim(tree);
+    const mpt_node_t** all = NULL;
+    size_t total = 0;
+    size_t all_capacity = 0;
+    const mpt_node_t* nodes[MPT_PROOF_MAX_DEPTH];
+    
+    for (size_t i = 0; i < count; i++) {
+        size_t n;
+        if (mpt_node_path(tree, tree->root, keys[i], key_lens[i], nodes, &n) != 0) {
+            if (all) platform_free(all);
+            return -1;
+        }
+        if (total + n > all_capacity) {
+            size_t new_capacity = all_capacity * 2 + MPT_PROOF_MAX_DEPTH;
+            const mpt_node_t** grown = (const mpt_node_t**)platform_malloc(new_capacity * sizeof(const mpt_node_t*));
+            if (grown == NULL) {
+                if (all) platform_free(all);
+                return -1;
+            }
+            if (all) {
+                memcpy(grown, all, total * sizeof(const mpt_node_t*));
+                platform_free(all);
+            }
+            all = grown;
+            all_capacity = new_capacity;
+        }
+        memcpy(all + total, nodes, n * sizeof(const mpt_node_t*));
+        total += n;
+    }
+    
+    qsort(all, total, sizeof(const mpt_node_t*), mpt_node_hash_sort_compare);
+    
+    size_t capacity = 0;
+    for (size_t i = 0; i < total; i++) {
+        if (i > 0 && memcmp(all[i]->hash, all[i - 1]->hash, MPT_NODE_HASH_SIZE) == 0) continue;
+        if (mpt_proof_append(proof, &capacity, all[i]) != 0) {
+            platform_free(all);
+            mpt_proof_free(proof);
+            return -1;
+        }
+    }
+    
+    platform_free(all);
     return 0;
 }
 
-void mpt_node_hash(mpt_node_t* node, uint8_t* hash) {
-    if (node == NULL || hash == NULL) return;
+int mpt_tree_verify_proof(const uint8_t* root_hash, const uint8_t* key, size_t key_len,
+                          const mpt_proof_t* proof, bool* exists,
+                          uint8_t* value, size_t* value_len) {
+    if (root_hash == NULL || key == NULL || proof == NULL || exists == NULL) return -1;
+    if (value != NULL && value_len == NULL) return -1;
+    if (key_len > MPT_MAX_KEY_LEN) return -1;
+    
+    if (proof->node_count == 0) {
+        if (proof->data_len != 0 || !mpt_proof_empty_root(root_hash)) return -1;
+        *exists = false;
+        return 0;
+    }
+    if (proof->data == NULL) return -1;
+    
+    uint8_t expected[MPT_NODE_HASH_SIZE];
+    memcpy(expected, root_hash, MPT_NODE_HASH_SIZE);
     
-    uint8_t buffer[1024];
     size_t offset = 0;
+    size_t pos = 0;
+    for (size_t i = 0; i < proof->node_count; i++) {
+        const uint8_t* data;
+        size_t len;
+        if (mpt_proof_next(proof, &offset, &data, &len) != 0) return -1;
+        
+        uint8_t hash[MPT_NODE_HASH_SIZE];
+        platform_sha256(data, len, hash);
+        if (memcmp(hash, expected, MPT_NODE_HASH_SIZE) != 0) return -1;
+        
+        const uint8_t* out = NULL;
+        size_t out_len = 0;
+        mpt_proof_step_t step = mpt_proof_step(data, len, key, key_len, &pos, &out, &out_len);
+        if (step == MPT_PROOF_STEP_INVALID) return -1;
+        if (step == MPT_PROOF_STEP_CHILD) {
+            memcpy(expected, out, MPT_NODE_HASH_SIZE);
+            continue;
+        }
+        
+        if (i + 1 != proof->node_count || offset != proof->data_len) return -1;
+        
+        *exists = (step == MPT_PROOF_STEP_FOUND);
+        if (*exists && value != NULL) {
+            size_t copy_len = (*value_len < out_len) ? *value_len : out_len;
+            memcpy(value, out, copy_len);
+            *value_len = out_len;
+        }
+        return 0;
+    }
+    
+    return -1;
+}
+
+int mpt_tree_verify_sparse_proof(const uint8_t* root_hash, const uint8_t* key, size_t key_len,
+                                 const mpt_proof_t* proof, bool* exists,
+                                 uint8_t* value, size_t* value_len) {
+    return mpt_smt_verify_proof(root_hash, key, key_len, proof, exists, value, value_len);
+}
+
+int mpt_tree_verify_multiproof(const uint8_t* root_hash, const mpt_kv_t* items, size_t count,
+                               const mpt_proof_t* proof) {
+    if (root_hash == NULL || (items == NULL && count > 0) || proof == NULL) return -1;
+    for (size_t i = 0; i < count; i++) {
+        if (items[i].key == NULL || items[i].key_len > MPT_MAX_KEY_LEN) return -1;
+    }
+    if (count == 0) return 0;
     
+    if (proof->node_count == 0) {
+        if (proof->data_len != 0 || !mpt_proof_empty_root(root_hash)) return -1;
+        for (size_t i = 0; i < count; i++) {
+            if (items[i].value != NULL) return -1;
+        }
+        return 0;
+    }
+    if (proof->data == NULL) return -1;
     
-    buffer[offset++] = (uint8_t)node->type;
+    mpt_proof_entry_t* entries = (mpt_proof_entry_t*)platform_malloc(proof->node_count * sizeof(mpt_proof_entry_t));
+    if (entries == NULL) return -1;
     
-    switch (node->type) {
-        case MPT_NODE_LEAF:
-            memcpy(buffer + offset, node->data.leaf.key, node->data.leaf.key_len);
-            offset += node->data.leaf.key_len;
-            memcpy(buffer + offset, node->data.leaf.value, node->data.leaf.value_len);
-            offset += node->data.leaf.value_len;
+    int result = 0;
+    size_t offset = 0;
+    for (size_t i = 0; i < proof->node_count && result == 0; i++) {
+        if (mpt_proof_next(proof, &offset, &entries[i].data, &entries[i].len) != 0) {
+            result = -1;
             break;
+        }
+    }
+    if (offset != proof->data_len) result = -1;
+    
+    for (size_t base = 0; base < proof->node_count && result == 0; base += MPT_HASH_LANES) {
+        const uint8_t* data[MPT_HASH_LANES];
+        size_t lens[MPT_HASH_LANES];
+        uint8_t* hashes[MPT_HASH_LANES];
+        size_t batch = (proof->node_count - base < MPT_HASH_LANES) ? proof->node_count - base : MPT_HASH_LANES;
+        for (size_t i = 0; i < batch; i++) {
+            data[i] = entries[base + i].data;
+            lens[i] = entries[base + i].len;
+            hashes[i] = entries[base + i].hash;
+        }
+        platform_sha256_many(data, lens, hashes, batch);
+    }
+    for (size_t i = 1; i < proof->node_count && result == 0; i++) {
+        if (memcmp(entries[i - 1].hash, entries[i].hash, MPT_NODE_HASH_SIZE) >= 0) result = -1;
+    }
+    
+    for (size_t i = 0; i < count && result == 0; i++) {
+        const mpt_kv_t* item = &items[i];
+        const uint8_t* expected = root_hash;
+        size_t pos = 0;
+        
+        while (true) {
+            const mpt_proof_entry_t* entry = (const mpt_proof_entry_t*)bsearch(
+                expected, entries, proof->node_count, sizeof(mpt_proof_entry_t), mpt_proof_entry_search);
+            if (entry == NULL) {
+                result = -1;
+                break;
+            }
             
-        case MPT_NODE_EXTENSION:
-            memcpy(buffer + offset, node->data.extension.key, node->data.extension.key_len);
-            offset += node->data.extension.key_len;
-            if (node->data.extension.next) {
-                mpt_node_hash(node->data.extension.next, buffer + offset);
-                offset += MPT_NODE_HASH_SIZE;
+            const uint8_t* out = NULL;
+            size_t out_len = 0;
+            mpt_proof_step_t step = mpt_proof_step(entry->data, entry->len, item->key, item->key_len,
+                                                   &pos, &out, &out_len);
+            if (step == MPT_PROOF_STEP_CHILD) {
+                expected = out;
+                continue;
+            }
+            
+            if (step == MPT_PROOF_STEP_FOUND) {
+                if (item->value == NULL || item->value_len != out_len ||
+                    memcmp(item->value, out, out_len) != 0) {
+                    result = -1;
+                }
+            } else if (step != MPT_PROOF_STEP_ABSENT || item->value != NULL) {
+                result = -1;
             }
             break;
+        }
+    }
+    
+    platform_free(entries);
+    return result;
+}
+
+void mpt_proof_free(mpt_proof_t* proof) {
+    if (proof == NULL) return;
+    
+    if (proof->data) platform_free(proof->data);
+    memset(proof, 0, sizeof(mpt_proof_t));
+}
+
+static int mpt_cursor_push(mpt_cursor_t* cursor, const mpt_node_t* node, size_t path_len) {
+    if (MPT_NODE_TYPE(node) == MPT_NODE_EMPTY) {
+        node = mpt_node_load(cursor->tree, node->hash);
+        if (node == NULL) return -1;
+    }
+    if (cursor->depth == MPT_PROOF_MAX_DEPTH) return -1;
+    if (path_len > MPT_MAX_PATH_LEN) return -1;
+    if (MPT_NODE_TYPE(node) != MPT_NODE_BRANCH && path_len + node->path_len > MPT_MAX_PATH_LEN) return -1;
+    
+    ((mpt_node_t*)node)->refs++;
+    mpt_cursor_frame_t* frame = &cursor->stack[cursor->depth++];
+    frame->node = node;
+    frame->path_len = (uint8_t)path_len;
+    frame->next = 0;
+    
+    cursor->path_len = path_len;
+    if (MPT_NODE_TYPE(node) == MPT_NODE_LEAF) {
+        const mpt_leaf_t* leaf = (const mpt_leaf_t*)node;
+        unpack_nibbles(leaf->data, leaf->node.path_len, cursor->path + path_len);
+        cursor->path_len += leaf->node.path_len;
+    } else if (MPT_NODE_TYPE(node) == MPT_NODE_EXTENSION) {
+        const mpt_extension_t* ext = (const mpt_extension_t*)node;
+        unpack_nibbles(ext->path, ext->node.path_len, cursor->path + path_len);
+        cursor->path_len += ext->node.path_len;
+    }
+    return 0;
+}
+
+static void mpt_cursor_pop(mpt_cursor_t* cursor) {
+    mpt_cursor_frame_t* frame = &cursor->stack[--cursor->depth];
+    cursor->path_len = frame->path_len;
+    mpt_node_unref(&cursor->tree->arena, (mpt_node_t*)frame->node);
+}
+
+static int mpt_nibble_compare(const uint8_t* a, size_t a_len, const uint8_t* b, size_t b_len) {
+    size_t n = (a_len < b_len) ? a_len : b_len;
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) return (a[i] < b[i]) ? -1 : 1;
+    }
+    if (a_len == b_len) return 0;
+    return (a_len < b_len) ? -1 : 1;
+}
+
+static int mpt_cursor_seek(mpt_cursor_t* cursor, const uint8_t* start, size_t start_len) {
+    while (cursor->depth > 0) {
+        mpt_cursor_frame_t* frame = &cursor->stack[cursor->depth - 1];
+        const mpt_node_t* node = frame->node;
+        size_t pos = frame->path_len;
+        
+        switch (MPT_NODE_TYPE(node)) {
+            case MPT_NODE_LEAF:
+                if (mpt_nibble_compare(cursor->path + pos, cursor->path_len - pos,
+                                       start + pos, start_len - pos) < 0) {
+                    frame->next = 1;
+                }
+                return 0;
             
-        case MPT_NODE_BRANCH:
-            for (int i = 0; i < 16; i++) {
-                if (node->data.branch.children[i]) {
-                    mpt_node_hash(node->data.branch.children[i], buffer + offset);
-                    offset += MPT_NODE_HASH_SIZE;
+            case MPT_NODE_EXTENSION: {
+                size_t len = cursor->path_len - pos;
+                if (start_len - pos <= len) {
+                    if (mpt_nibble_compare(cursor->path + pos, start_len - pos,
+                                           start + pos, start_len - pos) < 0) {
+                        frame->next = 1;
+                    }
+                    return 0;
+                }
+                int cmp = mpt_nibble_compare(cursor->path + pos, len, start + pos, len);
+                if (cmp != 0) {
+                    if (cmp < 0) frame->next = 1;
+                    return 0;
                 }
+                frame->next = 1;
+                if (mpt_cursor_push(cursor, ((const mpt_extension_t*)node)->next, cursor->path_len) != 0) return -1;
+                break;
             }
-            if (node->data.branch.value_len > 0) {
-                memcpy(buffer + offset, node->data.branch.value, node->data.branch.value_len);
-                offset += node->data.branch.value_len;
+            
+            case MPT_NODE_BRANCH: {
+                if (pos == start_len) return 0;
+                const mpt_branch_t* branch = (const mpt_branch_t*)node;
+                uint8_t nibble = start[pos];
+                frame->next = (uint8_t)(nibble + 1);
+                if (!(branch->node.bitmap & (1u << nibble))) return 0;
+                frame->next = (uint8_t)(nibble + 2);
+                cursor->path[pos] = nibble;
+                if (mpt_cursor_push(cursor, branch->children[branch_child_index(branch->node.bitmap, nibble)],
+                                    pos + 1) != 0) {
+                    return -1;
+                }
+                break;
             }
-            break;
             
-        default:
-            break;
+            default:
+                return -1;
+        }
     }
     
+    return 0;
+}
+
+static void mpt_cursor_emit(mpt_cursor_t* cursor, const mpt_leaf_t* leaf,
+                            const uint8_t** key, size_t* key_len,
+                            const uint8_t** value, size_t* value_len) {
+    size_t len;
+    const uint8_t* data = leaf_value(leaf, &len);
+    memcpy(cursor->value, data, len);
+    pack_nibbles(cursor->path, cursor->path_len, cursor->key);
     
-    platform_sha256(buffer, offset, hash);
-    memcpy(node->hash, hash, MPT_NODE_HASH_SIZE);
+    *key = cursor->key;
+    *key_len = cursor->path_len / 2;
+    *value = cursor->value;
+    *value_len = len;
 }
 
-static mpt_node_t* mpt_node_create(mpt_node_type_t type) {
-    mpt_node_t* node = (mpt_node_t*)platform_malloc(sizeof(mpt_node_t));
-    if (node == NULL) return NULL;
+int mpt_cursor_open(mpt_cursor_t* cursor, mpt_tree_t* tree, const uint8_t* start, size_t start_len) {
+    if (cursor == NULL || tree == NULL || tree->smt) return -1;
+    if (start == NULL && start_len > 0) return -1;
+    if (start_len > MPT_MAX_KEY_LEN) return -1;
     
-    memset(node, 0, sizeof(mpt_node_t));
-    node->type = type;
-    return node;
+    cursor->tree = tree;
+    cursor->depth = 0;
+    cursor->path_len = 0;
+    
+    mpt_cache_trim(tree);
+    if (tree->root == NULL) return 0;
+    if (mpt_cursor_push(cursor, tree->root, 0) != 0) return -1;
+    if (start_len == 0) return 0;
+    
+    uint8_t start_path[MPT_MAX_PATH_LEN];
+    size_t start_path_len = key_to_nibbles(start, start_len, start_path);
+    if (mpt_cursor_seek(cursor, start_path, start_path_len) != 0) {
+        mpt_cursor_close(cursor);
+        return -1;
+    }
+    return 0;
 }
 
-static void mpt_node_free(mpt_node_t* node) {
-    if (node == NULL) return;
+int mpt_cursor_next(mpt_cursor_t* cursor, const uint8_t** key, size_t* key_len,
+                    const uint8_t** value, size_t* value_len) {
+    if (cursor == NULL || key == NULL || key_len == NULL || value == NULL || value_len == NULL) return -1;
     
-    switch (node->type) {
-        case MPT_NODE_EXTENSION:
-            if (node->data.extension.next) {
-                mpt_node_free(node->data.extension.next);
-            }
-            break;
+    mpt_cache_trim(cursor->tree);
+    
+    while (cursor->depth > 0) {
+        mpt_cursor_frame_t* frame = &cursor->stack[cursor->depth - 1];
+        const mpt_node_t* node = frame->node;
+        
+        switch (MPT_NODE_TYPE(node)) {
+            case MPT_NODE_LEAF:
+                if (frame->next == 0) {
+                    frame->next = 1;
+                    mpt_cursor_emit(cursor, (const mpt_leaf_t*)node, key, key_len, value, value_len);
+                    return 0;
+                }
+                mpt_cursor_pop(cursor);
+                break;
             
-        case MPT_NODE_BRANCH:
-            for (int i = 0; i < 16; i++) {
-                if (node->data.branch.children[i]) {
-                    mpt_node_free(node->data.branch.children[i]);
+            case MPT_NODE_EXTENSION:
+                if (frame->next == 0) {
+                    frame->next = 1;
+                    if (mpt_cursor_push(cursor, ((const mpt_extension_t*)node)->next, cursor->path_len) != 0) return -1;
+                    break;
+                }
+                mpt_cursor_pop(cursor);
+                break;
+            
+            case MPT_NODE_BRANCH: {
+                const mpt_branch_t* branch = (const mpt_branch_t*)node;
+                if (frame->next == 0) {
+                    frame->next = 1;
+                    const mpt_leaf_t* value_leaf = branch_value(branch);
+                    if (value_leaf) {
+                        mpt_cursor_emit(cursor, value_leaf, key, key_len, value, value_len);
+                        return 0;
+                    }
+                }
+                while (frame->next <= 16 && !(branch->node.bitmap & (1u << (frame->next - 1)))) {
+                    frame->next++;
+                }
+                if (frame->next > 16) {
+                    mpt_cursor_pop(cursor);
+                    break;
                 }
+                uint8_t nibble = (uint8_t)(frame->next++ - 1);
+                size_t pos = frame->path_len;
+                if (pos >= MPT_MAX_PATH_LEN) return -1;
+                cursor->path[pos] = nibble;
+                if (mpt_cursor_push(cursor, branch->children[branch_child_index(branch->node.bitmap, nibble)],
+                                    pos + 1) != 0) {
+                    return -1;
+                }
+                break;
             }
-            break;
             
-        default:
-            break;
+            default:
+                return -1;
+        }
     }
     
-    platform_free(node);
+    return MPT_CURSOR_END;
 }
 
-int mpt_tree_init(mpt_tree_t* tree) {
-    if (tree == NULL) return -1;
+void mpt_cursor_close(mpt_cursor_t* cursor) {
+    if (cursor == NULL) return;
     
-    memset(tree, 0, sizeof(mpt_tree_t));
-    tree->root = mpt_node_create(MPT_NODE_EMPTY);
-    if (tree->root == NULL) return -1;
+    while (cursor->depth > 0) {
+        mpt_cursor_pop(cursor);
+    }
+}
+
+typedef struct {
+    mpt_write_fn write;
+    void* ctx;
+    uint8_t* buffer;
+    size_t len;
+} mpt_export_t;
+
+static int mpt_export_flush(mpt_export_t* out) {
+    if (out->len == 0) return 0;
     
-    memset(tree->root_hash, 0, MPT_NODE_HASH_SIZE);
+    if (out->write(out->ctx, out->buffer, out->len) != 0) return -1;
+    out->len = 0;
     return 0;
 }
 
-void mpt_tree_destroy(mpt_tree_t* tree) {
-    if (tree == NULL) return;
+static int mpt_export_put(mpt_export_t* out, const uint8_t* data, size_t len) {
+    if (out->len + len > MPT_SNAPSHOT_BUFFER && mpt_export_flush(out) != 0) return -1;
+    
+    memcpy(out->buffer + out->len, data, len);
+    out->len += len;
+    return 0;
+}
+
+static int mpt_export_record(mpt_export_t* out, const uint8_t* data, size_t len) {
+    uint8_t header[2] = { (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+    if (mpt_export_put(out, header, sizeof(header)) != 0) return -1;
+    return mpt_export_put(out, data, len);
+}
+
+static int mpt_export_stored(mpt_tree_t* tree, mpt_export_t* out, const uint8_t* hash) {
+    const uint8_t* data;
+    size_t len;
+    if (tree->store == NULL || mpt_store_get(tree->store, hash, &data, &len) != 0) return -1;
     
-    if (tree->root) {
-        mpt_node_free(tree->root);
-        tree->root = NULL;
+    const uint8_t* children;
+    size_t count;
+    if (mpt_encoding_children(data, len, &children, &count) != 0) return -1;
+    for (size_t i = 0; i < count; i++) {
+        if (mpt_export_stored(tree, out, children + i * MPT_NODE_HASH_SIZE) != 0) return -1;
     }
     
-    memset(tree, 0, sizeof(mpt_tree_t));
+    return mpt_export_record(out, data, len);
 }
 
-int mpt_tree_insert(mpt_tree_t* tree, const uint8_t* key, size_t key_len,
-                     const uint8_t* value, size_t value_len) {
-    if (tree == NULL || key == NULL || value == NULL) return -1;
-    if (key_len > MPT_MAX_KEY_LEN || value_len > MPT_MAX_VALUE_LEN) return -1;
+static int mpt_export_node(mpt_tree_t* tree, mpt_export_t* out, const mpt_node_t* node) {
+    if (MPT_NODE_TYPE(node) == MPT_NODE_EMPTY) return mpt_export_stored(tree, out, node->hash);
+    
+    if (MPT_NODE_TYPE(node) == MPT_NODE_EXTENSION) {
+        if (mpt_export_node(tree, out, ((const mpt_extension_t*)node)->next) != 0) return -1;
+    } else if (MPT_NODE_TYPE(node) == MPT_NODE_BRANCH) {
+        const mpt_branch_t* branch = (const mpt_branch_t*)node;
+        size_t count = branch_child_count(branch);
+        for (size_t i = 0; i < count; i++) {
+            if (mpt_export_node(tree, out, branch->children[i]) != 0) return -1;
+        }
+    }
+    
+    uint8_t buffer[MPT_MAX_NODE_ENCODING];
+    size_t len = mpt_node_encode(node, buffer);
+    return mpt_export_record(out, buffer, len);
+}
+
+static int mpt_tree_export_committed(mpt_tree_t* tree, mpt_write_fn write, void* ctx) {
+    mpt_export_t out;
+    out.write = write;
+    out.ctx = ctx;
+    out.len = 0;
+    out.buffer = (uint8_t*)platform_malloc(MPT_SNAPSHOT_BUFFER);
+    if (out.buffer == NULL) return -1;
     
+    uint8_t trailer[2 + MPT_NODE_HASH_SIZE + sizeof(uint64_t)];
+    memset(trailer, 0, sizeof(trailer));
+    memcpy(trailer + 2, tree->root_hash, MPT_NODE_HASH_SIZE);
+    for (size_t i = 0; i < sizeof(uint64_t); i++) {
+        trailer[2 + MPT_NODE_HASH_SIZE + i] = (uint8_t)((uint64_t)tree->size >> (8 * i));
+    }
     
-    mpt_node_t* leaf = mpt_node_create(MPT_NODE_LEAF);
-    if (leaf == NULL) return -1;
+    int ret = -1;
+    if (mpt_export_put(&out, (const uint8_t*)MPT_SNAPSHOT_MAGIC, 8) == 0 &&
+        (tree->root == NULL || mpt_export_node(tree, &out, tree->root) == 0) &&
+        mpt_export_put(&out, trailer, sizeof(trailer)) == 0 &&
+        mpt_export_flush(&out) == 0) {
+        ret = 0;
+    }
     
-    memcpy(leaf->data.leaf.key, key, key_len);
-    leaf->data.leaf.key_len = key_len;
-    memcpy(leaf->data.leaf.value, value, value_len);
-    leaf->data.leaf.value_len = value_len;
+    platform_free(out.buffer);
+    return ret;
+}
+
+typedef struct {
+    mpt_node_t* node;
+    size_t height;
+    uint8_t parity;
+} mpt_import_entry_t;
+
+static int mpt_import_attach(mpt_arena_t* arena, mpt_import_entry_t* entry,
+                             mpt_import_entry_t* stack, size_t* depth) {
+    mpt_node_t* node = entry->node;
+    mpt_node_t** slots;
+    size_t count;
+    size_t offset;
     
+    if (MPT_NODE_TYPE(node) == MPT_NODE_LEAF) {
+        entry->height = node->path_len;
+        entry->parity = node->path_len & 1;
+        return 0;
+    }
     
-    if (tree->root->type == MPT_NODE_EMPTY) {
-        mpt_node_free(tree->root);
-        tree->root = leaf;
+    if (MPT_NODE_TYPE(node) == MPT_NODE_EXTENSION) {
+        slots = &((mpt_extension_t*)node)->next;
+        count = 1;
+        offset = node->path_len;
     } else {
+        slots = ((mpt_branch_t*)node)->children;
+        count = branch_child_count((mpt_branch_t*)node);
+        offset = 1;
+        if (count + ((node->flags & MPT_NODE_HAS_VALUE) ? 1 : 0) < 2) return -1;
+    }
+    
+    if (*depth < count) return -1;
+    mpt_import_entry_t* children = stack + *depth - count;
+    bool has_parity = (node->flags & MPT_NODE_HAS_VALUE) != 0;
+    entry->height = 0;
+    entry->parity = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (memcmp(slots[i]->hash, children[i].node->hash, MPT_NODE_HASH_SIZE) != 0) return -1;
+        if (MPT_NODE_TYPE(node) == MPT_NODE_EXTENSION &&
+            MPT_NODE_TYPE(children[i].node) != MPT_NODE_BRANCH) {
+            return -1;
+        }
+        
+        size_t height = offset + children[i].height;
+        uint8_t parity = (uint8_t)((offset + children[i].parity) & 1);
+        if (height > MPT_MAX_PATH_LEN || (has_parity && parity != entry->parity)) return -1;
+        if (height > entry->height) entry->height = height;
+        entry->parity = parity;
+        has_parity = true;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        mpt_node_release(arena, slots[i]);
+        slots[i] = children[i].node;
+    }
+    *depth -= count;
+    return 0;
+}
+
+static int mpt_import_nodes(mpt_tree_t* tree, mpt_read_fn read, void* ctx,
+                            mpt_import_entry_t* stack, size_t* depth, size_t* size) {
+    uint8_t buffer[MPT_MAX_NODE_ENCODING];
+    
+    for (;;) {
+        uint8_t header[2];
+        if (read(ctx, header, sizeof(header)) != 0) return -1;
+        size_t len = (size_t)header[0] | ((size_t)header[1] << 8);
+        if (len == 0) return 0;
+        if (len > MPT_MAX_NODE_ENCODING || read(ctx, buffer, len) != 0) return -1;
         
+        mpt_import_entry_t entry;
+        entry.node = mpt_node_decode(&tree->arena, buffer, len);
+        if (entry.node == NULL) return -1;
+        platform_sha256(buffer, len, entry.node->hash);
         
-        mpt_node_free(tree->root);
-        tree->root = leaf;
+        if (*depth == MPT_SNAPSHOT_STACK || mpt_import_attach(&tree->arena, &entry, stack, depth) != 0) {
+            mpt_node_unref(&tree->arena, entry.node);
+            return -1;
+        }
+        if (MPT_NODE_TYPE(entry.node) == MPT_NODE_LEAF || (entry.node->flags & MPT_NODE_HAS_VALUE)) (*size)++;
+        stack[(*depth)++] = entry;
     }
+}
+
+static int mpt_import_trailer(mpt_read_fn read, void* ctx, const mpt_import_entry_t* stack,
+                              size_t depth, size_t size, uint8_t* root_hash) {
+    uint8_t trailer[MPT_NODE_HASH_SIZE + sizeof(uint64_t)];
+    if (read(ctx, trailer, sizeof(trailer)) != 0) return -1;
     
+    uint64_t expected_size = 0;
+    for (size_t i = 0; i < sizeof(uint64_t); i++) {
+        expected_size |= (uint64_t)trailer[MPT_NODE_HASH_SIZE + i] << (8 * i);
+    }
+    if (expected_size != size) return -1;
     
-    mpt_node_hash(tree->root, tree->root_hash);
-    tree->size++;
+    if (depth == 0) {
+        if (!mpt_proof_empty_root(trailer)) return -1;
+    } else if (depth != 1 || stack[0].parity != 0 ||
+               memcmp(stack[0].node->hash, trailer, MPT_NODE_HASH_SIZE) != 0) {
+        return -1;
+    }
     
+    memcpy(root_hash, trailer, MPT_NODE_HASH_SIZE);
     return 0;
 }
 
-int mpt_tree_get(mpt_tree_t* tree, const uint8_t* key, size_t key_len,
-                  uint8_t* value, size_t* value_len) {
-    if (tree == NULL || key == NULL || value == NULL || value_len == NULL) return -1;
+int mpt_tree_export(mpt_tree_t* tree, mpt_write_fn write, void* ctx) {
+    if (tree == NULL || tree->smt || write == NULL) return -1;
+    
+    if (mpt_tree_commit(tree) != 0) return -1;
+    
+    return mpt_tree_export_committed(tree, write, ctx);
+}
+
+int mpt_tree_import(mpt_tree_t* tree, mpt_read_fn read, void* ctx) {
+    if (tree == NULL || tree->smt || read == NULL) return -1;
+    
+    uint8_t magic[8];
+    if (read(ctx, magic, sizeof(magic)) != 0 || memcmp(magic, MPT_SNAPSHOT_MAGIC, 8) != 0) return -1;
+    
+    mpt_import_entry_t* stack = (mpt_import_entry_t*)platform_malloc(MPT_SNAPSHOT_STACK * sizeof(mpt_import_entry_t));
+    if (stack == NULL) return -1;
+    
+    size_t depth = 0;
+    size_t size = 0;
+    uint8_t root_hash[MPT_NODE_HASH_SIZE];
     
+    if (mpt_import_nodes(tree, read, ctx, stack, &depth, &size) != 0 ||
+        mpt_import_trailer(read, ctx, stack, depth, size, root_hash) != 0) {
+        for (size_t i = 0; i < depth; i++) {
+            mpt_node_unref(&tree->arena, stack[i].node);
+        }
+        platform_free(stack);
+        return -1;
+    }
+    
+    if (tree->journal) tree->journal_stale = true;
+    mpt_tree_reset(tree);
+    tree->root = (depth == 1) ? stack[0].node : NULL;
+    memcpy(tree->root_hash, root_hash, MPT_NODE_HASH_SIZE);
+    tree->size = size;
+    tree->dirty = (tree->store != NULL);
+    platform_free(stack);
+    
+    return mpt_tree_commit(tree);
+}
+
+int mpt_tree_encode_at(mpt_tree_t* tree, const uint8_t* path, size_t path_len,
+                       uint8_t* data, size_t* len) {
+    if (tree == NULL || tree->smt || (path == NULL && path_len > 0) || data == NULL || len == NULL) return -1;
+    if (*len < MPT_MAX_NODE_ENCODING || path_len > MPT_MAX_PATH_LEN) return -1;
     
-    if (tree->root->type == MPT_NODE_LEAF) {
-        if (tree->root->data.leaf.key_len == key_len &&
-            memcmp(tree->root->data.leaf.key, key, key_len) == 0) {
-            size_t copy_len = (*value_len < tree->root->data.leaf.value_len) ?
-                              *value_len : tree->root->data.leaf.value_len;
-            memcpy(value, tree->root->data.leaf.value, copy_len);
-            *value_len = tree->root->data.leaf.value_len;
+    if (mpt_tree_commit(tree) != 0) return -1;
+    mpt_cache_trim(tree);
+    
+    const mpt_node_t* node = tree->root;
+    size_t pos = 0;
+    while (node != NULL) {
+        if (MPT_NODE_TYPE(node) == MPT_NODE_EMPTY) {
+            node = mpt_node_load(tree, node->hash);
+            if (node == NULL) return -1;
+        }
+        if (pos == path_len) {
+            *len = mpt_node_encode(node, data);
             return 0;
         }
+        
+        if (MPT_NODE_TYPE(node) == MPT_NODE_EXTENSION) {
+            const mpt_extension_t* ext = (const mpt_extension_t*)node;
+            if (ext->node.path_len > path_len - pos ||
+                !packed_path_equals(ext->path, ext->node.path_len, path + pos, ext->node.path_len)) {
+                return -1;
+            }
+            pos += ext->node.path_len;
+            node = ext->next;
+        } else if (MPT_NODE_TYPE(node) == MPT_NODE_BRANCH) {
+            const mpt_branch_t* branch = (const mpt_branch_t*)node;
+            uint8_t nibble = path[pos++];
+            if (nibble > 0x0F || !(branch->node.bitmap & (1u << nibble))) return -1;
+            node = branch->children[branch_child_index(branch->node.bitmap, nibble)];
+        } else {
+            return -1;
+        }
     }
     
-    return -1; 
+    return -1;
 }
 
-int mpt_tree_delete(mpt_tree_t* tree, const uint8_t* key, size_t key_len) {
-    if (tree == NULL || key == NULL) return -1;
+typedef struct {
+    mpt_tree_t* tree;
+    mpt_arena_t remote;
+    mpt_fetch_fn fetch;
+    void* fetch_ctx;
+    mpt_diff_fn emit;
+    void* emit_ctx;
+    uint8_t path[MPT_MAX_PATH_LEN];
+} mpt_diff_t;
+
+typedef struct {
+    const mpt_node_t* node;
+    size_t offset;
+} mpt_diff_view_t;
+
+static int mpt_diff_resolve(mpt_diff_t* diff, mpt_diff_view_t* view, bool remote, size_t path_len) {
+    if (view->node == NULL || MPT_NODE_TYPE(view->node) != MPT_NODE_EMPTY) return 0;
+    
+    const uint8_t* hash = view->node->hash;
+    if (!remote) {
+        view->node = mpt_node_load(diff->tree, hash);
+        return view->node ? 0 : -1;
+    }
     
+    uint8_t data[MPT_MAX_NODE_ENCODING];
+    size_t len = sizeof(data);
+    if (diff->fetch(diff->fetch_ctx, diff->path, path_len, data, &len) != 0) return -1;
+    if (len > MPT_MAX_NODE_ENCODING) return -1;
     
-    if (tree->root->type == MPT_NODE_LEAF) {
-        if (tree->root->data.leaf.key_len == key_len &&
-            memcmp(tree->root->data.leaf.key, key, key_len) == 0) {
-            mpt_node_free(tree->root);
-            tree->root = mpt_node_create(MPT_NODE_EMPTY);
-            if (tree->root == NULL) return -1;
-            
-            memset(tree->root_hash, 0, MPT_NODE_HASH_SIZE);
-            tree->size--;
+    uint8_t check[MPT_NODE_HASH_SIZE];
+    platform_sha256(data, len, check);
+    if (memcmp(check, hash, MPT_NODE_HASH_SIZE) != 0) return -1;
+    
+    mpt_node_t* node = mpt_node_decode(&diff->remote, data, len);
+    if (node == NULL) return -1;
+    memcpy(node->hash, check, MPT_NODE_HASH_SIZE);
+    view->node = node;
+    return 0;
+}
+
+static uint16_t mpt_diff_expand(const mpt_diff_view_t* view, const mpt_leaf_t** value,
+                                mpt_diff_view_t* children) {
+    const mpt_node_t* node = view->node;
+    *value = NULL;
+    if (node == NULL) return 0;
+    
+    switch (MPT_NODE_TYPE(node)) {
+        case MPT_NODE_LEAF: {
+            const mpt_leaf_t* leaf = (const mpt_leaf_t*)node;
+            if (view->offset == leaf->node.path_len) {
+                *value = leaf;
+                return 0;
+            }
+            uint8_t nibble = key_nibble(leaf->data, view->offset);
+            children[nibble].node = node;
+            children[nibble].offset = view->offset + 1;
+            return (uint16_t)(1u << nibble);
+        }
+        
+        case MPT_NODE_EXTENSION: {
+            const mpt_extension_t* ext = (const mpt_extension_t*)node;
+            uint8_t nibble = key_nibble(ext->path, view->offset);
+            if (view->offset + 1 == ext->node.path_len) {
+                children[nibble].node = ext->next;
+                children[nibble].offset = 0;
+            } else {
+                children[nibble].node = node;
+                children[nibble].offset = view->offset + 1;
+            }
+            return (uint16_t)(1u << nibble);
+        }
+        
+        case MPT_NODE_BRANCH: {
+            const mpt_branch_t* branch = (const mpt_branch_t*)node;
+            size_t index = 0;
+            for (uint8_t nibble = 0; nibble < 16; nibble++) {
+                if (!(branch->node.bitmap & (1u << nibble))) continue;
+                children[nibble].node = branch->children[index++];
+                children[nibble].offset = 0;
+            }
+            *value = branch_value(branch);
+            return branch->node.bitmap;
+        }
+        
+        default:
             return 0;
+    }
+}
+
+static int mpt_diff_emit(mpt_diff_t* diff, size_t path_len,
+                         const mpt_leaf_t* local, const mpt_leaf_t* remote) {
+    const uint8_t* local_value = NULL;
+    const uint8_t* remote_value = NULL;
+    size_t local_len = 0;
+    size_t remote_len = 0;
+    if (local) local_value = leaf_value(local, &local_len);
+    if (remote) remote_value = leaf_value(remote, &remote_len);
+    
+    if (local && remote && local_len == remote_len &&
+        memcmp(local_value, remote_value, local_len) == 0) {
+        return 0;
+    }
+    if (path_len & 1) return -1;
+    
+    uint8_t key[MPT_MAX_KEY_LEN];
+    pack_nibbles(diff->path, path_len, key);
+    return diff->emit(diff->emit_ctx, key, path_len / 2, local_value, local_len, remote_value, remote_len);
+}
+
+static int mpt_diff_walk(mpt_diff_t* diff, mpt_diff_view_t local, mpt_diff_view_t remote,
+                         size_t path_len) {
+    if (local.node == NULL && remote.node == NULL) return 0;
+    if (local.node && remote.node && local.offset == 0 && remote.offset == 0 &&
+        memcmp(local.node->hash, remote.node->hash, MPT_NODE_HASH_SIZE) == 0) {
+        return 0;
+    }
+    if (mpt_diff_resolve(diff, &local, false, path_len) != 0 ||
+        mpt_diff_resolve(diff, &remote, true, path_len) != 0) {
+        return -1;
+    }
+    
+    const mpt_leaf_t* local_value;
+    const mpt_leaf_t* remote_value;
+    mpt_diff_view_t local_children[16];
+    mpt_diff_view_t remote_children[16];
+    uint16_t local_bitmap = mpt_diff_expand(&local, &local_value, local_children);
+    uint16_t remote_bitmap = mpt_diff_expand(&remote, &remote_value, remote_children);
+    
+    if ((local_value || remote_value) &&
+        mpt_diff_emit(diff, path_len, local_value, remote_value) != 0) {
+        return -1;
+    }
+    
+    uint16_t bitmap = local_bitmap | remote_bitmap;
+    if (bitmap && path_len == MPT_MAX_PATH_LEN) return -1;
+    
+    for (uint8_t nibble = 0; nibble < 16; nibble++) {
+        if (!(bitmap & (1u << nibble))) continue;
+        
+        mpt_diff_view_t empty = { NULL, 0 };
+        diff->path[path_len] = nibble;
+        if (mpt_diff_walk(diff, (local_bitmap & (1u << nibble)) ? local_children[nibble] : empty,
+                          (remote_bitmap & (1u << nibble)) ? remote_children[nibble] : empty,
+                          path_len + 1) != 0) {
+            return -1;
         }
     }
+    return 0;
+}
+
+int mpt_tree_diff(mpt_tree_t* tree, const uint8_t* remote_root,
+                  mpt_fetch_fn fetch, void* fetch_ctx,
+                  mpt_diff_fn emit, void* emit_ctx) {
+    if (tree == NULL || tree->smt || remote_root == NULL || fetch == NULL || emit == NULL) return -1;
+    
+    if (mpt_tree_commit(tree) != 0) return -1;
+    mpt_cache_trim(tree);
+    
+    mpt_diff_t diff;
+    diff.tree = tree;
+    diff.fetch = fetch;
+    diff.fetch_ctx = fetch_ctx;
+    diff.emit = emit;
+    diff.emit_ctx = emit_ctx;
+    mpt_arena_init(&diff.remote);
+    
+    mpt_diff_view_t local = { tree->root, 0 };
+    mpt_diff_view_t remote = { NULL, 0 };
+    int ret = 0;
+    if (!mpt_proof_empty_root(remote_root)) {
+        remote.node = mpt_stub_create(&diff.remote, remote_root);
+        if (remote.node == NULL) ret = -1;
+    }
     
-    return -1; 
+    if (ret == 0) ret = mpt_diff_walk(&diff, local, remote, 0);
+    mpt_arena_destroy(&diff.remote);
+    return ret;
 }
 
-int mpt_tree_get_root_hash(mpt_tree_t* tree, uint8_t* root_hash) {
-    if (tree == NULL || root_hash == NULL) return -1;
+static int mpt_tree_file_write(void* ctx, const uint8_t* data, size_t len) {
+    return fwrite(data, 1, len, (FILE*)ctx) == len ? 0 : -1;
+}
+
+static int mpt_tree_file_read(void* ctx, uint8_t* data, size_t len) {
+    return fread(data, 1, len, (FILE*)ctx) == len ? 0 : -1;
+}
+
+static int mpt_tree_sync_dir(const char* path) {
+    char dir[MPT_JOURNAL_PATH_MAX + 8];
+    strcpy(dir, path);
+    char* slash = strrchr(dir, '/');
+    if (slash == NULL) {
+        strcpy(dir, ".");
+    } else {
+        slash[slash == dir ? 1 : 0] = '\0';
+    }
     
-    memcpy(root_hash, tree->root_hash, MPT_NODE_HASH_SIZE);
+    int fd = open(dir, O_RDONLY);
+    if (fd < 0) return -1;
+    int ret = fsync(fd);
+    close(fd);
+    return ret == 0 ? 0 : -1;
+}
+
+static int mpt_tree_save_snapshot(mpt_tree_t* tree, const char* path, uint64_t generation) {
+    char tmp[MPT_JOURNAL_PATH_MAX + 16];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    
+    FILE* file = fopen(tmp, "wb");
+    if (file == NULL) return -1;
+    
+    uint8_t footer[sizeof(uint64_t)];
+    for (size_t i = 0; i < sizeof(uint64_t); i++) {
+        footer[i] = (uint8_t)(generation >> (8 * i));
+    }
+    
+    bool ok = mpt_tree_export_committed(tree, mpt_tree_file_write, file) == 0 &&
+              mpt_tree_file_write(file, footer, sizeof(footer)) == 0 &&
+              fflush(file) == 0 && fsync(fileno(file)) == 0;
+    if (fclose(file) != 0) ok = false;
+    
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return mpt_tree_sync_dir(path);
+}
+
+static int mpt_tree_load_snapshot(mpt_tree_t* tree, const char* path, uint64_t* generation) {
+    *generation = 0;
+    
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return access(path, F_OK) == 0 ? -1 : 0;
+    
+    uint8_t footer[sizeof(uint64_t)];
+    int ret = -1;
+    if (mpt_tree_import(tree, mpt_tree_file_read, file) == 0 &&
+        mpt_tree_file_read(file, footer, sizeof(footer)) == 0) {
+        for (size_t i = 0; i < sizeof(uint64_t); i++) {
+            *generation |= (uint64_t)footer[i] << (8 * i);
+        }
+        ret = 0;
+    }
+    fclose(file);
+    return ret;
+}
+
+static int mpt_tree_journal_checkpoint(mpt_tree_t* tree) {
+    mpt_journal_t* journal = tree->journal;
+    uint64_t generation = journal->generation + 1;
+    
+    if (mpt_tree_save_snapshot(tree, journal->snapshot_path, generation) != 0) return -1;
+    if (mpt_journal_checkpoint(journal, generation, tree->root_hash, tree->size) != 0) return -1;
+    
+    tree->journal_stale = false;
+    return 0;
+}
+
+static int mpt_tree_journal_commit(mpt_tree_t* tree) {
+    if (!tree->journal_stale && !mpt_journal_needs_checkpoint(tree->journal)) {
+        return mpt_journal_flush(tree->journal);
+    }
+    return mpt_tree_journal_checkpoint(tree);
+}
+
+static int mpt_tree_journal_apply(void* ctx, mpt_journal_record_type_t type,
+                                  const uint8_t* key, size_t key_len,
+                                  const uint8_t* value, size_t value_len) {
+    mpt_tree_t* tree = (mpt_tree_t*)ctx;
+    
+    if (type == MPT_JOURNAL_PUT) return mpt_tree_insert(tree, key, key_len, value, value_len);
+    if (type == MPT_JOURNAL_DELETE) {
+        mpt_tree_delete(tree, key, key_len);
+    } else {
+        mpt_tree_reset(tree);
+    }
     return 0;
 }
+
+int mpt_tree_attach_journal(mpt_tree_t* tree, mpt_journal_t* journal) {
+    if (tree == NULL || journal == NULL) return -1;
+    if (tree->smt || tree->store || tree->journal) return -1;
+    
+    uint64_t generation;
+    if (mpt_tree_load_snapshot(tree, journal->snapshot_path, &generation) != 0) return -1;
+    if (generation < journal->generation) return -1;
+    
+    if (generation == journal->generation) {
+        if (generation > 0 &&
+            (memcmp(tree->root_hash, journal->checkpoint_root, MPT_NODE_HASH_SIZE) != 0 ||
+             tree->size != journal->checkpoint_size)) {
+            return -1;
+        }
+        if (mpt_journal_replay(journal, mpt_tree_journal_apply, tree) != 0) return -1;
+    }
+    if (mpt_tree_commit(tree) != 0) return -1;
+    
+    tree->journal = journal;
+    tree->journal_stale = false;
+    if (generation > journal->generation) {
+        return mpt_journal_checkpoint(journal, generation, tree->root_hash, tree->size);
+    }
+    return (generation == 0 && tree->size > 0) ? mpt_tree_journal_checkpoint(tree) : 0;
+}
+
+int mpt_tree_checkpoint(mpt_tree_t* tree) {
+    if (tree == NULL || tree->journal == NULL) return -1;
+    
+    if (mpt_tree_commit(tree) != 0) return -1;
+    
+    return mpt_tree_journal_checkpoint(tree);
+}
@@ -4,10 +4,24 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include "mpt_arena.h"
 
 #define MPT_NODE_HASH_SIZE 32
 #define MPT_MAX_KEY_LEN 64
 #define MPT_MAX_VALUE_LEN 256
+#define MPT_MAX_PATH_LEN (MPT_MAX_KEY_LEN * 2)
+#define MPT_INLINE_VALUE_LEN 32
+#define MPT_PARALLEL_GRAIN 4096
+#define MPT_MAX_NODE_ENCODING 1024
+#define MPT_PROOF_MAX_DEPTH (MPT_MAX_PATH_LEN * 2 + 2)
+#define MPT_CACHE_MIN_BUCKETS 16
+#define MPT_CURSOR_END 1
+#define MPT_LOOKUP_LANES 8
+#define MPT_HASH_LANES 16
+#define MPT_RETIRED_INITIAL 16
+#define MPT_SNAPSHOT_MAGIC "MPTSNAP1"
+#define MPT_SNAPSHOT_BUFFER 65536
+#define MPT_SNAPSHOT_STACK (MPT_PROOF_MAX_DEPTH * 16)
 
 typedef enum {
     MPT_NODE_EMPTY = 0,
@@ -16,54 +30,256 @@ typedef enum {
     MPT_NODE_BRANCH = 3
 } mpt_node_type_t;
 
+#define MPT_NODE_TYPE_MASK 0x03
+#define MPT_NODE_DIRTY 0x04
+#define MPT_NODE_INLINE_VALUE 0x08
+#define MPT_NODE_HAS_VALUE 0x10
+
+#define MPT_NODE_TYPE(node) ((mpt_node_type_t)((node)->flags & MPT_NODE_TYPE_MASK))
+
 typedef struct mpt_node {
-    mpt_node_type_t type;
-    uint8_t hash[MPT_NODE_HASH_SIZE];  
-    union {
-        
-        struct {
-            uint8_t key[MPT_MAX_KEY_LEN];
-            size_t key_len;
-            uint8_t value[MPT_MAX_VALUE_LEN];
-            size_t value_len;
-        } leaf;
-        
-        
-        struct {
-            uint8_t key[MPT_MAX_KEY_LEN];
-            size_t key_len;
-            struct mpt_node* next;
-        } extension;
-        
-        
-        struct {
-            struct mpt_node* children[16];
-            uint8_t value[MPT_MAX_VALUE_LEN];
-            size_t value_len;
-        } branch;
-    } data;
+    uint32_t refs;
+    uint8_t flags;
+    uint8_t path_len;
+    uint16_t bitmap;
+    uint8_t hash[MPT_NODE_HASH_SIZE];
 } mpt_node_t;
 
+typedef struct {
+    mpt_node_t node;
+    uint8_t data[];
+} mpt_leaf_t;
+
+typedef struct {
+    mpt_node_t node;
+    mpt_node_t* next;
+    uint8_t path[];
+} mpt_extension_t;
+
+typedef struct {
+    mpt_node_t node;
+    mpt_node_t* children[];
+} mpt_branch_t;
+
+typedef enum {
+    MPT_BACKEND_PATRICIA = 0,
+    MPT_BACKEND_SPARSE = 1
+} mpt_backend_t;
+
+typedef struct {
+    const uint8_t* key;
+    size_t key_len;
+    const uint8_t* value;
+    size_t value_len;
+} mpt_kv_t;
+
+typedef struct {
+    const uint8_t* key;
+    size_t key_len;
+    uint8_t* value;
+    size_t value_len;
+    int result;
+} mpt_lookup_t;
+
 typedef struct {
     mpt_node_t* root;
     uint8_t root_hash[MPT_NODE_HASH_SIZE];
+    size_t size;
+    bool dirty;
+    uint64_t journal_batch;
+    size_t journal_mark;
+} mpt_snapshot_t;
+
+typedef struct {
+    uint8_t* data;
+    size_t data_len;
+    size_t node_count;
+} mpt_proof_t;
+
+typedef struct mpt_cache_entry {
+    mpt_node_t* node;
+    struct mpt_cache_entry* next;
+    struct mpt_cache_entry* lru_prev;
+    struct mpt_cache_entry* lru_next;
+} mpt_cache_entry_t;
+
+typedef struct {
+    mpt_cache_entry_t** buckets;
+    size_t bucket_count;
+    mpt_cache_entry_t* lru_head;
+    mpt_cache_entry_t* lru_tail;
+    size_t count;
+    size_t capacity;
+    size_t hits;
+    size_t misses;
+} mpt_node_cache_t;
+
+typedef struct {
+    mpt_node_t* root;
+    uint64_t epoch;
+} mpt_retired_t;
+
+typedef struct {
+    mpt_node_t* root;
+    uint8_t root_hash[MPT_NODE_HASH_SIZE];
+    size_t size;
+} mpt_version_t;
+
+typedef int (*mpt_write_fn)(void* ctx, const uint8_t* data, size_t len);
+
+typedef int (*mpt_read_fn)(void* ctx, uint8_t* data, size_t len);
+
+typedef int (*mpt_fetch_fn)(void* ctx, const uint8_t* path, size_t path_len,
+                            uint8_t* data, size_t* len);
+
+typedef int (*mpt_diff_fn)(void* ctx, const uint8_t* key, size_t key_len,
+                           const uint8_t* local_value, size_t local_len,
+                           const uint8_t* remote_value, size_t remote_len);
+
+struct thread_pool;
+struct mpt_store;
+struct mpt_rcu;
+struct mpt_smt;
+struct mpt_journal;
+
+typedef struct {
+    mpt_node_t* root;
+    mpt_arena_t arena;
+    struct thread_pool* pool;
+    struct mpt_store* store;
+    mpt_node_cache_t cache;
+    struct mpt_rcu* rcu;
+    mpt_node_t* published;
+    mpt_retired_t* retired;
+    size_t retired_count;
+    size_t retired_capacity;
+    mpt_version_t* versions;
+    size_t version_count;
+    size_t retain;
+    size_t snapshot_count;
+    struct mpt_smt* smt;
+    struct mpt_journal* journal;
+    bool journal_stale;
+    uint8_t root_hash[MPT_NODE_HASH_SIZE];
     size_t size;  
+    bool dirty;
 } mpt_tree_t;
 
+typedef struct {
+    const mpt_node_t* node;
+    uint8_t path_len;
+    uint8_t next;
+} mpt_cursor_frame_t;
+
+typedef struct {
+    mpt_tree_t* tree;
+    mpt_cursor_frame_t stack[MPT_PROOF_MAX_DEPTH];
+    size_t depth;
+    uint8_t path[MPT_MAX_PATH_LEN];
+    size_t path_len;
+    uint8_t key[MPT_MAX_KEY_LEN];
+    uint8_t value[MPT_MAX_VALUE_LEN];
+} mpt_cursor_t;
+
 int mpt_tree_init(mpt_tree_t* tree);
 
+int mpt_tree_init_backend(mpt_tree_t* tree, mpt_backend_t backend);
+
+int mpt_tree_init_alloc(mpt_tree_t* tree, struct platform_alloc* alloc);
+
+int mpt_tree_open(mpt_tree_t* tree, struct mpt_store* store, size_t cache_capacity);
+
 void mpt_tree_destroy(mpt_tree_t* tree);
 
+void mpt_tree_reset(mpt_tree_t* tree);
+
 int mpt_tree_insert(mpt_tree_t* tree, const uint8_t* key, size_t key_len,
                      const uint8_t* value, size_t value_len);
 
 int mpt_tree_get(mpt_tree_t* tree, const uint8_t* key, size_t key_len,
                   uint8_t* value, size_t* value_len);
 
+int mpt_tree_get_many(mpt_tree_t* tree, mpt_lookup_t* lookups, size_t count);
+
 int mpt_tree_delete(mpt_tree_t* tree, const uint8_t* key, size_t key_len);
 
+int mpt_tree_insert_batch(mpt_tree_t* tree, const mpt_kv_t* items, size_t count);
+
+int mpt_tree_build_sorted(mpt_tree_t* tree, const mpt_kv_t* items, size_t count);
+
+void mpt_tree_set_thread_pool(mpt_tree_t* tree, struct thread_pool* pool);
+
+int mpt_tree_commit(mpt_tree_t* tree);
+
 int mpt_tree_get_root_hash(mpt_tree_t* tree, uint8_t* root_hash);
 
+int mpt_tree_snapshot(mpt_tree_t* tree, mpt_snapshot_t* snapshot);
+
+int mpt_tree_rollback(mpt_tree_t* tree, const mpt_snapshot_t* snapshot);
+
+void mpt_tree_snapshot_release(mpt_tree_t* tree, mpt_snapshot_t* snapshot);
+
+int mpt_tree_snapshot_get(mpt_tree_t* tree, const mpt_snapshot_t* snapshot,
+                          const uint8_t* key, size_t key_len,
+                          uint8_t* value, size_t* value_len);
+
+int mpt_tree_snapshot_root_hash(mpt_tree_t* tree, mpt_snapshot_t* snapshot, uint8_t* root_hash);
+
+int mpt_tree_set_retention(mpt_tree_t* tree, size_t keep);
+
+int mpt_tree_get_at(mpt_tree_t* tree, const uint8_t* root_hash,
+                    const uint8_t* key, size_t key_len,
+                    uint8_t* value, size_t* value_len);
+
+int mpt_tree_compact(mpt_tree_t* tree);
+
+int mpt_tree_export(mpt_tree_t* tree, mpt_write_fn write, void* ctx);
+
+int mpt_tree_import(mpt_tree_t* tree, mpt_read_fn read, void* ctx);
+
+int mpt_tree_encode_at(mpt_tree_t* tree, const uint8_t* path, size_t path_len,
+                       uint8_t* data, size_t* len);
+
+int mpt_tree_diff(mpt_tree_t* tree, const uint8_t* remote_root,
+                  mpt_fetch_fn fetch, void* fetch_ctx,
+                  mpt_diff_fn emit, void* emit_ctx);
+
+int mpt_tree_attach_journal(mpt_tree_t* tree, struct mpt_journal* journal);
+
+int mpt_tree_checkpoint(mpt_tree_t* tree);
+
+int mpt_tree_attach_rcu(mpt_tree_t* tree, struct mpt_rcu* rcu);
+
+int mpt_tree_read_get(mpt_tree_t* tree, const uint8_t* key, size_t key_len,
+                      uint8_t* value, size_t* value_len);
+
+int mpt_tree_read_get_many(mpt_tree_t* tree, mpt_lookup_t* lookups, size_t count);
+
+int mpt_tree_prove(mpt_tree_t* tree, const uint8_t* key, size_t key_len, mpt_proof_t* proof);
+
+int mpt_tree_prove_many(mpt_tree_t* tree, const uint8_t* const* keys, const size_t* key_lens,
+                        size_t count, mpt_proof_t* proof);
+
+int mpt_tree_verify_proof(const uint8_t* root_hash, const uint8_t* key, size_t key_len,
+                          const mpt_proof_t* proof, bool* exists,
+                          uint8_t* value, size_t* value_len);
+
+int mpt_tree_verify_sparse_proof(const uint8_t* root_hash, const uint8_t* key, size_t key_len,
+                                 const mpt_proof_t* proof, bool* exists,
+                                 uint8_t* value, size_t* value_len);
+
+int mpt_tree_verify_multiproof(const uint8_t* root_hash, const mpt_kv_t* items, size_t count,
+                               const mpt_proof_t* proof);
+
+void mpt_proof_free(mpt_proof_t* proof);
+
+int mpt_cursor_open(mpt_cursor_t* cursor, mpt_tree_t* tree, const uint8_t* start, size_t start_len);
+
+int mpt_cursor_next(mpt_cursor_t* cursor, const uint8_t** key, size_t* key_len,
+                    const uint8_t** value, size_t* value_len);
+
+void mpt_cursor_close(mpt_cursor_t* cursor);
+
 void mpt_node_hash(mpt_node_t* node, uint8_t* hash);
 
 #endif
@@ -9,13 +9,30 @@
 extern "C" {
 #endif
 
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;
+    uint8_t block[64];
+    size_t block_len;
+} platform_sha256_ctx_t;
+
 void platform_sha256(const uint8_t* data, size_t len, uint8_t* hash);
 
+void platform_sha256_many(const uint8_t* const* data, const size_t* lens,
+                          uint8_t* const* hashes, size_t count);
+
+void platform_sha256_init(platform_sha256_ctx_t* ctx);
+void platform_sha256_update(platform_sha256_ctx_t* ctx, const uint8_t* data, size_t len);
+void platform_sha256_final(platform_sha256_ctx_t* ctx, uint8_t* hash);
+
 void* platform_malloc(size_t size);
 void platform_free(void* ptr);
 
 int platform_get_random(uint8_t* buffer, size_t len);
 
+uint64_t platform_time_ns(void);
+uint64_t platform_time_ms(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,244 @@
+#include "platform_alloc.h"
+#include "../mpt_tree/mpt_tree_common.h"
+#include <string.h>
+
+#define PLATFORM_ALLOC_ROUND(size) \
+    (((size) + PLATFORM_ALLOC_ALIGN - 1) & ~(size_t)(PLATFORM_ALLOC_ALIGN - 1))
+#define PLATFORM_ALLOC_CHUNK_HEADER PLATFORM_ALLOC_ROUND(sizeof(platform_alloc_chunk_t))
+#define PLATFORM_ALLOC_SYSTEM_HEADER PLATFORM_ALLOC_ROUND(sizeof(size_t))
+
+static void platform_alloc_setup(platform_alloc_t* alloc, const char* name, platform_alloc_kind_t kind) {
+    memset(alloc, 0, sizeof(platform_alloc_t));
+    if (name != NULL) {
+        strncpy(alloc->name, name, PLATFORM_ALLOC_NAME_MAX - 1);
+    }
+    alloc->kind = kind;
+    alloc->sample_time_ns = platform_time_ns();
+}
+
+static void platform_alloc_track(platform_alloc_t* alloc, size_t size) {
+    alloc->alloc_count++;
+    alloc->live_bytes += size;
+    if (alloc->live_bytes > alloc->peak_bytes) {
+        alloc->peak_bytes = alloc->live_bytes;
+    }
+}
+
+int platform_alloc_init_system(platform_alloc_t* alloc, const char* name) {
+    if (alloc == NULL) return -1;
+    
+    platform_alloc_setup(alloc, name, PLATFORM_ALLOC_SYSTEM);
+    return 0;
+}
+
+int platform_alloc_init_arena(platform_alloc_t* alloc, const char* name, size_t chunk_size) {
+    if (alloc == NULL) return -1;
+    if (chunk_size == 0) chunk_size = PLATFORM_ALLOC_ARENA_CHUNK;
+    if (chunk_size <= PLATFORM_ALLOC_CHUNK_HEADER) return -1;
+    
+    platform_alloc_setup(alloc, name, PLATFORM_ALLOC_ARENA);
+    alloc->chunk_size = chunk_size;
+    return 0;
+}
+
+int platform_alloc_init_pool(platform_alloc_t* alloc, const char* name,
+                             size_t object_size, size_t objects_per_chunk) {
+    if (alloc == NULL || object_size == 0) return -1;
+    if (objects_per_chunk == 0) objects_per_chunk = PLATFORM_ALLOC_POOL_OBJECTS;
+    if (object_size < sizeof(platform_alloc_slot_t)) object_size = sizeof(platform_alloc_slot_t);
+    
+    platform_alloc_setup(alloc, name, PLATFORM_ALLOC_POOL);
+    alloc->object_size = PLATFORM_ALLOC_ROUND(object_size);
+    alloc->chunk_size = PLATFORM_ALLOC_CHUNK_HEADER + alloc->object_size * objects_per_chunk;
+    return 0;
+}
+
+static platform_alloc_chunk_t* platform_alloc_new_chunk(platform_alloc_t* alloc, size_t size) {
+    platform_alloc_chunk_t* chunk = (platform_alloc_chunk_t*)platform_malloc(size);
+    if (chunk == NULL) return NULL;
+    
+    chunk->next = alloc->chunks;
+    chunk->size = size;
+    chunk->used = PLATFORM_ALLOC_CHUNK_HEADER;
+    alloc->chunks = chunk;
+    alloc->reserved_bytes += size;
+    return chunk;
+}
+
+static void* platform_alloc_bump(platform_alloc_t* alloc, size_t size) {
+    platform_alloc_chunk_t* chunk = alloc->chunks;
+    if (chunk == NULL || chunk->used + size > chunk->size) {
+        size_t chunk_size = alloc->chunk_size;
+        if (PLATFORM_ALLOC_CHUNK_HEADER + size > chunk_size) {
+            chunk_size = PLATFORM_ALLOC_CHUNK_HEADER + size;
+        }
+        chunk = platform_alloc_new_chunk(alloc, chunk_size);
+        if (chunk == NULL) return NULL;
+    }
+    
+    void* ptr = (uint8_t*)chunk + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+void* platform_alloc(platform_alloc_t* alloc, size_t size) {
+    if (alloc == NULL) return platform_malloc(size);
+    if (size == 0) return NULL;
+    
+    void* ptr = NULL;
+    switch (alloc->kind) {
+        case PLATFORM_ALLOC_SYSTEM: {
+            uint8_t* base = (uint8_t*)platform_malloc(PLATFORM_ALLOC_SYSTEM_HEADER + size);
+            if (base != NULL) {
+                memcpy(base, &size, sizeof(size_t));
+                ptr = base + PLATFORM_ALLOC_SYSTEM_HEADER;
+            }
+            break;
+        }
+        
+        case PLATFORM_ALLOC_ARENA:
+            size = PLATFORM_ALLOC_ROUND(size);
+            ptr = platform_alloc_bump(alloc, size);
+            break;
+        
+        case PLATFORM_ALLOC_POOL:
+            if (size > alloc->object_size) break;
+            size = alloc->object_size;
+            if (alloc->free_slots != NULL) {
+                ptr = alloc->free_slots;
+                alloc->free_slots = alloc->free_slots->next;
+            } else {
+                ptr = platform_alloc_bump(alloc, size);
+            }
+            break;
+    }
+    
+    if (ptr == NULL) {
+        alloc->failed_count++;
+        return NULL;
+    }
+    platform_alloc_track(alloc, size);
+    return ptr;
+}
+
+void platform_alloc_free(platform_alloc_t* alloc, void* ptr) {
+    if (alloc == NULL) {
+        platform_free(ptr);
+        return;
+    }
+    if (ptr == NULL) return;
+    
+    alloc->free_count++;
+    switch (alloc->kind) {
+        case PLATFORM_ALLOC_SYSTEM: {
+            uint8_t* base = (uint8_t*)ptr - PLATFORM_ALLOC_SYSTEM_HEADER;
+            size_t size;
+            memcpy(&size, base, sizeof(size_t));
+            alloc->live_bytes -= size;
+            platform_free(base);
+            break;
+        }
+        
+        case PLATFORM_ALLOC_ARENA:
+            break;
+        
+        case PLATFORM_ALLOC_POOL: {
+            platform_alloc_slot_t* slot = (platform_alloc_slot_t*)ptr;
+            slot->next = alloc->free_slots;
+            alloc->free_slots = slot;
+            alloc->live_bytes -= alloc->object_size;
+            break;
+        }
+    }
+}
+
+bool platform_alloc_can_reset(const platform_alloc_t* alloc) {
+    return alloc != NULL && alloc->kind != PLATFORM_ALLOC_SYSTEM;
+}
+
+int platform_alloc_reset(platform_alloc_t* alloc) {
+    if (!platform_alloc_can_reset(alloc)) return -1;
+    
+    platform_alloc_chunk_t* keep = NULL;
+    platform_alloc_chunk_t* chunk = alloc->chunks;
+    while (chunk != NULL) {
+        platform_alloc_chunk_t* next = chunk->next;
+        if (keep == NULL && chunk->size == alloc->chunk_size) {
+            keep = chunk;
+        } else {
+            platform_free(chunk);
+        }
+        chunk = next;
+    }
+    
+    if (keep != NULL) {
+        keep->next = NULL;
+        keep->used = PLATFORM_ALLOC_CHUNK_HEADER;
+    }
+    alloc->chunks = keep;
+    alloc->free_slots = NULL;
+    alloc->reserved_bytes = (keep != NULL) ? keep->size : 0;
+    alloc->live_bytes = 0;
+    alloc->reset_count++;
+    return 0;
+}
+
+void platform_alloc_destroy(platform_alloc_t* alloc) {
+    if (alloc == NULL) return;
+    
+    platform_alloc_chunk_t* chunk = alloc->chunks;
+    while (chunk != NULL) {
+        platform_alloc_chunk_t* next = chunk->next;
+        platform_free(chunk);
+        chunk = next;
+    }
+    
+    memset(alloc, 0, sizeof(platform_alloc_t));
+}
+
+void platform_alloc_get_stats(platform_alloc_t* alloc, platform_alloc_stats_t* stats) {
+    if (alloc == NULL || stats == NULL) return;
+    
+    uint64_t now = platform_time_ns();
+    uint64_t elapsed = now - alloc->sample_time_ns;
+    
+    stats->name = alloc->name;
+    stats->kind = alloc->kind;
+    stats->live_bytes = alloc->live_bytes;
+    stats->peak_bytes = alloc->peak_bytes;
+    stats->reserved_bytes = alloc->kind == PLATFORM_ALLOC_SYSTEM ? alloc->live_bytes : alloc->reserved_bytes;
+    stats->alloc_count = alloc->alloc_count;
+    stats->free_count = alloc->free_count;
+    stats->failed_count = alloc->failed_count;
+    stats->reset_count = alloc->reset_count;
+    stats->allocs_per_sec = elapsed == 0 ? 0.0 :
+        (double)(alloc->alloc_count - alloc->sample_allocs) * 1e9 / (double)elapsed;
+    
+    alloc->sample_time_ns = now;
+    alloc->sample_allocs = alloc->alloc_count;
+}
+
+int platform_array_reserve(void** items, size_t* capacity, size_t needed,
+                           size_t elem_size, size_t initial, size_t limit) {
+    if (items == NULL || capacity == NULL || elem_size == 0) return -1;
+    if (needed > limit) return -1;
+    if (needed <= *capacity) return 0;
+    
+    size_t grown = *capacity ? *capacity : (initial ? initial : 1);
+    while (grown < needed) {
+        grown = (grown > limit / 2) ? limit : grown * 2;
+    }
+    if (grown > limit) grown = limit;
+    
+    uint8_t* data = (uint8_t*)platform_malloc(grown * elem_size);
+    if (data == NULL) return -1;
+    
+    if (*items != NULL) {
+        memcpy(data, *items, *capacity * elem_size);
+        platform_free(*items);
+    }
+    memset(data + *capacity * elem_size, 0, (grown - *capacity) * elem_size);
+    *items = data;
+    *capacity = grown;
+    return 0;
+}
@@ -0,0 +1,84 @@
+#ifndef _PLATFORM_ALLOC_H_
+#define _PLATFORM_ALLOC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PLATFORM_ALLOC_ALIGN 16
+#define PLATFORM_ALLOC_NAME_MAX 32
+#define PLATFORM_ALLOC_ARENA_CHUNK (64 * 1024)
+#define PLATFORM_ALLOC_POOL_OBJECTS 256
+
+typedef enum {
+    PLATFORM_ALLOC_SYSTEM = 0,
+    PLATFORM_ALLOC_ARENA = 1,
+    PLATFORM_ALLOC_POOL = 2
+} platform_alloc_kind_t;
+
+typedef struct platform_alloc_chunk {
+    struct platform_alloc_chunk* next;
+    size_t size;
+    size_t used;
+} platform_alloc_chunk_t;
+
+typedef struct platform_alloc_slot {
+    struct platform_alloc_slot* next;
+} platform_alloc_slot_t;
+
+typedef struct {
+    const char* name;
+    platform_alloc_kind_t kind;
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+    uint64_t reserved_bytes;
+    uint64_t alloc_count;
+    uint64_t free_count;
+    uint64_t failed_count;
+    uint64_t reset_count;
+    double allocs_per_sec;
+} platform_alloc_stats_t;
+
+typedef struct platform_alloc {
+    char name[PLATFORM_ALLOC_NAME_MAX];
+    platform_alloc_kind_t kind;
+    
+    platform_alloc_chunk_t* chunks;
+    size_t chunk_size;
+    size_t object_size;
+    platform_alloc_slot_t* free_slots;
+    
+    uint64_t live_bytes;
+    uint64_t peak_bytes;
+    uint64_t reserved_bytes;
+    uint64_t alloc_count;
+    uint64_t free_count;
+    uint64_t failed_count;
+    uint64_t reset_count;
+    uint64_t sample_time_ns;
+    uint64_t sample_allocs;
+} platform_alloc_t;
+
+int platform_alloc_init_system(platform_alloc_t* alloc, const char* name);
+
+int platform_alloc_init_arena(platform_alloc_t* alloc, const char* name, size_t chunk_size);
+
+int platform_alloc_init_pool(platform_alloc_t* alloc, const char* name,
+                             size_t object_size, size_t objects_per_chunk);
+
+void platform_alloc_destroy(platform_alloc_t* alloc);
+
+void* platform_alloc(platform_alloc_t* alloc, size_t size);
+
+void platform_alloc_free(platform_alloc_t* alloc, void* ptr);
+
+int platform_alloc_reset(platform_alloc_t* alloc);
+
+bool platform_alloc_can_reset(const platform_alloc_t* alloc);
+
+void platform_alloc_get_stats(platform_alloc_t* alloc, platform_alloc_stats_t* stats);
+
+int platform_array_reserve(void** items, size_t* capacity, size_t needed,
+                           size_t elem_size, size_t initial, size_t limit);
+
+#endif
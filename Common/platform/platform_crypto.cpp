@@ -0,0 +1,659 @@
+#include "platform_crypto.h"
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+#define SHA256_MAX_LANES 16
+#define SHA256_SHANI_LANE_BLOCKS 4
+
+typedef void (*sha256_compress_fn)(uint32_t* state, const uint8_t* data, size_t blocks);
+
+typedef void (*sha256_lanes_fn)(uint32_t* state, const uint8_t* const* blocks, uint32_t active);
+
+static inline uint32_t sha256_rotr(uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+static inline uint32_t sha256_load_be(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline __attribute__((always_inline))
+void sha256_compress_generic(uint32_t* state, const uint8_t* data, size_t blocks) {
+    uint32_t w[64];
+    
+    while (blocks--) {
+        for (int i = 0; i < 16; i++) {
+            w[i] = sha256_load_be(data + 4 * i);
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = sha256_rotr(w[i - 15], 7) ^ sha256_rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = sha256_rotr(w[i - 2], 17) ^ sha256_rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t s1 = sha256_rotr(e, 6) ^ sha256_rotr(e, 11) ^ sha256_rotr(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + ch + sha256_k[i] + w[i];
+            uint32_t s0 = sha256_rotr(a, 2) ^ sha256_rotr(a, 13) ^ sha256_rotr(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + s0 + maj;
+        }
+        
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+        data += 64;
+    }
+}
+
+static void sha256_compress_scalar(uint32_t* state, const uint8_t* data, size_t blocks) {
+    sha256_compress_generic(state, data, blocks);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("bmi2")))
+static void sha256_compress_bmi2(uint32_t* state, const uint8_t* data, size_t blocks) {
+    sha256_compress_generic(state, data, blocks);
+}
+
+__attribute__((target("sha,sse4.1")))
+static void sha256_compress_shani(uint32_t* state, const uint8_t* data, size_t blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+    
+    while (blocks--) {
+        __m128i abef = state0;
+        __m128i cdgh = state1;
+        __m128i msg[4];
+        for (int i = 0; i < 4; i++) {
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), mask);
+        }
+        
+        for (int r = 0; r < 16; r++) {
+            __m128i wk = _mm_add_epi32(msg[r & 3], _mm_loadu_si128((const __m128i*)&sha256_k[4 * r]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+            
+            if (r < 12) {
+                __m128i next = _mm_sha256msg1_epu32(msg[r & 3], msg[(r + 1) & 3]);
+                next = _mm_add_epi32(next, _mm_alignr_epi8(msg[(r + 3) & 3], msg[(r + 2) & 3], 4));
+                msg[r & 3] = _mm_sha256msg2_epu32(next, msg[(r + 3) & 3]);
+            }
+        }
+        
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+        data += 64;
+    }
+    
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i*)&state[0], state0);
+    _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+#endif
+
+static sha256_compress_fn sha256_compress;
+static platform_sha256_impl_t sha256_impl;
+
+static bool sha256_impl_supported(platform_sha256_impl_t impl) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (impl == PLATFORM_SHA256_SHANI) {
+        return __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+    }
+    if (impl == PLATFORM_SHA256_BMI2) {
+        return __builtin_cpu_supports("bmi2");
+    }
+#endif
+    return impl == PLATFORM_SHA256_SCALAR;
+}
+
+int platform_sha256_set_impl(platform_sha256_impl_t impl) {
+    if (!sha256_impl_supported(impl)) return -1;
+    
+    sha256_compress_fn fn = sha256_compress_scalar;
+#if defined(__x86_64__) || defined(__i386__)
+    if (impl == PLATFORM_SHA256_SHANI) fn = sha256_compress_shani;
+    if (impl == PLATFORM_SHA256_BMI2) fn = sha256_compress_bmi2;
+#endif
+    __atomic_store_n(&sha256_impl, impl, __ATOMIC_RELAXED);
+    __atomic_store_n(&sha256_compress, fn, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static sha256_compress_fn sha256_resolve(void) {
+    sha256_compress_fn fn = __atomic_load_n(&sha256_compress, __ATOMIC_ACQUIRE);
+    if (fn != NULL) return fn;
+    
+    if (platform_sha256_set_impl(PLATFORM_SHA256_SHANI) != 0 &&
+        platform_sha256_set_impl(PLATFORM_SHA256_BMI2) != 0) {
+        platform_sha256_set_impl(PLATFORM_SHA256_SCALAR);
+    }
+    return __atomic_load_n(&sha256_compress, __ATOMIC_ACQUIRE);
+}
+
+platform_sha256_impl_t platform_sha256_get_impl(void) {
+    sha256_resolve();
+    return __atomic_load_n(&sha256_impl, __ATOMIC_RELAXED);
+}
+
+static size_t sha256_pad(const uint8_t* rest, size_t rem, uint64_t len, uint8_t* tail) {
+    memset(tail, 0, 128);
+    if (rem > 0) memcpy(tail, rest, rem);
+    tail[rem] = 0x80;
+    
+    size_t tail_len = (rem < 56) ? 64 : 128;
+    uint64_t bits = len * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[tail_len - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    return tail_len / 64;
+}
+
+static void sha256_store_be(uint8_t* hash, uint32_t word) {
+    hash[0] = (uint8_t)(word >> 24);
+    hash[1] = (uint8_t)(word >> 16);
+    hash[2] = (uint8_t)(word >> 8);
+    hash[3] = (uint8_t)word;
+}
+
+void platform_sha256(const uint8_t* data, size_t len, uint8_t* hash) {
+    if ((data == NULL && len > 0) || hash == NULL) return;
+    
+    sha256_compress_fn compress = sha256_resolve();
+    uint32_t state[8];
+    memcpy(state, sha256_iv, sizeof(state));
+    
+    size_t full = len / 64;
+    if (full > 0) compress(state, data, full);
+    
+    uint8_t tail[128];
+    compress(state, tail, sha256_pad(data + full * 64, len - full * 64, len, tail));
+    
+    for (int i = 0; i < 8; i++) {
+        sha256_store_be(hash + 4 * i, state[i]);
+    }
+}
+
+void platform_sha256_init(platform_sha256_ctx_t* ctx) {
+    if (ctx == NULL) return;
+    
+    memcpy(ctx->state, sha256_iv, sizeof(ctx->state));
+    ctx->length = 0;
+    ctx->block_len = 0;
+}
+
+void platform_sha256_update(platform_sha256_ctx_t* ctx, const uint8_t* data, size_t len) {
+    if (ctx == NULL || data == NULL || len == 0) return;
+    
+    sha256_compress_fn compress = sha256_resolve();
+    ctx->length += len;
+    
+    if (ctx->block_len > 0) {
+        size_t take = 64 - ctx->block_len;
+        if (take > len) take = len;
+        memcpy(ctx->block + ctx->block_len, data, take);
+        ctx->block_len += take;
+        data += take;
+        len -= take;
+        if (ctx->block_len < 64) return;
+        compress(ctx->state, ctx->block, 1);
+        ctx->block_len = 0;
+    }
+    
+    size_t full = len / 64;
+    if (full > 0) compress(ctx->state, data, full);
+    ctx->block_len = len - full * 64;
+    if (ctx->block_len > 0) memcpy(ctx->block, data + full * 64, ctx->block_len);
+}
+
+void platform_sha256_final(platform_sha256_ctx_t* ctx, uint8_t* hash) {
+    if (ctx == NULL || hash == NULL) return;
+    
+    sha256_compress_fn compress = sha256_resolve();
+    uint8_t tail[128];
+    compress(ctx->state, tail, sha256_pad(ctx->block, ctx->block_len, ctx->length, tail));
+    
+    for (int i = 0; i < 8; i++) {
+        sha256_store_be(hash + 4 * i, ctx->state[i]);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA256_ROTR_AVX2(x, n) _mm256_or_si256(_mm256_srli_epi32((x), (n)), _mm256_slli_epi32((x), 32 - (n)))
+
+__attribute__((target("avx2")))
+static void sha256_lanes_avx2(uint32_t* state, const uint8_t* const* blocks, uint32_t active) {
+    __m256i w[16];
+    for (int t = 0; t < 16; t++) {
+        w[t] = _mm256_setr_epi32((int)sha256_load_be(blocks[0] + 4 * t), (int)sha256_load_be(blocks[1] + 4 * t),
+                                 (int)sha256_load_be(blocks[2] + 4 * t), (int)sha256_load_be(blocks[3] + 4 * t),
+                                 (int)sha256_load_be(blocks[4] + 4 * t), (int)sha256_load_be(blocks[5] + 4 * t),
+                                 (int)sha256_load_be(blocks[6] + 4 * t), (int)sha256_load_be(blocks[7] + 4 * t));
+    }
+    
+    __m256i v[8];
+    for (int j = 0; j < 8; j++) {
+        v[j] = _mm256_loadu_si256((const __m256i*)(state + j * SHA256_MAX_LANES));
+    }
+    __m256i a = v[0], b = v[1], c = v[2], d = v[3], e = v[4], f = v[5], g = v[6], h = v[7];
+    
+    for (int t = 0; t < 64; t++) {
+        if (t >= 16) {
+            __m256i w15 = w[(t - 15) & 15];
+            __m256i w2 = w[(t - 2) & 15];
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(SHA256_ROTR_AVX2(w15, 7), SHA256_ROTR_AVX2(w15, 18)),
+                                          _mm256_srli_epi32(w15, 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(SHA256_ROTR_AVX2(w2, 17), SHA256_ROTR_AVX2(w2, 19)),
+                                          _mm256_srli_epi32(w2, 10));
+            w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+        }
+        
+        __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(SHA256_ROTR_AVX2(e, 6), SHA256_ROTR_AVX2(e, 11)),
+                                      SHA256_ROTR_AVX2(e, 25));
+        __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, s1),
+                                      _mm256_add_epi32(_mm256_add_epi32(ch, w[t & 15]),
+                                                       _mm256_set1_epi32((int)sha256_k[t])));
+        __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(SHA256_ROTR_AVX2(a, 2), SHA256_ROTR_AVX2(a, 13)),
+                                      SHA256_ROTR_AVX2(a, 22));
+        __m256i maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, _mm256_add_epi32(s0, maj));
+    }
+    
+    __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)active), bits), bits);
+    __m256i out[8] = { a, b, c, d, e, f, g, h };
+    for (int j = 0; j < 8; j++) {
+        __m256i sum = _mm256_add_epi32(v[j], out[j]);
+        _mm256_storeu_si256((__m256i*)(state + j * SHA256_MAX_LANES), _mm256_blendv_epi8(v[j], sum, mask));
+    }
+}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+#define SHA256_SIGMA_AVX512(x, r1, r2, r3) \
+    _mm512_ternarylogic_epi32(_mm512_ror_epi32((x), (r1)), _mm512_ror_epi32((x), (r2)), (r3), 0x96)
+
+__attribute__((target("avx512f")))
+static void sha256_lanes_avx512(uint32_t* state, const uint8_t* const* blocks, uint32_t active) {
+    __m512i w[16];
+    uint32_t column[SHA256_MAX_LANES];
+    for (int t = 0; t < 16; t++) {
+        for (int i = 0; i < SHA256_MAX_LANES; i++) {
+            column[i] = sha256_load_be(blocks[i] + 4 * t);
+        }
+        w[t] = _mm512_loadu_si512(column);
+    }
+    
+    __m512i v[8];
+    for (int j = 0; j < 8; j++) {
+        v[j] = _mm512_loadu_si512(state + j * SHA256_MAX_LANES);
+    }
+    __m512i a = v[0], b = v[1], c = v[2], d = v[3], e = v[4], f = v[5], g = v[6], h = v[7];
+    
+    for (int t = 0; t < 64; t++) {
+        if (t >= 16) {
+            __m512i w15 = w[(t - 15) & 15];
+            __m512i w2 = w[(t - 2) & 15];
+            __m512i s0 = SHA256_SIGMA_AVX512(w15, 7, 18, _mm512_srli_epi32(w15, 3));
+            __m512i s1 = SHA256_SIGMA_AVX512(w2, 17, 19, _mm512_srli_epi32(w2, 10));
+            w[t & 15] = _mm512_add_epi32(_mm512_add_epi32(w[t & 15], s0), _mm512_add_epi32(w[(t - 7) & 15], s1));
+        }
+        
+        __m512i s1 = SHA256_SIGMA_AVX512(e, 6, 11, _mm512_ror_epi32(e, 25));
+        __m512i ch = _mm512_ternarylogic_epi32(e, f, g, 0xCA);
+        __m512i t1 = _mm512_add_epi32(_mm512_add_epi32(h, s1),
+                                      _mm512_add_epi32(_mm512_add_epi32(ch, w[t & 15]),
+                                                       _mm512_set1_epi32((int)sha256_k[t])));
+        __m512i s0 = SHA256_SIGMA_AVX512(a, 2, 13, _mm512_ror_epi32(a, 22));
+        __m512i maj = _mm512_ternarylogic_epi32(a, b, c, 0xE8);
+        h = g;
+        g = f;
+        f = e;
+        e = _mm512_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm512_add_epi32(t1, _mm512_add_epi32(s0, maj));
+    }
+    
+    __m512i out[8] = { a, b, c, d, e, f, g, h };
+    for (int j = 0; j < 8; j++) {
+        __m512i sum = _mm512_mask_add_epi32(v[j], (__mmask16)active, v[j], out[j]);
+        _mm512_storeu_si512(state + j * SHA256_MAX_LANES, sum);
+    }
+}
+
+#pragma GCC diagnostic pop
+#endif
+
+static sha256_lanes_fn sha256_lanes;
+static size_t sha256_lane_count;
+
+int platform_sha256_set_lanes(size_t lanes) {
+    sha256_lanes_fn fn = NULL;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (lanes == 16 && __builtin_cpu_supports("avx512f")) fn = sha256_lanes_avx512;
+    if (lanes == 8 && __builtin_cpu_supports("avx2")) fn = sha256_lanes_avx2;
+#endif
+    if (fn == NULL && lanes != 1) return -1;
+    
+    __atomic_store_n(&sha256_lanes, fn, __ATOMIC_RELAXED);
+    __atomic_store_n(&sha256_lane_count, lanes, __ATOMIC_RELEASE);
+    return 0;
+}
+
+size_t platform_sha256_get_lanes(void) {
+    size_t lanes = __atomic_load_n(&sha256_lane_count, __ATOMIC_ACQUIRE);
+    if (lanes != 0) return lanes;
+    
+    if (platform_sha256_set_lanes(16) != 0 && platform_sha256_set_lanes(8) != 0) {
+        platform_sha256_set_lanes(1);
+    }
+    return __atomic_load_n(&sha256_lane_count, __ATOMIC_ACQUIRE);
+}
+
+static void sha256_many_lanes(sha256_lanes_fn lanes_fn, size_t lanes, const uint8_t* const* data,
+                              const size_t* lens, uint8_t* const* hashes, size_t count) {
+    static const uint8_t idle[64] = { 0 };
+    uint8_t tails[SHA256_MAX_LANES][128];
+    uint32_t state[8 * SHA256_MAX_LANES];
+    size_t full[SHA256_MAX_LANES];
+    size_t total[SHA256_MAX_LANES];
+    size_t rounds = 0;
+    
+    for (size_t i = 0; i < count; i++) {
+        full[i] = lens[i] / 64;
+        total[i] = full[i] + sha256_pad(data[i] + full[i] * 64, lens[i] - full[i] * 64, lens[i], tails[i]);
+        if (total[i] > rounds) rounds = total[i];
+        for (int j = 0; j < 8; j++) {
+            state[j * SHA256_MAX_LANES + i] = sha256_iv[j];
+        }
+    }
+    
+    for (size_t r = 0; r < rounds; r++) {
+        const uint8_t* blocks[SHA256_MAX_LANES];
+        uint32_t active = 0;
+        for (size_t i = 0; i < lanes; i++) {
+            blocks[i] = idle;
+            if (i >= count || r >= total[i]) continue;
+            blocks[i] = (r < full[i]) ? data[i] + 64 * r : tails[i] + 64 * (r - full[i]);
+            active |= 1u << i;
+        }
+        lanes_fn(state, blocks, active);
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        for (int j = 0; j < 8; j++) {
+            sha256_store_be(hashes[i] + 4 * j, state[j * SHA256_MAX_LANES + i]);
+        }
+    }
+}
+
+void platform_sha256_many(const uint8_t* const* data, const size_t* lens,
+                          uint8_t* const* hashes, size_t count) {
+    if (data == NULL || lens == NULL || hashes == NULL) return;
+    
+    size_t lanes = platform_sha256_get_lanes();
+    sha256_lanes_fn lanes_fn = __atomic_load_n(&sha256_lanes, __ATOMIC_RELAXED);
+    bool shani = (platform_sha256_get_impl() == PLATFORM_SHA256_SHANI);
+    size_t lane_min = shani ? lanes * 3 / 4 : 2;
+    size_t lane_blocks = (shani && lanes < SHA256_MAX_LANES) ? SHA256_SHANI_LANE_BLOCKS : SIZE_MAX;
+    
+    for (size_t base = 0; base < count; base += lanes) {
+        size_t n = (count - base < lanes) ? count - base : lanes;
+        size_t blocks = 0;
+        for (size_t i = base; i < base + n && blocks <= lane_blocks; i++) {
+            size_t padded = (lens[i] + 8) / 64 + 1;
+            if (padded > blocks) blocks = padded;
+        }
+        if (lanes_fn == NULL || n < lane_min || blocks > lane_blocks) {
+            for (size_t i = base; i < base + n; i++) {
+                platform_sha256(data[i], lens[i], hashes[i]);
+            }
+            continue;
+        }
+        sha256_many_lanes(lanes_fn, lanes, data + base, lens + base, hashes + base, n);
+    }
+}
+
+#define CHACHA20_KEY_WORDS 8
+#define CHACHA20_BLOCK_SIZE 64
+#define RANDOM_BUFFER_BLOCKS 8
+#define RANDOM_BUFFER_SIZE (RANDOM_BUFFER_BLOCKS * CHACHA20_BLOCK_SIZE)
+
+#define CHACHA20_QUARTER(x, a, b, c, d) \
+    for (int l = 0; l < RANDOM_BUFFER_BLOCKS; l++) { \
+        x[a][l] += x[b][l]; x[d][l] = chacha20_rotl(x[d][l] ^ x[a][l], 16); \
+        x[c][l] += x[d][l]; x[b][l] = chacha20_rotl(x[b][l] ^ x[c][l], 12); \
+        x[a][l] += x[b][l]; x[d][l] = chacha20_rotl(x[d][l] ^ x[a][l], 8); \
+        x[c][l] += x[d][l]; x[b][l] = chacha20_rotl(x[b][l] ^ x[c][l], 7); \
+    }
+
+typedef void (*chacha20_fn)(const uint32_t* key, uint64_t counter, uint8_t* out);
+
+typedef struct {
+    uint32_t key[CHACHA20_KEY_WORDS];
+    uint8_t buffer[RANDOM_BUFFER_SIZE];
+    size_t available;
+    uint64_t generation;
+} random_state_t;
+
+static pthread_once_t random_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t random_root_lock = PTHREAD_MUTEX_INITIALIZER;
+static random_state_t random_root;
+static uint64_t random_generation = 1;
+static __thread random_state_t random_thread;
+static chacha20_fn chacha20_generate;
+
+static inline uint32_t chacha20_rotl(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static inline __attribute__((always_inline))
+void chacha20_generic(const uint32_t* key, uint64_t counter, uint8_t* out) {
+    static const uint32_t sigma[4] = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574 };
+    uint32_t input[16][RANDOM_BUFFER_BLOCKS];
+    uint32_t x[16][RANDOM_BUFFER_BLOCKS];
+    
+    for (int l = 0; l < RANDOM_BUFFER_BLOCKS; l++) {
+        for (int i = 0; i < 4; i++) {
+            input[i][l] = sigma[i];
+        }
+        for (int i = 0; i < CHACHA20_KEY_WORDS; i++) {
+            input[4 + i][l] = key[i];
+        }
+        input[12][l] = (uint32_t)(counter + l);
+        input[13][l] = (uint32_t)((counter + l) >> 32);
+        input[14][l] = 0;
+        input[15][l] = 0;
+    }
+    memcpy(x, input, sizeof(x));
+    
+    for (int round = 0; round < 10; round++) {
+        CHACHA20_QUARTER(x, 0, 4, 8, 12);
+        CHACHA20_QUARTER(x, 1, 5, 9, 13);
+        CHACHA20_QUARTER(x, 2, 6, 10, 14);
+        CHACHA20_QUARTER(x, 3, 7, 11, 15);
+        CHACHA20_QUARTER(x, 0, 5, 10, 15);
+        CHACHA20_QUARTER(x, 1, 6, 11, 12);
+        CHACHA20_QUARTER(x, 2, 7, 8, 13);
+        CHACHA20_QUARTER(x, 3, 4, 9, 14);
+    }
+    
+    for (int l = 0; l < RANDOM_BUFFER_BLOCKS; l++) {
+        uint8_t* block = out + l * CHACHA20_BLOCK_SIZE;
+        for (int i = 0; i < 16; i++) {
+            uint32_t word = x[i][l] + input[i][l];
+            block[4 * i] = (uint8_t)word;
+            block[4 * i + 1] = (uint8_t)(word >> 8);
+            block[4 * i + 2] = (uint8_t)(word >> 16);
+            block[4 * i + 3] = (uint8_t)(word >> 24);
+        }
+    }
+}
+
+static void chacha20_scalar(const uint32_t* key, uint64_t counter, uint8_t* out) {
+    chacha20_generic(key, counter, out);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void chacha20_generic_avx2(const uint32_t* key, uint64_t counter, uint8_t* out) {
+    chacha20_generic(key, counter, out);
+}
+#endif
+
+static void random_rekey(random_state_t* state, const uint8_t* key) {
+    for (int i = 0; i < CHACHA20_KEY_WORDS; i++) {
+        state->key[i] = (uint32_t)key[4 * i] | ((uint32_t)key[4 * i + 1] << 8) |
+                        ((uint32_t)key[4 * i + 2] << 16) | ((uint32_t)key[4 * i + 3] << 24);
+    }
+}
+
+static void random_refill(random_state_t* state) {
+    chacha20_generate(state->key, 0, state->buffer);
+    random_rekey(state, state->buffer);
+    memset(state->buffer, 0, sizeof(state->key));
+    state->available = RANDOM_BUFFER_SIZE - sizeof(state->key);
+}
+
+static void random_read(random_state_t* state, uint8_t* buffer, size_t len) {
+    if (len >= RANDOM_BUFFER_SIZE) {
+        size_t chunks = len / RANDOM_BUFFER_SIZE;
+        for (size_t i = 0; i < chunks; i++) {
+            chacha20_generate(state->key, (i + 1) * RANDOM_BUFFER_BLOCKS, buffer + i * RANDOM_BUFFER_SIZE);
+        }
+        random_refill(state);
+        buffer += chunks * RANDOM_BUFFER_SIZE;
+        len -= chunks * RANDOM_BUFFER_SIZE;
+    }
+    
+    while (len > 0) {
+        if (state->available == 0) random_refill(state);
+        size_t take = (len < state->available) ? len : state->available;
+        uint8_t* source = state->buffer + RANDOM_BUFFER_SIZE - state->available;
+        memcpy(buffer, source, take);
+        memset(source, 0, take);
+        state->available -= take;
+        buffer += take;
+        len -= take;
+    }
+}
+
+static void random_fork_prepare(void) {
+    pthread_mutex_lock(&random_root_lock);
+}
+
+static void random_fork_parent(void) {
+    pthread_mutex_unlock(&random_root_lock);
+}
+
+static void random_fork_child(void) {
+    random_generation++;
+    pthread_mutex_unlock(&random_root_lock);
+}
+
+static void random_init(void) {
+    chacha20_generate = chacha20_scalar;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) chacha20_generate = chacha20_generic_avx2;
+#endif
+    pthread_atfork(random_fork_prepare, random_fork_parent, random_fork_child);
+}
+
+static int random_seed_thread(random_state_t* state) {
+    uint8_t seed[sizeof(state->key)];
+    int result = 0;
+    
+    pthread_once(&random_once, random_init);
+    pthread_mutex_lock(&random_root_lock);
+    if (random_root.generation != random_generation) {
+        if (platform_get_entropy(seed, sizeof(seed)) != 0) {
+            result = -1;
+        } else {
+            random_rekey(&random_root, seed);
+            random_root.available = 0;
+            random_root.generation = random_generation;
+        }
+    }
+    if (result == 0) {
+        random_read(&random_root, seed, sizeof(seed));
+        state->generation = random_generation;
+    }
+    pthread_mutex_unlock(&random_root_lock);
+    
+    if (result == 0) {
+        random_rekey(state, seed);
+        memset(state->buffer, 0, sizeof(state->buffer));
+        state->available = 0;
+    }
+    memset(seed, 0, sizeof(seed));
+    return result;
+}
+
+int platform_get_random(uint8_t* buffer, size_t len) {
+    if (buffer == NULL) return -1;
+    
+    random_state_t* state = &random_thread;
+    if (state->generation != __atomic_load_n(&random_generation, __ATOMIC_RELAXED) &&
+        random_seed_thread(state) != 0) {
+        return -1;
+    }
+    
+    random_read(state, buffer, len);
+    return 0;
+}
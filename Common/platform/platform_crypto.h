@@ -0,0 +1,22 @@
+#ifndef _PLATFORM_CRYPTO_H_
+#define _PLATFORM_CRYPTO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../mpt_tree/mpt_tree_common.h"
+
+typedef enum {
+    PLATFORM_SHA256_SCALAR = 0,
+    PLATFORM_SHA256_BMI2 = 1,
+    PLATFORM_SHA256_SHANI = 2
+} platform_sha256_impl_t;
+
+int platform_sha256_set_impl(platform_sha256_impl_t impl);
+platform_sha256_impl_t platform_sha256_get_impl(void);
+
+int platform_sha256_set_lanes(size_t lanes);
+size_t platform_sha256_get_lanes(void);
+
+int platform_get_entropy(uint8_t* buffer, size_t len);
+
+#endif
@@ -1,5 +1,6 @@
 #include "raft.h"
 #include "../mpt_tree/mpt_tree_common.h"
+#include "../platform/platform_alloc.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -9,9 +10,7 @@ static int get_hw_random(uint64_t* random) {
 }
 
 static uint64_t get_time_ms(void) {
-    
-    static uint64_t time_counter = 0;
-    return ++time_counter;
+    return platform_time_ms();
 }
 
 static uint64_t random_election_timeout(void) {
@@ -31,6 +30,7 @@ int raft_init(raft_state_t* raft, uint32_t node_id) {
     raft->current_term = 0;
     raft->voted_for = 0;
     raft->log_size = 0;
+    raft->log_limit = RAFT_MAX_LOG_ENTRIES;
     raft->commit_index = 0;
     raft->last_applied = 0;
     raft->leader_id = 0;
@@ -42,6 +42,32 @@ int raft_init(raft_state_t* raft, uint32_t node_id) {
     return 0;
 }
 
+void raft_destroy(raft_state_t* raft) {
+    if (raft == NULL) return;
+    
+    if (raft->log) platform_free(raft->log);
+    raft->log = NULL;
+    raft->log_size = 0;
+    raft->log_capacity = 0;
+}
+
+int raft_set_log_limit(raft_state_t* raft, size_t limit) {
+    if (raft == NULL || limit < raft->log_size) return -1;
+    
+    raft->log_limit = limit;
+    return 0;
+}
+
+static int raft_log_reserve(raft_state_t* raft, uint64_t needed) {
+    void* log = raft->log;
+    if (platform_array_reserve(&log, &raft->log_capacity, needed, sizeof(raft_log_entry_t),
+                               RAFT_LOG_INITIAL, raft->log_limit) != 0) {
+        return -1;
+    }
+    raft->log = (raft_log_entry_t*)log;
+    return 0;
+}
+
 static void become_follower(raft_state_t* raft, uint64_t term) {
     raft->role = RAFT_FOLLOWER;
     raft->current_term = term;
@@ -51,15 +77,6 @@ static void become_follower(raft_state_t* raft, uint64_t term) {
     raft->last_heartbeat = get_time_ms();
 }
 
-static void become_candidate(raft_state_t* raft) {
-    raft->role = RAFT_CANDIDATE;
-    raft->current_term++;
-    raft->voted_for = raft->my_node_id;
-    raft->leader_id = 0;
-    raft->election_timeout = random_election_timeout();
-    raft->last_heartbeat = get_time_ms();
-}
-
 static void become_leader(raft_state_t* raft) {
     raft->role = RAFT_LEADER;
     raft->leader_id = raft->my_node_id;
@@ -72,6 +89,28 @@ static void become_leader(raft_state_t* raft) {
     }
 }
 
+static bool has_vote_majority(raft_state_t* raft) {
+    size_t votes = 1;
+    for (size_t i = 0; i < raft->peer_count; i++) {
+        if (raft->peers[i].vote_granted) votes++;
+    }
+    return votes * 2 > raft->peer_count + 1;
+}
+
+static void become_candidate(raft_state_t* raft) {
+    raft->role = RAFT_CANDIDATE;
+    raft->current_term++;
+    raft->voted_for = raft->my_node_id;
+    raft->leader_id = 0;
+    raft->election_timeout = random_election_timeout();
+    raft->last_heartbeat = get_time_ms();
+    
+    for (size_t i = 0; i < raft->peer_count; i++) {
+        raft->peers[i].vote_granted = false;
+    }
+    if (has_vote_majority(raft)) become_leader(raft);
+}
+
 static int handle_request_vote(raft_state_t* raft, const raft_message_t* msg) {
     raft_message_t response;
     memset(&response, 0, sizeof(raft_message_t));
@@ -92,8 +131,9 @@ static int handle_request_vote(raft_state_t* raft, const raft_message_t* msg) {
                     (msg->term >= raft->current_term);
     
     
-    bool log_ok = (msg->candidate_last_log_term > raft->log[raft->log_size - 1].term) ||
-                  (msg->candidate_last_log_term == raft->log[raft->log_size - 1].term &&
+    uint64_t last_log_term = (raft->log_size > 0) ? raft->log[raft->log_size - 1].term : 0;
+    bool log_ok = (msg->candidate_last_log_term > last_log_term) ||
+                  (msg->candidate_last_log_term == last_log_term &&
                    msg->candidate_last_log_index >= raft->log_size);
     
     if (can_vote && log_ok && msg->term == raft->current_term) {
@@ -105,6 +145,21 @@ static int handle_request_vote(raft_state_t* raft, const raft_message_t* msg) {
     return 0;
 }
 
+static int handle_vote_response(raft_state_t* raft, const raft_message_t* msg) {
+    if (raft->role != RAFT_CANDIDATE || msg->term != raft->current_term || !msg->vote_granted) {
+        return 0;
+    }
+    
+    for (size_t i = 0; i < raft->peer_count; i++) {
+        if (raft->peers[i].node_id == msg->from_node_id) {
+            raft->peers[i].vote_granted = true;
+            if (has_vote_majority(raft)) become_leader(raft);
+            return 0;
+        }
+    }
+    return -1;
+}
+
 static int handle_append_entries(raft_state_t* raft, const raft_message_t* msg) {
     raft_message_t response;
     memset(&response, 0, sizeof(raft_message_t));
@@ -152,7 +207,7 @@ static int handle_append_entries(raft_state_t* raft, const raft_message_t* msg)
             
             if (msg->prev_log_index + i >= raft->log_size) {
                 
-                if (raft->log_size >= MAX_LOG_ENTRIES) {
+                if (raft_log_reserve(raft, raft->log_size + 1) != 0) {
                     return -1;
                 }
                 memcpy(&raft->log[raft->log_size], &msg->entries[i], sizeof(raft_log_entry_t));
@@ -189,6 +244,9 @@ int raft_process_message(raft_state_t* raft, const raft_message_t* msg) {
         case RAFT_MSG_REQUEST_VOTE:
             return handle_request_vote(raft, msg);
             
+        case RAFT_MSG_REQUEST_VOTE_RESPONSE:
+            return handle_vote_response(raft, msg);
+            
         case RAFT_MSG_APPEND_ENTRIES:
         case RAFT_MSG_HEARTBEAT:
             return handle_append_entries(raft, msg);
@@ -205,7 +263,7 @@ int raft_append_entry(raft_state_t* raft, const raft_log_entry_t* entry) {
         return -1; 
     }
     
-    if (raft->log_size >= MAX_LOG_ENTRIES) {
+    if (raft_log_reserve(raft, raft->log_size + 1) != 0) {
         return -1;
     }
     
@@ -337,6 +395,7 @@ int raft_add_peer(raft_state_t* raft, uint32_t node_id) {
     raft->peers[raft->peer_count].next_index = raft->log_size + 1;
     raft->peers[raft->peer_count].match_index = 0;
     raft->peers[raft->peer_count].is_active = true;
+    raft->peers[raft->peer_count].vote_granted = false;
     raft->peers[raft->peer_count].last_heartbeat = 0;
     raft->peer_count++;
     
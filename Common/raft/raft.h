@@ -6,7 +6,8 @@
 #include <stdbool.h>
 
 #define MAX_RAFT_NODES 16
-#define MAX_LOG_ENTRIES 100000
+#define RAFT_MAX_LOG_ENTRIES 100000
+#define RAFT_LOG_INITIAL 64
 #define RAFT_ELECTION_TIMEOUT_MIN 150  
 #define RAFT_ELECTION_TIMEOUT_MAX 300  
 #define RAFT_HEARTBEAT_INTERVAL 50    
@@ -31,6 +32,7 @@ typedef struct {
     uint64_t next_index;    
     uint64_t match_index;    
     bool is_active;
+    bool vote_granted;
     uint64_t last_heartbeat; 
 } raft_peer_t;
 
@@ -45,8 +47,10 @@ typedef struct {
     uint64_t election_timeout;  
     
     
-    raft_log_entry_t log[MAX_LOG_ENTRIES];
+    raft_log_entry_t* log;
     uint64_t log_size;          
+    size_t log_capacity;
+    size_t log_limit;
     uint64_t commit_index;      
     uint64_t last_applied;      
     
@@ -97,6 +101,10 @@ typedef struct {
 
 int raft_init(raft_state_t* raft, uint32_t node_id);
 
+void raft_destroy(raft_state_t* raft);
+
+int raft_set_log_limit(raft_state_t* raft, size_t limit);
+
 int raft_process_message(raft_state_t* raft, const raft_message_t* msg);
 
 int raft_append_entry(raft_state_t* raft, const raft_log_entry_t* entry);
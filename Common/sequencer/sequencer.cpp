@@ -8,15 +8,11 @@ int sequencer_init(sequencer_state_t* state) {
     
     memset(state, 0, sizeof(sequencer_state_t));
     
+    if (mpt_rcu_init(&state->rcu) != 0) return -1;
     
-    for (size_t i = 0; i < MAX_NODES; i++) {
-        if (mpt_tree_init(&state->token_trees[i]) != 0) {
-            return -1;
-        }
-    }
+    if (mpt_state_init(&state->token_state, &state->rcu) != 0) return -1;
     
     state->next_sequence_id = 1;
-    state->token_count = 0;
     state->log_count = 0;
     state->node_count = 0;
     state->current_leader = 0;
@@ -29,23 +25,8 @@ static int get_or_create_token_tree(sequencer_state_t* state,
                                      mpt_tree_t** tree) {
     if (state == NULL || token_address == NULL || tree == NULL) return -1;
     
-    
-    for (size_t i = 0; i < state->token_count; i++) {
-        if (memcmp(state->token_addresses[i], token_address, MAX_TOKEN_ADDRESS_LEN) == 0) {
-            *tree = &state->token_trees[i];
-            return 0;
-        }
-    }
-    
-    
-    if (state->token_count >= MAX_NODES) return -1;
-    
-    size_t idx = state->token_count;
-    memcpy(state->token_addresses[idx], token_address, MAX_TOKEN_ADDRESS_LEN);
-    *tree = &state->token_trees[idx];
-    state->token_count++;
-    
-    return 0;
+    *tree = mpt_state_open(&state->token_state, token_address);
+    return *tree ? 0 : -1;
 }
 
 int sequencer_add_log(sequencer_state_t* state, const log_entry_t* log) {
@@ -96,7 +77,7 @@ int sequencer_process_logs(sequencer_state_t* state) {
     }
     
     if (unprocessed_count == 0) {
-        free(unprocessed_logs);
+        platform_free(unprocessed_logs);
         return 0;
     }
     
@@ -201,7 +182,9 @@ int sequencer_process_logs(sequencer_state_t* state) {
         }
     }
     
-    free(unprocessed_logs);
+    mpt_state_commit(&state->token_state);
+    
+    platform_free(unprocessed_logs);
     return 0;
 }
 
@@ -218,6 +201,12 @@ int sequencer_get_token_root(sequencer_state_t* state,
     return mpt_tree_get_root_hash(tree, root_hash);
 }
 
+int sequencer_get_state_root(sequencer_state_t* state, uint8_t* root_hash) {
+    if (state == NULL || root_hash == NULL) return -1;
+    
+    return mpt_state_get_root_hash(&state->token_state, root_hash);
+}
+
 int sequencer_get_balance(sequencer_state_t* state,
                            const uint8_t* token_address,
                            const uint8_t* account,
@@ -226,17 +215,15 @@ int sequencer_get_balance(sequencer_state_t* state,
         return -1;
     }
     
-    mpt_tree_t* tree = NULL;
-    if (get_or_create_token_tree(state, token_address, &tree) != 0) {
-        return -1;
-    }
+    mpt_tree_t* tree = mpt_state_find(&state->token_state, token_address);
+    if (tree == NULL) return -1;
     
     uint8_t key[64];
     memcpy(key, account, 20);
     memcpy(key + 20, token_address, MAX_TOKEN_ADDRESS_LEN);
     
     size_t balance_len = 32;
-    return mpt_tree_get(tree, key, 52, balance, &balance_len);
+    return mpt_tree_read_get(tree, key, 52, balance, &balance_len);
 }
 
 bool sequencer_verify_log_signature(const log_entry_t* log) {
@@ -5,6 +5,8 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include "mpt_tree.h"
+#include "mpt_rcu.h"
+#include "mpt_state.h"
 
 #define MAX_LOG_ENTRIES 10000
 #define MAX_TOKEN_ADDRESS_LEN 42  
@@ -36,9 +38,8 @@ typedef struct {
 } sequencer_node_t;
 
 typedef struct {
-    mpt_tree_t token_trees[MAX_NODES];  
-    uint8_t token_addresses[MAX_NODES][MAX_TOKEN_ADDRESS_LEN];
-    size_t token_count;
+    mpt_state_t token_state;
+    mpt_rcu_t rcu;
     
     log_entry_t log_queue[MAX_LOG_ENTRIES];
     size_t log_count;
@@ -59,6 +60,8 @@ int sequencer_get_token_root(sequencer_state_t* state,
                               const uint8_t* token_address,
                               uint8_t* root_hash);
 
+int sequencer_get_state_root(sequencer_state_t* state, uint8_t* root_hash);
+
 int sequencer_get_balance(sequencer_state_t* state,
                            const uint8_t* token_address,
                            const uint8_t* account,
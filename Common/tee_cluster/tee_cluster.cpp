@@ -5,6 +5,7 @@
 #include "../raft/raft.h"
 #include "../raft/raft_network.h"
 #include "../merkle_crdt/merkle_crdt.h"
+#include "../l2_full_node/l2_full_node.h"
 #include <string.h>
 #include <stdlib.h>
 #include <set>
@@ -23,21 +24,30 @@ int tee_cluster_init(tee_cluster_state_t* cluster, uint32_t node_id) {
     cluster->my_node_id = node_id;
     cluster->current_leader = 0;
     cluster->last_leader_election = 0;
+    cluster->tx_limit = MAX_PENDING_TXS;
     
     
-    if (mpt_tree_init(&cluster->token_registry) != 0) {
+    if (platform_alloc_init_system(&cluster->mpt_node_alloc, "mpt_nodes") != 0 ||
+        platform_alloc_init_pool(&cluster->dag_node_alloc, "dag_nodes", sizeof(dag_node_t), 0) != 0 ||
+        platform_alloc_init_pool(&cluster->dag_index_alloc, "dag_conflict_index",
+                                 sizeof(conflict_index_entry_t), 0) != 0 ||
+        platform_alloc_init_arena(&cluster->verify_alloc, "l2_verify", TEE_CLUSTER_VERIFY_CHUNK) != 0) {
         return -1;
     }
     
     
-    for (size_t i = 0; i < MAX_NODES; i++) {
-        if (mpt_tree_init(&cluster->token_trees[i]) != 0) {
-            return -1;
-        }
+    if (mpt_tree_init_alloc(&cluster->token_registry, &cluster->mpt_node_alloc) != 0) {
+        return -1;
+    }
+    
+    
+    if (mpt_state_init_alloc(&cluster->token_state, NULL, &cluster->mpt_node_alloc) != 0) {
+        return -1;
     }
     
     
-    if (merkle_crdt_init(&cluster->global_dag) != 0) {
+    if (merkle_crdt_init_alloc(&cluster->global_dag, &cluster->dag_node_alloc,
+                               &cluster->dag_index_alloc) != 0) {
         return -1;
     }
     
@@ -67,6 +77,71 @@ int tee_cluster_init(tee_cluster_state_t* cluster, uint32_t node_id) {
     return 0;
 }
 
+void tee_cluster_destroy(tee_cluster_state_t* cluster) {
+    if (cluster == NULL) return;
+    
+    if (cluster->pending_txs) platform_free(cluster->pending_txs);
+    if (cluster->sorted_txs) platform_free(cluster->sorted_txs);
+    if (cluster->tx_sort_map) platform_free(cluster->tx_sort_map);
+    if (cluster->executed_txs) platform_free(cluster->executed_txs);
+    
+    if (cluster->l2_full_node_state) {
+        l2_full_node_destroy((l2_full_node_state_t*)cluster->l2_full_node_state);
+        platform_free(cluster->l2_full_node_state);
+    }
+    
+    raft_destroy(&cluster->raft);
+    tee_network_cleanup(&cluster->network);
+    merkle_crdt_destroy(&cluster->global_dag);
+    mpt_state_destroy(&cluster->token_state);
+    mpt_tree_destroy(&cluster->token_registry);
+    
+    platform_alloc_destroy(&cluster->mpt_node_alloc);
+    platform_alloc_destroy(&cluster->dag_node_alloc);
+    platform_alloc_destroy(&cluster->dag_index_alloc);
+    platform_alloc_destroy(&cluster->verify_alloc);
+    
+    memset(cluster, 0, sizeof(tee_cluster_state_t));
+}
+
+int tee_cluster_set_tx_limit(tee_cluster_state_t* cluster, size_t limit) {
+    if (cluster == NULL) return -1;
+    if (limit < cluster->pending_count || limit < cluster->sorted_count ||
+        limit < cluster->tx_sort_count || limit < cluster->executed_count) {
+        return -1;
+    }
+    
+    cluster->tx_limit = limit;
+    return 0;
+}
+
+static int tee_cluster_reserve(tee_cluster_state_t* cluster, void** items, size_t* capacity,
+                               size_t needed, size_t elem_size) {
+    return platform_array_reserve(items, capacity, needed, elem_size,
+                                  TEE_CLUSTER_TXS_INITIAL, cluster->tx_limit);
+}
+
+int tee_cluster_get_alloc_stats(tee_cluster_state_t* cluster,
+                                platform_alloc_stats_t* stats,
+                                size_t max_stats,
+                                size_t* count) {
+    if (cluster == NULL || stats == NULL || count == NULL) return -1;
+    
+    platform_alloc_t* allocs[TEE_CLUSTER_ALLOC_COUNT] = {
+        &cluster->mpt_node_alloc,
+        &cluster->dag_node_alloc,
+        &cluster->dag_index_alloc,
+        &cluster->verify_alloc
+    };
+    
+    size_t n = max_stats < TEE_CLUSTER_ALLOC_COUNT ? max_stats : TEE_CLUSTER_ALLOC_COUNT;
+    for (size_t i = 0; i < n; i++) {
+        platform_alloc_get_stats(allocs[i], &stats[i]);
+    }
+    *count = n;
+    return 0;
+}
+
 int tee_cluster_register_token(tee_cluster_state_t* cluster,
                                 const uint8_t* token_address,
                                 const uint8_t* chain_id,
@@ -87,10 +162,7 @@ int tee_cluster_register_token(tee_cluster_state_t* cluster,
     if (ret != 0) return ret;
     
     
-    if (cluster->token_count < MAX_NODES) {
-        memcpy(cluster->token_addresses[cluster->token_count], token_address, 42);
-        cluster->token_count++;
-    }
+    if (mpt_state_open(&cluster->token_state, token_address) == NULL) return -1;
     
     return 0;
 }
@@ -99,7 +171,11 @@ int tee_cluster_add_tx_request(tee_cluster_state_t* cluster,
                                 const tx_request_t* tx) {
     if (cluster == NULL || tx == NULL) return -1;
     
-    if (cluster->pending_count >= MAX_PENDING_TXS) return -1;
+    void* pending = cluster->pending_txs;
+    int rc = tee_cluster_reserve(cluster, &pending, &cluster->pending_capacity,
+                                 cluster->pending_count + 1, sizeof(tx_request_t));
+    cluster->pending_txs = (tx_request_t*)pending;
+    if (rc != 0) return -1;
     
     memcpy(&cluster->pending_txs[cluster->pending_count], tx, sizeof(tx_request_t));
     cluster->pending_count++;
@@ -169,8 +245,16 @@ int tee_cluster_sort_txs(tee_cluster_state_t* cluster) {
     }
     
     
-    memcpy(cluster->sorted_txs, cluster->pending_txs, 
-           cluster->pending_count * sizeof(tx_request_t));
+    void* sorted = cluster->sorted_txs;
+    int rc = tee_cluster_reserve(cluster, &sorted, &cluster->sorted_capacity,
+                                 cluster->pending_count, sizeof(tx_request_t));
+    cluster->sorted_txs = (tx_request_t*)sorted;
+    if (rc != 0) return -1;
+    
+    if (cluster->pending_count > 0) {
+        memcpy(cluster->sorted_txs, cluster->pending_txs, 
+               cluster->pending_count * sizeof(tx_request_t));
+    }
     cluster->sorted_count = cluster->pending_count;
     
     
@@ -183,12 +267,9 @@ int tee_cluster_sort_txs(tee_cluster_state_t* cluster) {
     }
     
     
-    uint8_t broadcast_payload[sizeof(tx_request_t) * MAX_PENDING_TXS];
     size_t payload_size = cluster->sorted_count * sizeof(tx_request_t);
-    memcpy(broadcast_payload, cluster->sorted_txs, payload_size);
-    
     tee_network_broadcast(&cluster->network, MSG_SORTED_TXS,
-                          broadcast_payload, payload_size);
+                          (const uint8_t*)cluster->sorted_txs, payload_size);
     
     return 0;
 }
@@ -236,23 +317,8 @@ int tee_cluster_process_operation(tee_cluster_state_t* cluster,
     
     
     
-    mpt_tree_t* token_tree = NULL;
-    for (size_t i = 0; i < cluster->token_count; i++) {
-        if (memcmp(cluster->token_addresses[i], op->token_address, 42) == 0) {
-            token_tree = &cluster->token_trees[i];
-            break;
-        }
-    }
-    
-    if (token_tree == NULL) {
-        
-        if (cluster->token_count >= MAX_NODES) return -1;
-        size_t idx = cluster->token_count;
-        memcpy(cluster->token_addresses[idx], op->token_address, 42);
-        mpt_tree_init(&cluster->token_trees[idx]);
-        token_tree = &cluster->token_trees[idx];
-        cluster->token_count++;
-    }
+    mpt_tree_t* token_tree = mpt_state_open(&cluster->token_state, op->token_address);
+    if (token_tree == NULL) return -1;
     
     
     merkle_crdt_update_parent_states(dag, new_node, token_tree);
@@ -303,23 +369,8 @@ int tee_cluster_process_operation_serial(tee_cluster_state_t* cluster,
     if (cluster == NULL || op == NULL) return -1;
     
     
-    mpt_tree_t* token_tree = NULL;
-    for (size_t i = 0; i < cluster->token_count; i++) {
-        if (memcmp(cluster->token_addresses[i], op->token_address, 42) == 0) {
-            token_tree = &cluster->token_trees[i];
-            break;
-        }
-    }
-    
-    if (token_tree == NULL) {
-        
-        if (cluster->token_count >= MAX_NODES) return -1;
-        size_t idx = cluster->token_count;
-        memcpy(cluster->token_addresses[idx], op->token_address, 42);
-        mpt_tree_init(&cluster->token_trees[idx]);
-        token_tree = &cluster->token_trees[idx];
-        cluster->token_count++;
-    }
+    mpt_tree_t* token_tree = mpt_state_open(&cluster->token_state, op->token_address);
+    if (token_tree == NULL) return -1;
     
     
     if (tx_ops_cache != NULL && tx_ops_cache_count != NULL && 
@@ -329,7 +380,7 @@ int tee_cluster_process_operation_serial(tee_cluster_state_t* cluster,
     }
     
     
-    uint8_t key[64];
+    uint8_t key[64] = {0};
     memcpy(key, op->account, 20);
     memcpy(key + 20, op->token_address, 42);
     
@@ -421,22 +472,8 @@ int tee_cluster_process_operations_serial_with_validation(tee_cluster_state_t* c
         
         mpt_tree_t* token_tree = NULL;
         if (tx_op_count > 0) {
-            for (size_t j = 0; j < cluster->token_count; j++) {
-                if (memcmp(cluster->token_addresses[j], tx_ops[0].token_address, 42) == 0) {
-                    token_tree = &cluster->token_trees[j];
-                    break;
-                }
-            }
-            
-            if (token_tree == NULL) {
-                
-                if (cluster->token_count >= MAX_NODES) continue;
-                size_t idx = cluster->token_count;
-                memcpy(cluster->token_addresses[idx], tx_ops[0].token_address, 42);
-                mpt_tree_init(&cluster->token_trees[idx]);
-                token_tree = &cluster->token_trees[idx];
-                cluster->token_count++;
-            }
+            token_tree = mpt_state_open(&cluster->token_state, tx_ops[0].token_address);
+            if (token_tree == NULL) continue;
         }
         
         
@@ -448,11 +485,15 @@ int tee_cluster_process_operations_serial_with_validation(tee_cluster_state_t* c
         }
         
         
+        mpt_snapshot_t before;
+        if (mpt_tree_snapshot(token_tree, &before) != 0) continue;
+        bool failed = false;
+        
         for (size_t j = 0; j < tx_op_count; j++) {
             const operation_t* op = &tx_ops[j];
             
             
-            uint8_t key[64];
+            uint8_t key[64] = {0};
             memcpy(key, op->account, 20);
             memcpy(key + 20, op->token_address, 42);
             
@@ -497,7 +538,7 @@ int tee_cluster_process_operations_serial_with_validation(tee_cluster_state_t* c
                     
                     
                     if (borrow) {
-                        
+                        failed = true;
                         break;
                     }
                 } else if (op->type == OP_SET) {
@@ -509,14 +550,22 @@ int tee_cluster_process_operations_serial_with_validation(tee_cluster_state_t* c
                 if (op->type == OP_ADD || op->type == OP_SET) {
                     memcpy(new_balance, op->amount, 32);
                 } else if (op->type == OP_SUBTRACT) {
-                    
+                    failed = true;
                     break;
                 }
             }
             
             
-            mpt_tree_insert(token_tree, key, 64, new_balance, 32);
+            if (mpt_tree_insert(token_tree, key, 64, new_balance, 32) != 0) {
+                failed = true;
+                break;
+            }
         }
+        
+        if (failed) {
+            mpt_tree_rollback(token_tree, &before);
+        }
+        mpt_tree_snapshot_release(token_tree, &before);
     }
     
     return 0;
@@ -543,9 +592,7 @@ int tee_cluster_broadcast_dag_node(tee_cluster_state_t* cluster,
     if (node == NULL) return -1;
     
     
-    if (dag->latest_count < MAX_DAG_NODES) {
-        dag->latest_nodes[dag->latest_count++] = node;
-    }
+    merkle_crdt_push_latest(dag, node);
     
     
     uint8_t broadcast_payload[1024];
@@ -678,19 +725,13 @@ int tee_cluster_generate_epoch_output(tee_cluster_state_t* cluster,
     
     
     
-    if (dag->head != NULL && cluster->token_count > 0) {
+    if (dag->head != NULL && cluster->token_state.token_count > 0) {
         
         
         for (size_t i = 0; i < dag->head->child_count; i++) {
             dag_node_t* node = dag->head->children[i];
             
-            mpt_tree_t* token_tree = NULL;
-            for (size_t j = 0; j < cluster->token_count; j++) {
-                if (memcmp(cluster->token_addresses[j], node->operation.token_address, 42) == 0) {
-                    token_tree = &cluster->token_trees[j];
-                    break;
-                }
-            }
+            mpt_tree_t* token_tree = mpt_state_open(&cluster->token_state, node->operation.token_address);
             if (token_tree != NULL) {
                 merkle_crdt_update_state(dag, token_tree);
             }
@@ -698,23 +739,7 @@ int tee_cluster_generate_epoch_output(tee_cluster_state_t* cluster,
     }
     
     
-    uint8_t all_roots[32 * MAX_NODES];
-    size_t root_count = 0;
-    
-    for (size_t i = 0; i < cluster->token_count; i++) {
-        uint8_t token_root[32];
-        if (mpt_tree_get_root_hash(&cluster->token_trees[i], token_root) == 0) {
-            memcpy(all_roots + root_count * 32, token_root, 32);
-            root_count++;
-        }
-    }
-    
-    
-    if (root_count > 0) {
-        platform_sha256(all_roots, root_count * 32, mpt_root);
-    } else {
-        memset(mpt_root, 0, 32);
-    }
+    if (mpt_state_get_root_hash(&cluster->token_state, mpt_root) != 0) return -1;
     
     
     if (dag->head != NULL) {
@@ -795,11 +820,15 @@ int tee_cluster_set_tx_sort_info(tee_cluster_state_t* cluster,
                                   size_t count) {
     if (cluster == NULL || sort_info == NULL) return -1;
     
-    if (count > MAX_PENDING_TXS) return -1;
+    if (count > cluster->tx_limit) return -1;
     
     
     for (size_t i = 0; i < count; i++) {
-        if (cluster->tx_sort_count >= MAX_PENDING_TXS) break;
+        void* sort_map = cluster->tx_sort_map;
+        int rc = tee_cluster_reserve(cluster, &sort_map, &cluster->tx_sort_capacity,
+                                     cluster->tx_sort_count + 1, sizeof(tx_sort_info_t));
+        cluster->tx_sort_map = (tx_sort_info_t*)sort_map;
+        if (rc != 0) break;
         
         
         bool exists = false;
@@ -845,9 +874,6 @@ int tee_cluster_add_executed_tx(tee_cluster_state_t* cluster,
                                  uint64_t log_index) {
     if (cluster == NULL) return -1;
     
-    if (cluster->executed_count >= MAX_PENDING_TXS) return -1;
-    
-    
     for (size_t i = 0; i < cluster->executed_count; i++) {
         if (cluster->executed_txs[i].tx_id == tx_id &&
             cluster->executed_txs[i].chain_id == chain_id) {
@@ -860,6 +886,12 @@ int tee_cluster_add_executed_tx(tee_cluster_state_t* cluster,
     }
     
     
+    void* executed = cluster->executed_txs;
+    int rc = tee_cluster_reserve(cluster, &executed, &cluster->executed_capacity,
+                                 cluster->executed_count + 1, sizeof(executed_tx_t));
+    cluster->executed_txs = (executed_tx_t*)executed;
+    if (rc != 0) return -1;
+    
     executed_tx_t* tx = &cluster->executed_txs[cluster->executed_count++];
     tx->tx_id = tx_id;
     tx->chain_id = chain_id;
@@ -879,13 +911,10 @@ int tee_cluster_leader_broadcast_tx_set(tee_cluster_state_t* cluster) {
     }
     
     
-    executed_tx_t tx_set[MAX_PENDING_TXS];
     size_t tx_set_count = 0;
-    
     for (size_t i = 0; i < cluster->executed_count; i++) {
         if (cluster->executed_txs[i].has_log) {
-            if (tx_set_count >= MAX_PENDING_TXS) break;
-            tx_set[tx_set_count++] = cluster->executed_txs[i];
+            tx_set_count++;
         }
     }
     
@@ -894,7 +923,9 @@ int tee_cluster_leader_broadcast_tx_set(tee_cluster_state_t* cluster) {
     }
     
     
-    uint8_t broadcast_payload[sizeof(executed_tx_t) * MAX_PENDING_TXS + 16];
+    uint8_t* broadcast_payload = (uint8_t*)platform_malloc(
+        sizeof(uint64_t) + sizeof(size_t) + tx_set_count * sizeof(executed_tx_t));
+    if (broadcast_payload == NULL) return -1;
     size_t offset = 0;
     
     
@@ -906,12 +937,17 @@ int tee_cluster_leader_broadcast_tx_set(tee_cluster_state_t* cluster) {
     offset += sizeof(size_t);
     
     
-    memcpy(broadcast_payload + offset, tx_set, tx_set_count * sizeof(executed_tx_t));
-    offset += tx_set_count * sizeof(executed_tx_t);
+    for (size_t i = 0; i < cluster->executed_count; i++) {
+        if (cluster->executed_txs[i].has_log) {
+            memcpy(broadcast_payload + offset, &cluster->executed_txs[i], sizeof(executed_tx_t));
+            offset += sizeof(executed_tx_t);
+        }
+    }
     
     
     tee_network_broadcast(&cluster->network, MSG_TX_SET_BROADCAST,
                           broadcast_payload, offset);
+    platform_free(broadcast_payload);
     
     return 0;
 }
@@ -958,14 +994,10 @@ int tee_cluster_receive_and_sign_tx_set(tee_cluster_state_t* cluster,
     }
     
     
-    uint8_t message[sizeof(executed_tx_t) * MAX_PENDING_TXS + 16];
     size_t msg_size = count * sizeof(executed_tx_t);
-    memcpy(message, tx_set, msg_size);
-    
-    
-    
-    platform_sha256(message, msg_size, signature);
-    memcpy(signature + 32, message, 32); 
+    memcpy(signature, tx_set_hash, 32);
+    memset(signature + 32, 0, 32);
+    memcpy(signature + 32, tx_set, msg_size < 32 ? msg_size : 32);
     
     return 0;
 }
@@ -1002,23 +1034,8 @@ int tee_cluster_listen_and_build_dag(tee_cluster_state_t* cluster,
     if (new_node == NULL) return -1;
     
     
-    mpt_tree_t* token_tree = NULL;
-    for (size_t i = 0; i < cluster->token_count; i++) {
-        if (memcmp(cluster->token_addresses[i], op->token_address, 42) == 0) {
-            token_tree = &cluster->token_trees[i];
-            break;
-        }
-    }
-    
-    if (token_tree == NULL) {
-        
-        if (cluster->token_count >= MAX_NODES) return -1;
-        size_t idx = cluster->token_count;
-        memcpy(cluster->token_addresses[idx], op->token_address, 42);
-        mpt_tree_init(&cluster->token_trees[idx]);
-        token_tree = &cluster->token_trees[idx];
-        cluster->token_count++;
-    }
+    mpt_tree_t* token_tree = mpt_state_open(&cluster->token_state, op->token_address);
+    if (token_tree == NULL) return -1;
     
     
     merkle_crdt_update_parent_states(dag, new_node, token_tree);
@@ -1360,3 +1377,124 @@ int tee_cluster_sync_all_tee_dags(tee_cluster_state_t* local_cluster,
     
     return 0;
 }
+
+int tee_cluster_export_token_state(tee_cluster_state_t* cluster,
+                                   const uint8_t* token_address,
+                                   mpt_write_fn write, void* ctx) {
+    if (cluster == NULL || token_address == NULL || write == NULL) return -1;
+    
+    mpt_tree_t* token_tree = mpt_state_find(&cluster->token_state, token_address);
+    if (token_tree == NULL) return -1;
+    
+    return mpt_tree_export(token_tree, write, ctx);
+}
+
+int tee_cluster_import_token_state(tee_cluster_state_t* cluster,
+                                   const uint8_t* token_address,
+                                   const uint8_t* expected_root,
+                                   mpt_read_fn read, void* ctx) {
+    if (cluster == NULL || token_address == NULL || expected_root == NULL || read == NULL) return -1;
+    
+    mpt_tree_t* token_tree = mpt_state_open(&cluster->token_state, token_address);
+    if (token_tree == NULL) return -1;
+    
+    mpt_snapshot_t before;
+    if (mpt_tree_snapshot(token_tree, &before) != 0) return -1;
+    
+    uint8_t root[MPT_NODE_HASH_SIZE];
+    int ret = mpt_tree_import(token_tree, read, ctx);
+    if (ret == 0 && (mpt_tree_get_root_hash(token_tree, root) != 0 ||
+                     memcmp(root, expected_root, MPT_NODE_HASH_SIZE) != 0)) {
+        mpt_tree_rollback(token_tree, &before);
+        ret = -1;
+    }
+    mpt_tree_snapshot_release(token_tree, &before);
+    return ret;
+}
+
+int tee_cluster_serve_token_node(tee_cluster_state_t* cluster,
+                                 const uint8_t* token_address,
+                                 const uint8_t* path, size_t path_len,
+                                 uint8_t* data, size_t* len) {
+    if (cluster == NULL || token_address == NULL) return -1;
+    
+    mpt_tree_t* token_tree = mpt_state_find(&cluster->token_state, token_address);
+    if (token_tree == NULL) return -1;
+    
+    return mpt_tree_encode_at(token_tree, path, path_len, data, len);
+}
+
+typedef struct {
+    uint8_t key[MPT_MAX_KEY_LEN];
+    size_t key_len;
+    uint8_t value[MPT_MAX_VALUE_LEN];
+    size_t value_len;
+    bool present;
+} token_repair_entry_t;
+
+typedef struct {
+    token_repair_entry_t* entries;
+    size_t count;
+    size_t capacity;
+} token_repair_t;
+
+static int collect_token_repair(void* ctx, const uint8_t* key, size_t key_len,
+                                const uint8_t* local_value, size_t local_len,
+                                const uint8_t* remote_value, size_t remote_len) {
+    token_repair_t* repair = (token_repair_t*)ctx;
+    
+    if (repair->count == repair->capacity) {
+        size_t capacity = repair->capacity ? repair->capacity * 2 : 16;
+        token_repair_entry_t* entries = (token_repair_entry_t*)platform_malloc(capacity * sizeof(token_repair_entry_t));
+        if (entries == NULL) return -1;
+        if (repair->entries) {
+            memcpy(entries, repair->entries, repair->count * sizeof(token_repair_entry_t));
+            platform_free(repair->entries);
+        }
+        repair->entries = entries;
+        repair->capacity = capacity;
+    }
+    
+    token_repair_entry_t* entry = &repair->entries[repair->count++];
+    memcpy(entry->key, key, key_len);
+    entry->key_len = key_len;
+    entry->present = (remote_value != NULL);
+    entry->value_len = remote_len;
+    if (remote_value) memcpy(entry->value, remote_value, remote_len);
+    return 0;
+}
+
+int tee_cluster_repair_token_state(tee_cluster_state_t* cluster,
+                                   const uint8_t* token_address,
+                                   const uint8_t* remote_root,
+                                   mpt_fetch_fn fetch, void* ctx) {
+    if (cluster == NULL || token_address == NULL || remote_root == NULL || fetch == NULL) return -1;
+    
+    mpt_tree_t* token_tree = mpt_state_open(&cluster->token_state, token_address);
+    if (token_tree == NULL) return -1;
+    
+    mpt_snapshot_t before;
+    if (mpt_tree_snapshot(token_tree, &before) != 0) return -1;
+    
+    token_repair_t repair;
+    memset(&repair, 0, sizeof(repair));
+    int ret = mpt_tree_diff(token_tree, remote_root, fetch, ctx, collect_token_repair, &repair);
+    
+    for (size_t i = 0; ret == 0 && i < repair.count; i++) {
+        const token_repair_entry_t* entry = &repair.entries[i];
+        if (entry->present) {
+            ret = mpt_tree_insert(token_tree, entry->key, entry->key_len, entry->value, entry->value_len);
+        } else {
+            ret = mpt_tree_delete(token_tree, entry->key, entry->key_len);
+        }
+    }
+    if (repair.entries) platform_free(repair.entries);
+    
+    if (ret != 0 || mpt_tree_commit(token_tree) != 0 ||
+        memcmp(token_tree->root_hash, remote_root, MPT_NODE_HASH_SIZE) != 0) {
+        mpt_tree_rollback(token_tree, &before);
+        ret = -1;
+    }
+    mpt_tree_snapshot_release(token_tree, &before);
+    return ret;
+}
@@ -8,10 +8,14 @@
 #include "merkle_crdt.h"
 #include "../tee_network/tee_network.h"
 #include "../raft/raft.h"
+#include "../platform/platform_alloc.h"
 
 #define MAX_CLUSTER_NODES 16
 #define MAX_PENDING_TXS 10000
+#define TEE_CLUSTER_TXS_INITIAL 64
 #define LEADER_ELECTION_INTERVAL 10000  
+#define TEE_CLUSTER_ALLOC_COUNT 4
+#define TEE_CLUSTER_VERIFY_CHUNK (256 * 1024)
 
 typedef struct {
     uint32_t node_id;
@@ -66,28 +70,31 @@ typedef struct {
     uint64_t last_leader_election;
     
     
-    tx_request_t pending_txs[MAX_PENDING_TXS];
+    tx_request_t* pending_txs;
     size_t pending_count;
+    size_t pending_capacity;
     
     
-    tx_request_t sorted_txs[MAX_PENDING_TXS];
+    tx_request_t* sorted_txs;
     size_t sorted_count;
+    size_t sorted_capacity;
     
     
-    tx_sort_info_t tx_sort_map[MAX_PENDING_TXS];
+    tx_sort_info_t* tx_sort_map;
     size_t tx_sort_count;
+    size_t tx_sort_capacity;
     
     
-    executed_tx_t executed_txs[MAX_PENDING_TXS];
+    executed_tx_t* executed_txs;
     size_t executed_count;
+    size_t executed_capacity;
+    size_t tx_limit;
     
     
     mpt_tree_t token_registry;   
     
     
-    mpt_tree_t token_trees[MAX_NODES];
-    uint8_t token_addresses[MAX_NODES][42];
-    size_t token_count;
+    mpt_state_t token_state;
     
     
     merkle_crdt_dag_t global_dag;  
@@ -116,10 +123,25 @@ typedef struct {
     
     
     void* l2_full_node_state;  
+    
+    
+    platform_alloc_t mpt_node_alloc;
+    platform_alloc_t dag_node_alloc;
+    platform_alloc_t dag_index_alloc;
+    platform_alloc_t verify_alloc;
 } tee_cluster_state_t;
 
 int tee_cluster_init(tee_cluster_state_t* cluster, uint32_t node_id);
 
+void tee_cluster_destroy(tee_cluster_state_t* cluster);
+
+int tee_cluster_set_tx_limit(tee_cluster_state_t* cluster, size_t limit);
+
+int tee_cluster_get_alloc_stats(tee_cluster_state_t* cluster,
+                                platform_alloc_stats_t* stats,
+                                size_t max_stats,
+                                size_t* count);
+
 int tee_cluster_register_token(tee_cluster_state_t* cluster,
                                 const uint8_t* token_address,
                                 const uint8_t* chain_id,
@@ -219,7 +241,7 @@ int tee_cluster_listen_and_build_dag(tee_cluster_state_t* cluster,
 
 int tee_cluster_generate_and_send_epoch_output(tee_cluster_state_t* cluster);
 
-int tee_cluster_leader_collect_epoch_out
+int tee_cluster_leader_collect_epoch_outputs(tee_cluster_state_t* cluster);
 
 int tee_cluster_leader_sync_to_l2_chains(tee_cluster_state_t* cluster);
 
@@ -229,4 +251,23 @@ int tee_cluster_sync_node_from_other_tee(tee_cluster_state_t* local_cluster,
 int tee_cluster_sync_all_tee_dags(tee_cluster_state_t* local_cluster,
                                    const tee_cluster_state_t* remote_cluster);
 
+int tee_cluster_export_token_state(tee_cluster_state_t* cluster,
+                                   const uint8_t* token_address,
+                                   mpt_write_fn write, void* ctx);
+
+int tee_cluster_import_token_state(tee_cluster_state_t* cluster,
+                                   const uint8_t* token_address,
+                                   const uint8_t* expected_root,
+                                   mpt_read_fn read, void* ctx);
+
+int tee_cluster_serve_token_node(tee_cluster_state_t* cluster,
+                                 const uint8_t* token_address,
+                                 const uint8_t* path, size_t path_len,
+                                 uint8_t* data, size_t* len);
+
+int tee_cluster_repair_token_state(tee_cluster_state_t* cluster,
+                                   const uint8_t* token_address,
+                                   const uint8_t* remote_root,
+                                   mpt_fetch_fn fetch, void* ctx);
+
 #endif
@@ -95,24 +95,22 @@ int tee_cluster_distributed_verify_logs_merkle_crdt(
     
     
     for (const auto& pair : tee_tasks) {
-          
+        
         const std::vector<size_t>& task_indices = pair.second;
         
         
-        l2_log_entry_t* tee_logs = (l2_log_entry_t*)platform_malloc(
+        platform_alloc_t* scratch = &cluster->verify_alloc;
+        l2_log_entry_t* tee_logs = (l2_log_entry_t*)platform_alloc(scratch,
             task_indices.size() * sizeof(l2_log_entry_t));
-        log_existence_proof_t* tee_proofs = (log_existence_proof_t*)platform_malloc(
+        log_existence_proof_t* tee_proofs = (log_existence_proof_t*)platform_alloc(scratch,
             task_indices.size() * sizeof(log_existence_proof_t));
-        bool* tee_results = (bool*)platform_malloc(
+        bool* tee_results = (bool*)platform_alloc(scratch,
             task_indices.size() * sizeof(bool));
-        uint32_t* verified_by = (uint32_t*)platform_malloc(
+        uint32_t* verified_by = (uint32_t*)platform_alloc(scratch,
             task_indices.size() * sizeof(uint32_t));
         
         if (tee_logs == NULL || tee_proofs == NULL || tee_results == NULL || verified_by == NULL) {
-            if (tee_logs) platform_free(tee_logs);
-            if (tee_proofs) platform_free(tee_proofs);
-            if (tee_results) platform_free(tee_results);
-            if (verified_by) platform_free(verified_by);
+            platform_alloc_reset(scratch);
             continue;
         }
         
@@ -135,10 +133,7 @@ int tee_cluster_distributed_verify_logs_merkle_crdt(
             tasks[task_idx].is_assigned = true;
         }
         
-        platform_free(tee_logs);
-        platform_free(tee_proofs);
-        platform_free(tee_results);
-        platform_free(verified_by);
+        platform_alloc_reset(scratch);
     }
     
     return 0;
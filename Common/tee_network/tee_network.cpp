@@ -51,27 +51,23 @@ int tee_network_add_node(tee_network_state_t* network,
     return 0;
 }
 
+static void tee_network_message_digest(const tee_message_t* message, uint8_t* hash) {
+    platform_sha256_ctx_t ctx;
+    platform_sha256_init(&ctx);
+    platform_sha256_update(&ctx, (const uint8_t*)&message->header.from_node_id, sizeof(uint32_t));
+    platform_sha256_update(&ctx, (const uint8_t*)&message->header.to_node_id, sizeof(uint32_t));
+    platform_sha256_update(&ctx, (const uint8_t*)&message->header.type, sizeof(message_type_t));
+    platform_sha256_update(&ctx, (const uint8_t*)&message->header.payload_size, sizeof(uint32_t));
+    platform_sha256_update(&ctx, message->payload, message->header.payload_size);
+    platform_sha256_final(&ctx, hash);
+}
+
 int tee_network_sign_message(tee_message_t* message) {
     if (message == NULL) return -1;
     
     
     uint8_t hash[32];
-    uint8_t buffer[sizeof(message_header_t) + MAX_MESSAGE_SIZE];
-    size_t offset = 0;
-    
-    memcpy(buffer + offset, &message->header.from_node_id, sizeof(uint32_t));
-    offset += sizeof(uint32_t);
-    memcpy(buffer + offset, &message->header.to_node_id, sizeof(uint32_t));
-    offset += sizeof(uint32_t);
-    memcpy(buffer + offset, &message->header.type, sizeof(message_type_t));
-    offset += sizeof(message_type_t);
-    memcpy(buffer + offset, &message->header.payload_size, sizeof(uint32_t));
-    offset += sizeof(uint32_t);
-    memcpy(buffer + offset, message->payload, message->header.payload_size);
-    offset += message->header.payload_size;
-    
-    
-    platform_sha256(buffer, offset, hash);
+    tee_network_message_digest(message, hash);
     
     
     
@@ -86,22 +82,7 @@ bool tee_network_verify_message(const tee_message_t* message) {
     
     
     uint8_t hash[32];
-    uint8_t buffer[sizeof(message_header_t) + MAX_MESSAGE_SIZE];
-    size_t offset = 0;
-    
-    memcpy(buffer + offset, &message->header.from_node_id, sizeof(uint32_t));
-    offset += sizeof(uint32_t);
-    memcpy(buffer + offset, &message->header.to_node_id, sizeof(uint32_t));
-    offset += sizeof(uint32_t);
-    memcpy(buffer + offset, &message->header.type, sizeof(message_type_t));
-    offset += sizeof(message_type_t);
-    memcpy(buffer + offset, &message->header.payload_size, sizeof(uint32_t));
-    offset += sizeof(uint32_t);
-    memcpy(buffer + offset, message->payload, message->header.payload_size);
-    offset += message->header.payload_size;
-    
-    
-    platform_sha256(buffer, offset, hash);
+    tee_network_message_digest(message, hash);
     
     
     
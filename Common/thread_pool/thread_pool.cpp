@@ -0,0 +1,233 @@
+#include "thread_pool.h"
+#include "../mpt_tree/mpt_tree_common.h"
+#include <string.h>
+#include <sched.h>
+
+static __thread thread_pool_t* tp_current_pool = NULL;
+static __thread size_t tp_current_index = 0;
+
+static size_t thread_pool_self(thread_pool_t* pool) {
+    return (tp_current_pool == pool) ? tp_current_index : 0;
+}
+
+static int deque_init(thread_pool_deque_t* deque) {
+    deque->tasks = (thread_pool_task_t**)platform_malloc(THREAD_POOL_DEQUE_INITIAL * sizeof(thread_pool_task_t*));
+    if (deque->tasks == NULL) return -1;
+    
+    pthread_mutex_init(&deque->lock, NULL);
+    deque->capacity = THREAD_POOL_DEQUE_INITIAL;
+    deque->top = 0;
+    deque->bottom = 0;
+    return 0;
+}
+
+static void deque_destroy(thread_pool_deque_t* deque) {
+    pthread_mutex_destroy(&deque->lock);
+    platform_free(deque->tasks);
+    deque->tasks = NULL;
+}
+
+static int deque_push(thread_pool_deque_t* deque, thread_pool_task_t* task) {
+    pthread_mutex_lock(&deque->lock);
+    
+    if (deque->bottom - deque->top == deque->capacity) {
+        size_t capacity = deque->capacity * 2;
+        thread_pool_task_t** tasks = (thread_pool_task_t**)platform_malloc(capacity * sizeof(thread_pool_task_t*));
+        if (tasks == NULL) {
+            pthread_mutex_unlock(&deque->lock);
+            return -1;
+        }
+        for (size_t i = 0; i < deque->capacity; i++) {
+            tasks[i] = deque->tasks[(deque->top + i) % deque->capacity];
+        }
+        platform_free(deque->tasks);
+        deque->tasks = tasks;
+        deque->bottom -= deque->top;
+        deque->top = 0;
+        deque->capacity = capacity;
+    }
+    
+    deque->tasks[deque->bottom % deque->capacity] = task;
+    deque->bottom++;
+    
+    pthread_mutex_unlock(&deque->lock);
+    return 0;
+}
+
+static thread_pool_task_t* deque_pop(thread_pool_deque_t* deque) {
+    thread_pool_task_t* task = NULL;
+    
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        deque->bottom--;
+        task = deque->tasks[deque->bottom % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+static thread_pool_task_t* deque_steal(thread_pool_deque_t* deque) {
+    thread_pool_task_t* task = NULL;
+    
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        task = deque->tasks[deque->top % deque->capacity];
+        deque->top++;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+static thread_pool_task_t* thread_pool_take(thread_pool_t* pool, size_t self) {
+    size_t deque_count = pool->thread_count + 1;
+    
+    thread_pool_task_t* task = deque_pop(&pool->deques[self]);
+    for (size_t i = 1; task == NULL && i < deque_count; i++) {
+        task = deque_steal(&pool->deques[(self + i) % deque_count]);
+    }
+    
+    if (task != NULL) {
+        __atomic_fetch_sub(&pool->pending, 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+static void thread_pool_run(thread_pool_task_t* task) {
+    task->fn(task->arg);
+    __atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+}
+
+static void* thread_pool_worker(void* arg) {
+    thread_pool_worker_t* worker = (thread_pool_worker_t*)arg;
+    thread_pool_t* pool = worker->pool;
+    
+    tp_current_pool = pool;
+    tp_current_index = worker->index;
+    
+    while (true) {
+        thread_pool_task_t* task = thread_pool_take(pool, worker->index);
+        if (task != NULL) {
+            thread_pool_run(task);
+            continue;
+        }
+        
+        pthread_mutex_lock(&pool->idle_lock);
+        while (!pool->stop && __atomic_load_n(&pool->pending, __ATOMIC_RELAXED) == 0) {
+            pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+        }
+        bool stop = pool->stop;
+        pthread_mutex_unlock(&pool->idle_lock);
+        
+        if (stop) break;
+    }
+    
+    return NULL;
+}
+
+int thread_pool_init(thread_pool_t* pool, size_t thread_count) {
+    if (pool == NULL || thread_count > THREAD_POOL_MAX_THREADS) return -1;
+    
+    memset(pool, 0, sizeof(thread_pool_t));
+    pool->thread_count = thread_count;
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+    
+    pool->deques = (thread_pool_deque_t*)platform_malloc((thread_count + 1) * sizeof(thread_pool_deque_t));
+    pool->workers = (thread_pool_worker_t*)platform_malloc((thread_count + 1) * sizeof(thread_pool_worker_t));
+    if (pool->deques == NULL || pool->workers == NULL) {
+        platform_free(pool->deques);
+        platform_free(pool->workers);
+        return -1;
+    }
+    
+    for (size_t i = 0; i <= thread_count; i++) {
+        if (deque_init(&pool->deques[i]) != 0) {
+            while (i > 0) deque_destroy(&pool->deques[--i]);
+            platform_free(pool->deques);
+            platform_free(pool->workers);
+            return -1;
+        }
+    }
+    
+    for (size_t i = 0; i < thread_count; i++) {
+        thread_pool_worker_t* worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i + 1;
+        if (pthread_create(&worker->thread, NULL, thread_pool_worker, worker) != 0) {
+            pthread_mutex_lock(&pool->idle_lock);
+            pool->stop = true;
+            pthread_cond_broadcast(&pool->idle_cond);
+            pthread_mutex_unlock(&pool->idle_lock);
+            for (size_t j = 0; j < i; j++) {
+                pthread_join(pool->workers[j].thread, NULL);
+            }
+            for (size_t j = 0; j <= thread_count; j++) {
+                deque_destroy(&pool->deques[j]);
+            }
+            platform_free(pool->deques);
+            platform_free(pool->workers);
+            memset(pool, 0, sizeof(thread_pool_t));
+            return -1;
+        }
+    }
+    
+    return 0;
+}
+
+void thread_pool_destroy(thread_pool_t* pool) {
+    if (pool == NULL || pool->deques == NULL) return;
+    
+    pthread_mutex_lock(&pool->idle_lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+    
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    
+    for (size_t i = 0; i <= pool->thread_count; i++) {
+        deque_destroy(&pool->deques[i]);
+    }
+    
+    platform_free(pool->deques);
+    platform_free(pool->workers);
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle_cond);
+    memset(pool, 0, sizeof(thread_pool_t));
+}
+
+int thread_pool_spawn(thread_pool_t* pool, thread_pool_task_t* task,
+                      void (*fn)(void* arg), void* arg) {
+    if (pool == NULL || task == NULL || fn == NULL) return -1;
+    
+    task->fn = fn;
+    task->arg = arg;
+    task->done = 0;
+    
+    __atomic_fetch_add(&pool->pending, 1, __ATOMIC_RELAXED);
+    if (deque_push(&pool->deques[thread_pool_self(pool)], task) != 0) {
+        __atomic_fetch_sub(&pool->pending, 1, __ATOMIC_RELAXED);
+        thread_pool_run(task);
+        return 0;
+    }
+    
+    pthread_mutex_lock(&pool->idle_lock);
+    pthread_cond_signal(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+    return 0;
+}
+
+void thread_pool_wait(thread_pool_t* pool, thread_pool_task_t* task) {
+    if (pool == NULL || task == NULL) return;
+    
+    size_t self = thread_pool_self(pool);
+    while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+        thread_pool_task_t* other = thread_pool_take(pool, self);
+        if (other != NULL) {
+            thread_pool_run(other);
+        } else {
+            sched_yield();
+        }
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define THREAD_POOL_MAX_THREADS 256
+#define THREAD_POOL_DEQUE_INITIAL 64
+
+typedef struct thread_pool_task {
+    void (*fn)(void* arg);
+    void* arg;
+    int done;
+} thread_pool_task_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    thread_pool_task_t** tasks;
+    size_t capacity;
+    size_t top;
+    size_t bottom;
+} thread_pool_deque_t;
+
+struct thread_pool;
+
+typedef struct {
+    struct thread_pool* pool;
+    size_t index;
+    pthread_t thread;
+} thread_pool_worker_t;
+
+typedef struct thread_pool {
+    thread_pool_worker_t* workers;
+    thread_pool_deque_t* deques;
+    size_t thread_count;
+    
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    size_t pending;
+    bool stop;
+} thread_pool_t;
+
+int thread_pool_init(thread_pool_t* pool, size_t thread_count);
+
+void thread_pool_destroy(thread_pool_t* pool);
+
+int thread_pool_spawn(thread_pool_t* pool, thread_pool_task_t* task,
+                      void (*fn)(void* arg), void* arg);
+
+void thread_pool_wait(thread_pool_t* pool, thread_pool_task_t* task);
+
+#endif
@@ -0,0 +1,1362 @@
+#include "platform_native.h"
+#include "mpt_tree.h"
+#include "mpt_store.h"
+#include "sequencer.h"
+#include "merkle_crdt.h"
+#include "raft.h"
+#include "tee_cluster.h"
+#include "thread_pool.h"
+#include "platform_alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEST_MPT_KEYS 2000
+#define TEST_SORTED_KEYS 256
+#define TEST_PARALLEL_KEYS (MPT_PARALLEL_GRAIN * 4)
+#define TEST_PARALLEL_THREADS 4
+#define TEST_CURSOR_KEYS 200
+#define TEST_STORE_CACHE 16
+#define TEST_STORE_PATH "/tmp/native_test.store"
+#define TEST_BATCH_KEYS 4096
+#define TEST_SNAPSHOT_BYTES 65536
+#define TEST_MANY_COUNT 40
+#define TEST_DAG_OPS 64
+#define TEST_CLUSTER_OPS (DAG_NODES_INITIAL + 1)
+#define TEST_CLUSTER_TXS (TEE_CLUSTER_TXS_INITIAL * 4 + 1)
+
+#define TEST_CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return -1; \
+    } \
+} while (0)
+
+typedef struct {
+    size_t allocs;
+    size_t releases;
+} test_counting_t;
+
+static void* test_counting_alloc(void* ctx, size_t size) {
+    ((test_counting_t*)ctx)->allocs++;
+    return malloc(size);
+}
+
+static void test_counting_release(void* ctx, void* ptr) {
+    ((test_counting_t*)ctx)->releases++;
+    free(ptr);
+}
+
+static void test_to_hex(const uint8_t* hash, char* hex) {
+    for (size_t i = 0; i < 32; i++) {
+        snprintf(hex + 2 * i, 3, "%02x", hash[i]);
+    }
+}
+
+static int test_sha256(void) {
+    static const char* messages[] = {
+        "",
+        "abc",
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"
+    };
+    static const char* digests[] = {
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+        "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+        "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"
+    };
+    
+    platform_sha256_impl_t default_impl = platform_sha256_get_impl();
+    for (int impl = PLATFORM_SHA256_SCALAR; impl <= PLATFORM_SHA256_SHANI; impl++) {
+        if (platform_sha256_set_impl((platform_sha256_impl_t)impl) != 0) continue;
+        for (size_t v = 0; v < sizeof(messages) / sizeof(messages[0]); v++) {
+            uint8_t hash[32];
+            char hex[65];
+            platform_sha256((const uint8_t*)messages[v], strlen(messages[v]), hash);
+            test_to_hex(hash, hex);
+            TEST_CHECK(strcmp(hex, digests[v]) == 0);
+        }
+    }
+    platform_sha256_set_impl(default_impl);
+    
+    uint8_t data[TEST_MANY_COUNT * 96];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 13 + 5);
+    }
+    
+    const uint8_t* messages_many[TEST_MANY_COUNT];
+    size_t lens[TEST_MANY_COUNT];
+    uint8_t hashes[TEST_MANY_COUNT][32];
+    uint8_t* outputs[TEST_MANY_COUNT];
+    for (size_t i = 0; i < TEST_MANY_COUNT; i++) {
+        messages_many[i] = data + i * 96;
+        lens[i] = i * 2 + 1;
+        outputs[i] = hashes[i];
+    }
+    platform_sha256_many(messages_many, lens, outputs, TEST_MANY_COUNT);
+    
+    for (size_t i = 0; i < TEST_MANY_COUNT; i++) {
+        uint8_t expected[32];
+        platform_sha256(messages_many[i], lens[i], expected);
+        TEST_CHECK(memcmp(expected, hashes[i], 32) == 0);
+        
+        uint8_t streamed[32];
+        platform_sha256_ctx_t ctx;
+        platform_sha256_init(&ctx);
+        for (size_t off = 0; off < lens[i]; off += 7) {
+            size_t part = lens[i] - off < 7 ? lens[i] - off : 7;
+            platform_sha256_update(&ctx, messages_many[i] + off, part);
+        }
+        platform_sha256_final(&ctx, streamed);
+        TEST_CHECK(memcmp(expected, streamed, 32) == 0);
+    }
+    return 0;
+}
+
+static int test_random_and_clock(void) {
+    uint8_t first[64];
+    uint8_t second[64];
+    uint8_t zero[64] = {0};
+    TEST_CHECK(platform_get_random(first, sizeof(first)) == 0);
+    TEST_CHECK(platform_get_random(second, sizeof(second)) == 0);
+    TEST_CHECK(memcmp(first, second, sizeof(first)) != 0);
+    TEST_CHECK(memcmp(first, zero, sizeof(first)) != 0);
+    
+    uint8_t entropy[32];
+    TEST_CHECK(platform_get_entropy(entropy, sizeof(entropy)) == 0);
+    
+    uint64_t start = platform_time_ns();
+    uint64_t previous = start;
+    for (int i = 0; i < 1000; i++) {
+        uint64_t now = platform_time_ns();
+        TEST_CHECK(now >= previous);
+        previous = now;
+    }
+    TEST_CHECK(platform_time_ms() >= start / 1000000ull);
+    return 0;
+}
+
+static int test_allocator(void) {
+    test_counting_t counts = { 0, 0 };
+    platform_allocator_t counting = { test_counting_alloc, test_counting_release, &counts };
+    platform_allocator_t broken = { NULL, test_counting_release, NULL };
+    TEST_CHECK(platform_set_allocator(&broken) != 0);
+    TEST_CHECK(platform_set_allocator(&counting) == 0);
+    
+    mpt_tree_t tree;
+    TEST_CHECK(mpt_tree_init(&tree) == 0);
+    for (uint32_t i = 0; i < 100; i++) {
+        uint8_t key[8];
+        memcpy(key, &i, sizeof(i));
+        memcpy(key + 4, &i, sizeof(i));
+        TEST_CHECK(mpt_tree_insert(&tree, key, sizeof(key), key, sizeof(key)) == 0);
+    }
+    TEST_CHECK(mpt_tree_commit(&tree) == 0);
+    mpt_tree_destroy(&tree);
+    
+    platform_allocator_t current;
+    platform_get_allocator(&current);
+    TEST_CHECK(current.ctx == &counts);
+    TEST_CHECK(platform_set_allocator(NULL) == 0);
+    TEST_CHECK(counts.allocs > 0);
+    TEST_CHECK(counts.allocs == counts.releases);
+    return 0;
+}
+
+static int test_alloc_handles(void) {
+    platform_alloc_t system;
+    platform_alloc_t arena;
+    platform_alloc_t pool;
+    TEST_CHECK(platform_alloc_init_system(&system, "system") == 0);
+    TEST_CHECK(platform_alloc_init_arena(&arena, "arena", 4096) == 0);
+    TEST_CHECK(platform_alloc_init_pool(&pool, "pool", 40, 8) == 0);
+    
+    void* blocks[64];
+    for (size_t i = 0; i < 64; i++) {
+        blocks[i] = platform_alloc(&system, 100);
+        TEST_CHECK(blocks[i] != NULL);
+    }
+    TEST_CHECK(system.live_bytes == 6400 && system.peak_bytes == 6400);
+    for (size_t i = 0; i < 64; i++) {
+        platform_alloc_free(&system, blocks[i]);
+    }
+    TEST_CHECK(system.live_bytes == 0 && system.free_count == 64);
+    TEST_CHECK(platform_alloc_reset(&system) != 0);
+    
+    for (size_t i = 0; i < 64; i++) {
+        blocks[i] = platform_alloc(&arena, 100);
+        TEST_CHECK(blocks[i] != NULL && ((uintptr_t)blocks[i] % PLATFORM_ALLOC_ALIGN) == 0);
+        memset(blocks[i], (int)i, 100);
+    }
+    TEST_CHECK(platform_alloc(&arena, 10000) != NULL);
+    TEST_CHECK(arena.live_bytes == 64 * 112 + 10000);
+    TEST_CHECK(platform_alloc_reset(&arena) == 0);
+    TEST_CHECK(arena.live_bytes == 0 && arena.reserved_bytes == 4096);
+    
+    for (size_t i = 0; i < 20; i++) {
+        blocks[i] = platform_alloc(&pool, 40);
+        TEST_CHECK(blocks[i] != NULL);
+    }
+    TEST_CHECK(platform_alloc(&pool, 49) == NULL && pool.failed_count == 1);
+    platform_alloc_free(&pool, blocks[7]);
+    TEST_CHECK(platform_alloc(&pool, 8) == blocks[7]);
+    TEST_CHECK(pool.live_bytes == 20 * 48);
+    
+    platform_alloc_stats_t stats;
+    platform_alloc_get_stats(&pool, &stats);
+    TEST_CHECK(strcmp(stats.name, "pool") == 0 && stats.alloc_count == 21);
+    TEST_CHECK(stats.reserved_bytes >= 20 * 48);
+    
+    platform_alloc_destroy(&system);
+    platform_alloc_destroy(&arena);
+    platform_alloc_destroy(&pool);
+    return 0;
+}
+
+static void test_mpt_key(uint32_t i, uint8_t* key) {
+    uint8_t seed[4];
+    memcpy(seed, &i, sizeof(seed));
+    platform_sha256(seed, sizeof(seed), key);
+}
+
+static int test_mpt(void) {
+    mpt_tree_t tree;
+    mpt_tree_t replay;
+    TEST_CHECK(mpt_tree_init(&tree) == 0);
+    TEST_CHECK(mpt_tree_init(&replay) == 0);
+    
+    for (uint32_t i = 0; i < TEST_MPT_KEYS; i++) {
+        uint8_t key[32];
+        test_mpt_key(i, key);
+        TEST_CHECK(mpt_tree_insert(&tree, key, sizeof(key), key, 16) == 0);
+    }
+    for (uint32_t i = TEST_MPT_KEYS; i-- > 0;) {
+        uint8_t key[32];
+        test_mpt_key(i, key);
+        TEST_CHECK(mpt_tree_insert(&replay, key, sizeof(key), key, 16) == 0);
+    }
+    TEST_CHECK(mpt_tree_commit(&tree) == 0);
+    TEST_CHECK(mpt_tree_commit(&replay) == 0);
+    
+    uint8_t root[32];
+    uint8_t replay_root[32];
+    TEST_CHECK(mpt_tree_get_root_hash(&tree, root) == 0);
+    TEST_CHECK(mpt_tree_get_root_hash(&replay, replay_root) == 0);
+    TEST_CHECK(memcmp(root, replay_root, 32) == 0);
+    
+    for (uint32_t i = 0; i < TEST_MPT_KEYS; i += 97) {
+        uint8_t key[32];
+        uint8_t value[MPT_MAX_VALUE_LEN];
+        size_t value_len = sizeof(value);
+        test_mpt_key(i, key);
+        TEST_CHECK(mpt_tree_get(&tree, key, sizeof(key), value, &value_len) == 0);
+        TEST_CHECK(value_len == 16 && memcmp(value, key, 16) == 0);
+        
+        mpt_proof_t proof;
+        bool exists = false;
+        value_len = sizeof(value);
+        TEST_CHECK(mpt_tree_prove(&tree, key, sizeof(key), &proof) == 0);
+        int rc = mpt_tree_verify_proof(root, key, sizeof(key), &proof, &exists, value, &value_len);
+        mpt_proof_free(&proof);
+        TEST_CHECK(rc == 0 && exists);
+        TEST_CHECK(value_len == 16 && memcmp(value, key, 16) == 0);
+    }
+    
+    mpt_tree_destroy(&tree);
+    mpt_tree_destroy(&replay);
+    return 0;
+}
+
+static int test_multiproof_check(mpt_tree_t* tree, uint8_t (*keys)[32], mpt_kv_t* items) {
+    const uint8_t* key_ptrs[TEST_MANY_COUNT];
+    size_t key_lens[TEST_MANY_COUNT];
+    for (uint32_t i = 0; i < TEST_MANY_COUNT; i++) {
+        uint32_t index = (i & 1) ? TEST_MPT_KEYS + i : i * 37;
+        test_mpt_key(index, keys[i]);
+        key_ptrs[i] = keys[i];
+        key_lens[i] = 32;
+        items[i].key = keys[i];
+        items[i].key_len = 32;
+        items[i].value = (i & 1) ? NULL : keys[i];
+        items[i].value_len = (i & 1) ? 0 : 16;
+    }
+    
+    uint8_t root[32];
+    mpt_proof_t proof;
+    TEST_CHECK(mpt_tree_get_root_hash(tree, root) == 0);
+    TEST_CHECK(mpt_tree_prove_many(tree, key_ptrs, key_lens, TEST_MANY_COUNT, &proof) == 0);
+    
+    bool valid = mpt_tree_verify_multiproof(root, items, TEST_MANY_COUNT, &proof) == 0;
+    bool empty = mpt_tree_verify_multiproof(root, NULL, 0, &proof) == 0;
+    
+    uint8_t tampered[16];
+    memcpy(tampered, keys[0], sizeof(tampered));
+    tampered[15] ^= 1;
+    items[0].value = tampered;
+    bool bad_value = mpt_tree_verify_multiproof(root, items, TEST_MANY_COUNT, &proof) != 0;
+    items[0].value = keys[0];
+    
+    items[1].value = keys[1];
+    items[1].value_len = 16;
+    bool bad_absent = mpt_tree_verify_multiproof(root, items, TEST_MANY_COUNT, &proof) != 0;
+    items[1].value = NULL;
+    items[1].value_len = 0;
+    
+    root[0] ^= 1;
+    bool bad_root = mpt_tree_verify_multiproof(root, items, TEST_MANY_COUNT, &proof) != 0;
+    mpt_proof_free(&proof);
+    
+    TEST_CHECK(valid && empty);
+    TEST_CHECK(bad_value && bad_absent && bad_root);
+    return 0;
+}
+
+static int test_mpt_multiproof(void) {
+    mpt_tree_t tree;
+    TEST_CHECK(mpt_tree_init(&tree) == 0);
+    
+    int rc = 0;
+    for (uint32_t i = 0; i < TEST_MPT_KEYS && rc == 0; i++) {
+        uint8_t key[32];
+        test_mpt_key(i, key);
+        rc = mpt_tree_insert(&tree, key, sizeof(key), key, 16);
+    }
+    
+    uint8_t keys[TEST_MANY_COUNT][32];
+    mpt_kv_t items[TEST_MANY_COUNT];
+    if (rc == 0) rc = test_multiproof_check(&tree, keys, items);
+    
+    mpt_tree_destroy(&tree);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+static int test_sparse_proof(mpt_tree_t* tree) {
+    for (uint32_t i = 0; i < TEST_SORTED_KEYS; i++) {
+        uint8_t key[32];
+        test_mpt_key(i, key);
+        TEST_CHECK(mpt_tree_insert(tree, key, sizeof(key), key, 16) == 0);
+    }
+    
+    uint8_t root[32];
+    uint8_t key[32];
+    mpt_proof_t proof;
+    TEST_CHECK(mpt_tree_get_root_hash(tree, root) == 0);
+    test_mpt_key(7, key);
+    TEST_CHECK(mpt_tree_prove(tree, key, sizeof(key), &proof) == 0);
+    
+    bool exists = false;
+    uint8_t value[MPT_MAX_VALUE_LEN];
+    size_t value_len = sizeof(value);
+    bool valid = mpt_tree_verify_sparse_proof(root, key, sizeof(key), &proof,
+                                              &exists, value, &value_len) == 0 &&
+                 exists && value_len == 16 && memcmp(value, key, 16) == 0;
+    
+    root[0] ^= 1;
+    exists = false;
+    value_len = sizeof(value);
+    memset(value, 0xAA, sizeof(value));
+    bool rejected = mpt_tree_verify_sparse_proof(root, key, sizeof(key), &proof,
+                                                 &exists, value, &value_len) != 0;
+    bool untouched = !exists && value_len == sizeof(value) && value[0] == 0xAA;
+    mpt_proof_free(&proof);
+    
+    TEST_CHECK(valid && rejected && untouched);
+    return 0;
+}
+
+static int test_mpt_sparse(void) {
+    mpt_tree_t tree;
+    TEST_CHECK(mpt_tree_init_backend(&tree, MPT_BACKEND_SPARSE) == 0);
+    
+    int rc = test_sparse_proof(&tree);
+    
+    mpt_tree_destroy(&tree);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+static const uint32_t test_delete_keys[] = {
+    0x00001000, 0x00001001, 0x00002000, 0x00002100, 0x00002101, 0x12345678
+};
+
+#define TEST_DELETE_KEYS (sizeof(test_delete_keys) / sizeof(test_delete_keys[0]))
+
+static void test_delete_key(uint32_t i, uint8_t* key) {
+    if (i < TEST_DELETE_KEYS) {
+        memset(key, 0, 32);
+        key[0] = (uint8_t)(test_delete_keys[i] >> 24);
+        key[1] = (uint8_t)(test_delete_keys[i] >> 16);
+        key[2] = (uint8_t)(test_delete_keys[i] >> 8);
+        key[3] = (uint8_t)test_delete_keys[i];
+    } else {
+        test_mpt_key(i, key);
+    }
+}
+
+static int test_delete_root(const bool* deleted, uint32_t count, uint8_t* root) {
+    mpt_tree_t fresh;
+    TEST_CHECK(mpt_tree_init(&fresh) == 0);
+    
+    int rc = 0;
+    for (uint32_t i = 0; i < count && rc == 0; i++) {
+        uint8_t key[32];
+        test_delete_key(i, key);
+        if (!deleted[i]) rc = mpt_tree_insert(&fresh, key, sizeof(key), key, 8);
+    }
+    if (rc == 0) rc = mpt_tree_get_root_hash(&fresh, root);
+    
+    mpt_tree_destroy(&fresh);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+static int test_mpt_delete_keys(mpt_tree_t* tree, bool* deleted) {
+    for (uint32_t i = 0; i < TEST_MPT_KEYS; i++) {
+        uint8_t key[32];
+        test_delete_key(i, key);
+        TEST_CHECK(mpt_tree_insert(tree, key, sizeof(key), key, 8) == 0);
+    }
+    
+    uint8_t root[32];
+    uint8_t expected[32];
+    for (uint32_t i = TEST_DELETE_KEYS; i < TEST_MPT_KEYS; i += 3) {
+        uint8_t key[32];
+        test_delete_key(i, key);
+        TEST_CHECK(mpt_tree_delete(tree, key, sizeof(key)) == 0);
+        deleted[i] = true;
+    }
+    TEST_CHECK(mpt_tree_get_root_hash(tree, root) == 0);
+    TEST_CHECK(test_delete_root(deleted, TEST_MPT_KEYS, expected) == 0);
+    TEST_CHECK(memcmp(root, expected, 32) == 0);
+    
+    static const uint32_t order[] = { 2, 4, 0, 5, 3, 1 };
+    for (size_t step = 0; step < TEST_DELETE_KEYS; step++) {
+        uint8_t key[32];
+        test_delete_key(order[step], key);
+        TEST_CHECK(mpt_tree_delete(tree, key, sizeof(key)) == 0);
+        TEST_CHECK(mpt_tree_delete(tree, key, sizeof(key)) != 0);
+        deleted[order[step]] = true;
+        
+        TEST_CHECK(mpt_tree_get_root_hash(tree, root) == 0);
+        TEST_CHECK(test_delete_root(deleted, TEST_MPT_KEYS, expected) == 0);
+        TEST_CHECK(memcmp(root, expected, 32) == 0);
+    }
+    return 0;
+}
+
+static int test_mpt_delete(void) {
+    bool* deleted = (bool*)platform_malloc(TEST_MPT_KEYS * sizeof(bool));
+    TEST_CHECK(deleted != NULL);
+    memset(deleted, 0, TEST_MPT_KEYS * sizeof(bool));
+    
+    mpt_tree_t tree;
+    int rc = mpt_tree_init(&tree);
+    if (rc == 0) {
+        rc = test_mpt_delete_keys(&tree, deleted);
+        mpt_tree_destroy(&tree);
+    }
+    platform_free(deleted);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+static int test_parallel_round(mpt_tree_t* serial, mpt_tree_t* parallel, uint32_t round) {
+    for (uint32_t i = 0; i < TEST_PARALLEL_KEYS; i += round + 1) {
+        uint8_t key[32];
+        uint8_t value[20];
+        test_mpt_key(i, key);
+        memcpy(value, key, 16);
+        memcpy(value + 16, &round, sizeof(round));
+        TEST_CHECK(mpt_tree_insert(serial, key, sizeof(key), value, sizeof(value)) == 0);
+        TEST_CHECK(mpt_tree_insert(parallel, key, sizeof(key), value, sizeof(value)) == 0);
+    }
+    
+    uint8_t serial_root[32];
+    uint8_t parallel_root[32];
+    TEST_CHECK(mpt_tree_commit(serial) == 0 && mpt_tree_commit(parallel) == 0);
+    TEST_CHECK(mpt_tree_get_root_hash(serial, serial_root) == 0);
+    TEST_CHECK(mpt_tree_get_root_hash(parallel, parallel_root) == 0);
+    TEST_CHECK(memcmp(serial_root, parallel_root, 32) == 0);
+    return 0;
+}
+
+static int test_mpt_parallel(void) {
+    mpt_tree_t serial;
+    mpt_tree_t parallel;
+    TEST_CHECK(mpt_tree_init(&serial) == 0);
+    TEST_CHECK(mpt_tree_init(&parallel) == 0);
+    
+    thread_pool_t pool;
+    bool pooled = thread_pool_init(&pool, TEST_PARALLEL_THREADS) == 0;
+    int rc = pooled ? 0 : -1;
+    if (pooled) mpt_tree_set_thread_pool(&parallel, &pool);
+    for (uint32_t round = 0; round < 3 && rc == 0; round++) {
+        rc = test_parallel_round(&serial, &parallel, round);
+    }
+    
+    mpt_tree_destroy(&serial);
+    mpt_tree_destroy(&parallel);
+    if (pooled) thread_pool_destroy(&pool);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+static int test_sequencer(void) {
+    sequencer_state_t* state = (sequencer_state_t*)platform_malloc(sizeof(sequencer_state_t));
+    TEST_CHECK(state != NULL);
+    if (sequencer_init(state) != 0) {
+        platform_free(state);
+        TEST_CHECK(false);
+    }
+    
+    uint8_t token[MAX_TOKEN_ADDRESS_LEN];
+    memset(token, 0x42, sizeof(token));
+    
+    int rc = 0;
+    for (uint8_t i = 1; i <= 16 && rc == 0; i++) {
+        log_entry_t log;
+        memset(&log, 0, sizeof(log));
+        log.timestamp = i;
+        log.type = LOG_MINT;
+        memcpy(log.token_address, token, sizeof(token));
+        memset(log.to, i, sizeof(log.to));
+        log.amount[31] = i;
+        log.signature[0] = 1;
+        rc = sequencer_add_log(state, &log);
+    }
+    if (rc == 0) rc = sequencer_process_logs(state);
+    
+    for (uint8_t i = 1; i <= 16 && rc == 0; i++) {
+        uint8_t account[20];
+        uint8_t balance[32];
+        memset(account, i, sizeof(account));
+        rc = sequencer_get_balance(state, token, account, balance);
+        if (rc == 0 && balance[31] != i) rc = -1;
+    }
+    
+    mpt_rcu_destroy(&state->rcu);
+    mpt_state_destroy(&state->token_state);
+    platform_free(state);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+static void test_be32(uint32_t i, uint8_t* key) {
+    key[0] = (uint8_t)(i >> 24);
+    key[1] = (uint8_t)(i >> 16);
+    key[2] = (uint8_t)(i >> 8);
+    key[3] = (uint8_t)i;
+}
+
+static uint32_t test_read_be32(const uint8_t* key) {
+    return ((uint32_t)key[0] << 24) | ((uint32_t)key[1] << 16) | ((uint32_t)key[2] << 8) | key[3];
+}
+
+static int test_cursor_scan(mpt_tree_t* tree) {
+    mpt_cursor_t cursor;
+    const uint8_t* key;
+    const uint8_t* value;
+    size_t key_len;
+    size_t value_len;
+    
+    TEST_CHECK(mpt_cursor_open(&cursor, tree, NULL, 0) == 0);
+    uint32_t seen = 0;
+    int rc;
+    while ((rc = mpt_cursor_next(&cursor, &key, &key_len, &value, &value_len)) == 0) {
+        TEST_CHECK(key_len == 4 && test_read_be32(key) == seen * 2);
+        TEST_CHECK(value_len == 4 && memcmp(value, key, 4) == 0);
+        seen++;
+    }
+    mpt_cursor_close(&cursor);
+    TEST_CHECK(rc == MPT_CURSOR_END && seen == TEST_CURSOR_KEYS);
+    
+    uint8_t start[4];
+    test_be32(101, start);
+    TEST_CHECK(mpt_cursor_open(&cursor, tree, start, sizeof(start)) == 0);
+    rc = mpt_cursor_next(&cursor, &key, &key_len, &value, &value_len);
+    mpt_cursor_close(&cursor);
+    TEST_CHECK(rc == 0 && key_len == 4 && test_read_be32(key) == 102);
+    
+    test_be32(TEST_CURSOR_KEYS * 2, start);
+    TEST_CHECK(mpt_cursor_open(&cursor, tree, start, sizeof(start)) == 0);
+    rc = mpt_cursor_next(&cursor, &key, &key_len, &value, &value_len);
+    mpt_cursor_close(&cursor);
+    TEST_CHECK(rc == MPT_CURSOR_END);
+    return 0;
+}
+
+static int test_mpt_cursor(void) {
+    mpt_tree_t tree;
+    TEST_CHECK(mpt_tree_init(&tree) == 0);
+    
+    mpt_cursor_t cursor;
+    const uint8_t* key;
+    const uint8_t* value;
+    size_t key_len;
+    size_t value_len;
+    int rc = mpt_cursor_open(&cursor, &tree, NULL, 0);
+    if (rc == 0) rc = mpt_cursor_next(&cursor, &key, &key_len, &value, &value_len);
+    mpt_cursor_close(&cursor);
+    bool empty_ok = (rc == MPT_CURSOR_END);
+    
+    rc = 0;
+    for (uint32_t i = TEST_CURSOR_KEYS; i-- > 0 && rc == 0;) {
+        uint8_t k[4];
+        test_be32(i * 2, k);
+        rc = mpt_tree_insert(&tree, k, sizeof(k), k, sizeof(k));
+    }
+    if (rc == 0) rc = test_cursor_scan(&tree);
+    
+    mpt_tree_destroy(&tree);
+    TEST_CHECK(empty_ok && rc == 0);
+    return 0;
+}
+
+static int test_mpt_snapshot_reset(void) {
+    mpt_tree_t tree;
+    TEST_CHECK(mpt_tree_init(&tree) == 0);
+    
+    uint8_t keys[TEST_SORTED_KEYS][4];
+    uint8_t values[TEST_SORTED_KEYS][4];
+    mpt_kv_t items[TEST_SORTED_KEYS];
+    for (uint32_t i = 0; i < TEST_SORTED_KEYS; i++) {
+        for (size_t b = 0; b < 4; b++) {
+            keys[i][b] = (uint8_t)(i >> (24 - 8 * b));
+            values[i][b] = (uint8_t)~keys[i][b];
+        }
+        items[i].key = keys[i];
+        items[i].key_len = sizeof(keys[i]);
+        items[i].value = values[i];
+        items[i].value_len = sizeof(values[i]);
+    }
+    
+    int rc = 0;
+    for (uint32_t i = 0; i < TEST_SORTED_KEYS && rc == 0; i++) {
+        rc = mpt_tree_insert(&tree, keys[i], sizeof(keys[i]), keys[i], sizeof(keys[i]));
+    }
+    uint8_t before_root[32];
+    if (rc == 0) rc = mpt_tree_get_root_hash(&tree, before_root);
+    
+    mpt_snapshot_t before;
+    if (rc == 0) rc = mpt_tree_snapshot(&tree, &before);
+    if (rc == 0) rc = mpt_tree_build_sorted(&tree, items, TEST_SORTED_KEYS / 2);
+    
+    bool snapshot_intact = (rc == 0);
+    for (uint32_t i = 0; i < TEST_SORTED_KEYS && snapshot_intact; i++) {
+        uint8_t value[MPT_MAX_VALUE_LEN];
+        size_t value_len = sizeof(value);
+        snapshot_intact = mpt_tree_snapshot_get(&tree, &before, keys[i], sizeof(keys[i]),
+                                                value, &value_len) == 0 &&
+                          value_len == sizeof(keys[i]) && memcmp(value, keys[i], value_len) == 0;
+    }
+    
+    uint8_t value[MPT_MAX_VALUE_LEN];
+    size_t value_len = sizeof(value);
+    bool rebuilt = rc == 0 && tree.size == TEST_SORTED_KEYS / 2 &&
+                   mpt_tree_get(&tree, keys[1], sizeof(keys[1]), value, &value_len) == 0 &&
+                   memcmp(value, values[1], sizeof(values[1])) == 0;
+    
+    uint8_t rolled_root[32];
+    bool rolled_back = rc == 0 && mpt_tree_rollback(&tree, &before) == 0 &&
+                       mpt_tree_get_root_hash(&tree, rolled_root) == 0 &&
+                       memcmp(rolled_root, before_root, 32) == 0;
+    mpt_tree_snapshot_release(&tree, &before);
+    
+    mpt_tree_reset(&tree);
+    bool reclaimed = tree.arena.bytes_in_use == 0 && tree.arena.slab_count <= 1;
+    
+    mpt_tree_destroy(&tree);
+    TEST_CHECK(rc == 0);
+    TEST_CHECK(snapshot_intact && rebuilt && rolled_back && reclaimed);
+    return 0;
+}
+
+static int test_mpt_batch_fail(mpt_tree_t* tree, mpt_kv_t* items, uint8_t (*keys)[4]) {
+    for (uint32_t i = 0; i < TEST_BATCH_KEYS; i++) {
+        test_be32(i, keys[i]);
+        items[i].key = keys[i];
+        items[i].key_len = sizeof(keys[i]);
+        items[i].value = keys[i];
+        items[i].value_len = sizeof(keys[i]);
+    }
+    TEST_CHECK(mpt_tree_insert_batch(tree, items, TEST_SORTED_KEYS) == 0);
+    
+    uint8_t before[32];
+    uint8_t after[32];
+    TEST_CHECK(mpt_tree_get_root_hash(tree, before) == 0);
+    
+    platform_alloc_t pool;
+    TEST_CHECK(platform_alloc_init_pool(&pool, "tiny", 64, 8) == 0);
+    platform_alloc_t* backing = tree->arena.backing;
+    tree->arena.backing = &pool;
+    int rc = mpt_tree_insert_batch(tree, items, TEST_BATCH_KEYS);
+    tree->arena.backing = backing;
+    platform_alloc_destroy(&pool);
+    TEST_CHECK(rc != 0);
+    
+    TEST_CHECK(mpt_tree_get_root_hash(tree, after) == 0);
+    TEST_CHECK(memcmp(before, after, 32) == 0 && tree->size == TEST_SORTED_KEYS);
+    for (uint32_t i = 0; i < TEST_SORTED_KEYS; i++) {
+        uint8_t value[MPT_MAX_VALUE_LEN];
+        size_t value_len = sizeof(value);
+        TEST_CHECK(mpt_tree_get(tree, keys[i], sizeof(keys[i]), value, &value_len) == 0);
+        TEST_CHECK(value_len == 4 && memcmp(value, keys[i], 4) == 0);
+    }
+    
+    TEST_CHECK(mpt_tree_insert_batch(tree, items, TEST_BATCH_KEYS) == 0);
+    TEST_CHECK(tree->size == TEST_BATCH_KEYS);
+    return 0;
+}
+
+static int test_mpt_batch(void) {
+    mpt_kv_t* items = (mpt_kv_t*)platform_malloc(TEST_BATCH_KEYS * sizeof(mpt_kv_t));
+    uint8_t (*keys)[4] = (uint8_t (*)[4])platform_malloc(TEST_BATCH_KEYS * 4);
+    mpt_tree_t tree;
+    int rc = (items != NULL && keys != NULL) ? mpt_tree_init(&tree) : -1;
+    if (rc == 0) {
+        rc = test_mpt_batch_fail(&tree, items, keys);
+        mpt_tree_destroy(&tree);
+    }
+    platform_free(items);
+    platform_free(keys);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+typedef struct {
+    uint8_t data[TEST_SNAPSHOT_BYTES];
+    size_t len;
+    size_t pos;
+} test_stream_t;
+
+static int test_stream_write(void* ctx, const uint8_t* data, size_t len) {
+    test_stream_t* stream = (test_stream_t*)ctx;
+    if (stream->len + len > sizeof(stream->data)) return -1;
+    memcpy(stream->data + stream->len, data, len);
+    stream->len += len;
+    return 0;
+}
+
+static int test_stream_read(void* ctx, uint8_t* data, size_t len) {
+    test_stream_t* stream = (test_stream_t*)ctx;
+    if (stream->pos + len > stream->len) return -1;
+    memcpy(data, stream->data + stream->pos, len);
+    stream->pos += len;
+    return 0;
+}
+
+static void test_stream_record(test_stream_t* stream, const uint8_t* data, size_t len, uint8_t* hash) {
+    uint8_t header[2] = { (uint8_t)(len & 0xFF), (uint8_t)(len >> 8) };
+    test_stream_write(stream, header, sizeof(header));
+    test_stream_write(stream, data, len);
+    platform_sha256(data, len, hash);
+}
+
+static void test_stream_trailer(test_stream_t* stream, const uint8_t* root, uint64_t size) {
+    uint8_t trailer[2 + 32 + 8];
+    memset(trailer, 0, sizeof(trailer));
+    memcpy(trailer + 2, root, 32);
+    for (size_t i = 0; i < 8; i++) trailer[2 + 32 + i] = (uint8_t)(size >> (8 * i));
+    test_stream_write(stream, trailer, sizeof(trailer));
+}
+
+static void test_deep_snapshot(test_stream_t* stream) {
+    uint8_t leaf[2 + 64 + 3];
+    uint8_t hashes[2][32];
+    memset(leaf, 0, sizeof(leaf));
+    leaf[0] = MPT_NODE_LEAF;
+    leaf[1] = MPT_MAX_PATH_LEN - 1;
+    leaf[2 + 64] = 1;
+    for (uint8_t i = 0; i < 2; i++) {
+        leaf[2 + 64 + 2] = i;
+        test_stream_record(stream, leaf, sizeof(leaf), hashes[i]);
+    }
+    
+    uint8_t branch[3 + 64 + 1];
+    uint8_t branch_hash[32];
+    memset(branch, 0, sizeof(branch));
+    branch[0] = MPT_NODE_BRANCH;
+    branch[1] = 0x03;
+    memcpy(branch + 3, hashes, sizeof(hashes));
+    test_stream_record(stream, branch, sizeof(branch), branch_hash);
+    
+    uint8_t ext[3 + 32];
+    uint8_t root[32];
+    ext[0] = MPT_NODE_EXTENSION;
+    ext[1] = 2;
+    ext[2] = 0;
+    memcpy(ext + 3, branch_hash, sizeof(branch_hash));
+    test_stream_record(stream, ext, sizeof(ext), root);
+    test_stream_trailer(stream, root, 2);
+}
+
+static void test_odd_snapshot(test_stream_t* stream) {
+    uint8_t leaf[] = { MPT_NODE_LEAF, 1, 0x10, 1, 0, 0x42 };
+    uint8_t root[32];
+    test_stream_record(stream, leaf, sizeof(leaf), root);
+    test_stream_trailer(stream, root, 1);
+}
+
+static int test_import_rejected(mpt_tree_t* tree, void (*build)(test_stream_t*)) {
+    test_stream_t* stream = (test_stream_t*)platform_malloc(sizeof(test_stream_t));
+    TEST_CHECK(stream != NULL);
+    stream->len = 0;
+    stream->pos = 0;
+    test_stream_write(stream, (const uint8_t*)MPT_SNAPSHOT_MAGIC, 8);
+    build(stream);
+    
+    uint8_t before[32];
+    uint8_t after[32];
+    size_t size = tree->size;
+    int rc = mpt_tree_get_root_hash(tree, before);
+    bool rejected = rc == 0 && mpt_tree_import(tree, test_stream_read, stream) != 0;
+    platform_free(stream);
+    TEST_CHECK(rejected);
+    TEST_CHECK(mpt_tree_get_root_hash(tree, after) == 0);
+    TEST_CHECK(memcmp(before, after, 32) == 0 && tree->size == size);
+    return 0;
+}
+
+static int test_mpt_import_into(mpt_tree_t* tree, mpt_tree_t* live, test_stream_t* stream) {
+    for (uint32_t i = 0; i < TEST_SORTED_KEYS; i++) {
+        uint8_t key[4];
+        test_be32(i, key);
+        TEST_CHECK(mpt_tree_insert(tree, key, sizeof(key), key, sizeof(key)) == 0);
+        test_be32(i * 2 + 1, key);
+        TEST_CHECK(mpt_tree_insert(live, key, sizeof(key), key, sizeof(key)) == 0);
+    }
+    TEST_CHECK(mpt_tree_export(tree, test_stream_write, stream) == 0);
+    
+    TEST_CHECK(test_import_rejected(live, test_deep_snapshot) == 0);
+    TEST_CHECK(test_import_rejected(live, test_odd_snapshot) == 0);
+    
+    uint8_t key[4];
+    uint8_t value[MPT_MAX_VALUE_LEN];
+    size_t value_len = sizeof(value);
+    test_be32(1, key);
+    TEST_CHECK(mpt_tree_get(live, key, sizeof(key), value, &value_len) == 0);
+    
+    uint8_t root[32];
+    uint8_t imported[32];
+    TEST_CHECK(mpt_tree_import(live, test_stream_read, stream) == 0);
+    TEST_CHECK(mpt_tree_get_root_hash(tree, root) == 0);
+    TEST_CHECK(mpt_tree_get_root_hash(live, imported) == 0);
+    TEST_CHECK(memcmp(root, imported, 32) == 0 && live->size == TEST_SORTED_KEYS);
+    return 0;
+}
+
+static int test_mpt_import(void) {
+    test_stream_t* stream = (test_stream_t*)platform_malloc(sizeof(test_stream_t));
+    TEST_CHECK(stream != NULL);
+    stream->len = 0;
+    stream->pos = 0;
+    
+    mpt_tree_t tree;
+    mpt_tree_t live;
+    int rc = mpt_tree_init(&tree);
+    if (rc == 0) {
+        rc = mpt_tree_init(&live);
+        if (rc == 0) {
+            rc = test_mpt_import_into(&tree, &live, stream);
+            mpt_tree_destroy(&live);
+        }
+        mpt_tree_destroy(&tree);
+    }
+    platform_free(stream);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+static int test_mpt_store_fill(mpt_store_t* store, uint8_t* root) {
+    mpt_tree_t tree;
+    TEST_CHECK(mpt_tree_open(&tree, store, TEST_STORE_CACHE) == 0);
+    
+    int rc = 0;
+    for (uint32_t i = 0; i < TEST_MPT_KEYS && rc == 0; i++) {
+        uint8_t key[32];
+        test_mpt_key(i, key);
+        rc = mpt_tree_insert(&tree, key, sizeof(key), key, 16);
+    }
+    if (rc == 0) rc = mpt_tree_commit(&tree);
+    if (rc == 0) rc = mpt_tree_get_root_hash(&tree, root);
+    
+    mpt_tree_destroy(&tree);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+static int test_mpt_store_check(mpt_store_t* store, const uint8_t* root) {
+    mpt_tree_t tree;
+    TEST_CHECK(mpt_tree_open(&tree, store, TEST_STORE_CACHE) == 0);
+    
+    uint8_t reopened[32];
+    bool same_root = mpt_tree_get_root_hash(&tree, reopened) == 0 &&
+                     memcmp(reopened, root, 32) == 0 && tree.size == TEST_MPT_KEYS;
+    
+    bool found = true;
+    for (uint32_t i = 0; i < TEST_MPT_KEYS + 16 && found; i++) {
+        uint8_t key[32];
+        uint8_t value[MPT_MAX_VALUE_LEN];
+        size_t value_len = sizeof(value);
+        test_mpt_key(i, key);
+        int rc = mpt_tree_get(&tree, key, sizeof(key), value, &value_len);
+        if (i < TEST_MPT_KEYS) {
+            found = rc == 0 && value_len == 16 && memcmp(value, key, 16) == 0;
+        } else {
+            found = rc != 0;
+        }
+    }
+    bool bounded = tree.cache.count <= TEST_STORE_CACHE + MPT_PROOF_MAX_DEPTH;
+    
+    mpt_snapshot_t snapshot;
+    bool refused = mpt_tree_snapshot(&tree, &snapshot) == 0 && mpt_tree_compact(&tree) != 0;
+    mpt_tree_snapshot_release(&tree, &snapshot);
+    bool compacted = mpt_tree_compact(&tree) == 0 &&
+                     mpt_tree_get_root_hash(&tree, reopened) == 0 &&
+                     memcmp(reopened, root, 32) == 0;
+    
+    mpt_tree_destroy(&tree);
+    TEST_CHECK(same_root && found && bounded);
+    TEST_CHECK(refused && compacted);
+    return 0;
+}
+
+static int test_mpt_store(void) {
+    mpt_store_t store;
+    uint8_t root[32];
+    unlink(TEST_STORE_PATH);
+    TEST_CHECK(mpt_store_open(&store, TEST_STORE_PATH) == 0);
+    int rc = test_mpt_store_fill(&store, root);
+    mpt_store_close(&store);
+    
+    if (rc == 0) {
+        rc = mpt_store_open(&store, TEST_STORE_PATH);
+        if (rc == 0) {
+            rc = test_mpt_store_check(&store, root);
+            mpt_store_close(&store);
+        }
+    }
+    unlink(TEST_STORE_PATH);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+static int test_snapshot_values(mpt_tree_t* tree, const mpt_snapshot_t* snapshot) {
+    for (uint32_t i = 0; i <= TEST_SORTED_KEYS; i++) {
+        uint8_t key[4];
+        uint8_t value[MPT_MAX_VALUE_LEN];
+        size_t value_len = sizeof(value);
+        size_t key_len = (i < TEST_SORTED_KEYS) ? sizeof(key) : 2;
+        test_be32(i, key);
+        if (i == TEST_SORTED_KEYS) memset(key, 0, sizeof(key));
+        
+        int rc = snapshot ? mpt_tree_snapshot_get(tree, snapshot, key, key_len, value, &value_len)
+                          : mpt_tree_get(tree, key, key_len, value, &value_len);
+        TEST_CHECK(rc == 0 && value_len == key_len && memcmp(value, key, key_len) == 0);
+    }
+    return 0;
+}
+
+static int test_mpt_snapshot_delete_keys(mpt_tree_t* tree) {
+    uint8_t key[4];
+    for (uint32_t i = 0; i < TEST_SORTED_KEYS; i++) {
+        test_be32(i, key);
+        TEST_CHECK(mpt_tree_insert(tree, key, sizeof(key), key, sizeof(key)) == 0);
+    }
+    memset(key, 0, sizeof(key));
+    TEST_CHECK(mpt_tree_insert(tree, key, 2, key, 2) == 0);
+    
+    uint8_t before_root[32];
+    uint8_t root[32];
+    TEST_CHECK(mpt_tree_get_root_hash(tree, before_root) == 0);
+    
+    mpt_snapshot_t before;
+    TEST_CHECK(mpt_tree_snapshot(tree, &before) == 0);
+    int rc = 0;
+    for (uint32_t i = 0; i < TEST_SORTED_KEYS && rc == 0; i++) {
+        test_be32(i, key);
+        rc = mpt_tree_delete(tree, key, sizeof(key));
+    }
+    bool deleted = rc == 0 && tree->size == 1 && mpt_tree_get_root_hash(tree, root) == 0 &&
+                   memcmp(root, before_root, 32) != 0;
+    bool snapshot_intact = test_snapshot_values(tree, &before) == 0;
+    
+    bool rolled_back = mpt_tree_rollback(tree, &before) == 0 &&
+                       mpt_tree_get_root_hash(tree, root) == 0 &&
+                       memcmp(root, before_root, 32) == 0;
+    bool values_intact = test_snapshot_values(tree, &before) == 0 &&
+                         test_snapshot_values(tree, NULL) == 0;
+    mpt_tree_snapshot_release(tree, &before);
+    
+    TEST_CHECK(deleted && snapshot_intact);
+    TEST_CHECK(rolled_back && values_intact);
+    return 0;
+}
+
+static int test_mpt_snapshot_delete(void) {
+    mpt_tree_t tree;
+    TEST_CHECK(mpt_tree_init(&tree) == 0);
+    
+    int rc = test_mpt_snapshot_delete_keys(&tree);
+    
+    mpt_tree_destroy(&tree);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+static void test_dag_op(uint64_t i, operation_t* op) {
+    memset(op, 0, sizeof(operation_t));
+    op->operation_id = i + 1;
+    op->tx_id = i / 4 + 1;
+    op->timestamp = i;
+    op->type = (i % 3 == 0) ? OP_SUBTRACT : OP_ADD;
+    memset(op->token_address, 0x10 + (int)(i % 2), sizeof(op->token_address));
+    memset(op->account, (int)(i % 8), sizeof(op->account));
+    op->amount[31] = (uint8_t)i;
+    op->is_valid = true;
+}
+
+static int test_dag_root(platform_alloc_t* node_alloc, platform_alloc_t* index_alloc, uint8_t* root) {
+    merkle_crdt_dag_t* dag = (merkle_crdt_dag_t*)platform_malloc(sizeof(merkle_crdt_dag_t));
+    TEST_CHECK(dag != NULL);
+    
+    int rc = merkle_crdt_init_alloc(dag, node_alloc, index_alloc);
+    for (uint64_t i = 0; i < TEST_DAG_OPS && rc == 0; i++) {
+        operation_t op;
+        test_dag_op(i, &op);
+        rc = merkle_crdt_add_operation(dag, &op, i);
+    }
+    if (rc == 0) rc = merkle_crdt_compute_dag_root_hash(dag, root);
+    
+    merkle_crdt_destroy(dag);
+    platform_free(dag);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+static int test_dag(void) {
+    uint8_t first[32];
+    uint8_t second[32];
+    uint8_t zero[32] = {0};
+    platform_alloc_t nodes;
+    platform_alloc_t index;
+    TEST_CHECK(platform_alloc_init_pool(&nodes, "dag_nodes", sizeof(dag_node_t), 0) == 0);
+    TEST_CHECK(platform_alloc_init_pool(&index, "dag_conflict_index", sizeof(conflict_index_entry_t), 0) == 0);
+    
+    TEST_CHECK(test_dag_root(NULL, NULL, first) == 0);
+    TEST_CHECK(test_dag_root(&nodes, &index, second) == 0);
+    TEST_CHECK(memcmp(first, second, 32) == 0);
+    TEST_CHECK(memcmp(first, zero, 32) != 0);
+    TEST_CHECK(nodes.alloc_count == TEST_DAG_OPS + 1 && nodes.live_bytes == 0);
+    TEST_CHECK(index.alloc_count > 0 && index.reset_count == 1);
+    
+    platform_alloc_destroy(&nodes);
+    platform_alloc_destroy(&index);
+    return 0;
+}
+
+static int test_containers(void) {
+    uint64_t* items = NULL;
+    size_t capacity = 0;
+    TEST_CHECK(platform_array_reserve((void**)&items, &capacity, 3, sizeof(uint64_t), 4, 100) == 0);
+    TEST_CHECK(capacity == 4 && items[3] == 0);
+    items[0] = 42;
+    TEST_CHECK(platform_array_reserve((void**)&items, &capacity, 70, sizeof(uint64_t), 4, 100) == 0);
+    TEST_CHECK(capacity == 100 && items[0] == 42 && items[99] == 0);
+    TEST_CHECK(platform_array_reserve((void**)&items, &capacity, 101, sizeof(uint64_t), 4, 100) != 0);
+    TEST_CHECK(platform_array_reserve((void**)&items, &capacity, 50, sizeof(uint64_t), 4, 10) != 0);
+    platform_free(items);
+    
+    raft_state_t* raft = (raft_state_t*)platform_malloc(sizeof(raft_state_t));
+    TEST_CHECK(raft != NULL);
+    TEST_CHECK(raft_init(raft, 1) == 0);
+    TEST_CHECK(raft->log == NULL && raft->log_capacity == 0);
+    raft->role = RAFT_LEADER;
+    
+    int rc = raft_set_log_limit(raft, 100);
+    raft_log_entry_t entry;
+    memset(&entry, 0, sizeof(entry));
+    for (uint64_t i = 0; i < 100 && rc == 0; i++) {
+        entry.tx_id = i;
+        rc = raft_append_entry(raft, &entry);
+    }
+    bool full = rc == 0 && raft_append_entry(raft, &entry) != 0;
+    bool kept = rc == 0 && raft->log_size == 100 && raft->log[99].tx_id == 99;
+    bool shrink = raft_set_log_limit(raft, 50) != 0;
+    
+    raft_destroy(raft);
+    platform_free(raft);
+    TEST_CHECK(full && kept && shrink);
+    return 0;
+}
+
+static int test_raft_election(void) {
+    raft_state_t* raft = (raft_state_t*)platform_malloc(sizeof(raft_state_t));
+    TEST_CHECK(raft != NULL);
+    TEST_CHECK(raft_init(raft, 1) == 0);
+    TEST_CHECK(raft_add_peer(raft, 2) == 0 && raft_add_peer(raft, 3) == 0 && raft_add_peer(raft, 4) == 0);
+    raft->last_heartbeat = 0;
+    TEST_CHECK(raft_tick(raft) == 0);
+    bool candidate = raft->role == RAFT_CANDIDATE;
+    
+    raft_message_t* vote = (raft_message_t*)platform_malloc(sizeof(raft_message_t));
+    TEST_CHECK(vote != NULL);
+    memset(vote, 0, sizeof(raft_message_t));
+    vote->type = RAFT_MSG_REQUEST_VOTE_RESPONSE;
+    vote->to_node_id = 1;
+    vote->vote_granted = true;
+    vote->from_node_id = 2;
+    vote->term = raft->current_term - 1;
+    bool stale = raft_process_message(raft, vote) == 0 && raft->role == RAFT_CANDIDATE;
+    vote->term = raft->current_term;
+    vote->from_node_id = 9;
+    bool unknown = raft_process_message(raft, vote) != 0 && raft->role == RAFT_CANDIDATE;
+    vote->from_node_id = 2;
+    bool single = raft_process_message(raft, vote) == 0 && raft_process_message(raft, vote) == 0 &&
+                  raft->role == RAFT_CANDIDATE;
+    vote->from_node_id = 3;
+    bool won = raft_process_message(raft, vote) == 0 && raft_is_leader(raft) &&
+               raft_get_leader(raft) == 1 && raft->peers[2].next_index == raft->log_size + 1;
+    raft_destroy(raft);
+    
+    TEST_CHECK(raft_init(raft, 5) == 0);
+    raft->last_heartbeat = 0;
+    bool alone = raft_tick(raft) == 0 && raft_is_leader(raft);
+    raft_destroy(raft);
+    platform_free(vote);
+    platform_free(raft);
+    TEST_CHECK(candidate && stale && unknown && single && won && alone);
+    return 0;
+}
+
+static int test_cluster_dag(tee_cluster_state_t* cluster) {
+    merkle_crdt_dag_t* dag = &cluster->global_dag;
+    for (uint64_t i = 0; i < TEST_CLUSTER_OPS; i++) {
+        operation_t op;
+        test_dag_op(i, &op);
+        TEST_CHECK(merkle_crdt_add_operation(dag, &op, i) == 0);
+    }
+    TEST_CHECK(dag->node_capacity >= TEST_CLUSTER_OPS && dag->latest_count == TEST_CLUSTER_OPS);
+    
+    for (uint64_t i = 0; i < TEST_CLUSTER_OPS; i++) {
+        TEST_CHECK(tee_cluster_broadcast_dag_node(cluster, 0, dag->nodes[i]->node_id) == 0);
+    }
+    TEST_CHECK(dag->latest_count == 2 * TEST_CLUSTER_OPS);
+    TEST_CHECK(dag->latest_capacity >= dag->latest_count);
+    TEST_CHECK(dag->latest_nodes[dag->latest_count - 1] == dag->nodes[TEST_CLUSTER_OPS - 1]);
+    
+    operation_t extra;
+    test_dag_op(TEST_CLUSTER_OPS, &extra);
+    TEST_CHECK(merkle_crdt_set_node_limit(dag, TEST_CLUSTER_OPS - 1) != 0);
+    TEST_CHECK(merkle_crdt_set_node_limit(dag, TEST_CLUSTER_OPS) == 0);
+    TEST_CHECK(merkle_crdt_add_operation(dag, &extra, TEST_CLUSTER_OPS) != 0);
+    return 0;
+}
+
+static int test_cluster_txs(tee_cluster_state_t* cluster) {
+    tx_sort_info_t* sort_info = (tx_sort_info_t*)platform_malloc(TEST_CLUSTER_TXS * sizeof(tx_sort_info_t));
+    TEST_CHECK(sort_info != NULL);
+    
+    int rc = 0;
+    for (uint64_t i = 0; i < TEST_CLUSTER_TXS && rc == 0; i++) {
+        tx_request_t tx;
+        memset(&tx, 0, sizeof(tx));
+        tx.tx_id = i + 1;
+        rc = tee_cluster_add_tx_request(cluster, &tx);
+        sort_info[i].tx_id = i + 1;
+        sort_info[i].sort_order = TEST_CLUSTER_TXS - i;
+        sort_info[i].sort_timestamp = i;
+        if (rc == 0) rc = tee_cluster_add_executed_tx(cluster, i + 1, 1, i, 0);
+    }
+    if (rc == 0) rc = tee_cluster_set_tx_sort_info(cluster, sort_info, TEST_CLUSTER_TXS);
+    platform_free(sort_info);
+    TEST_CHECK(rc == 0);
+    
+    uint64_t order = 0;
+    TEST_CHECK(cluster->pending_count == TEST_CLUSTER_TXS && cluster->executed_count == TEST_CLUSTER_TXS);
+    TEST_CHECK(cluster->tx_sort_count == TEST_CLUSTER_TXS);
+    TEST_CHECK(cluster->pending_txs[TEST_CLUSTER_TXS - 1].tx_id == TEST_CLUSTER_TXS);
+    TEST_CHECK(tee_cluster_get_tx_sort_order(cluster, TEST_CLUSTER_TXS, &order) == 0 && order == 1);
+    
+    uint8_t signature[64];
+    cluster->raft.role = RAFT_LEADER;
+    TEST_CHECK(tee_cluster_leader_broadcast_tx_set(cluster) == 0);
+    TEST_CHECK(tee_cluster_receive_and_sign_tx_set(cluster, cluster->executed_txs,
+                                                   cluster->executed_count, signature) == 0);
+    
+    tx_request_t extra;
+    memset(&extra, 0, sizeof(extra));
+    TEST_CHECK(tee_cluster_set_tx_limit(cluster, TEST_CLUSTER_TXS - 1) != 0);
+    TEST_CHECK(tee_cluster_set_tx_limit(cluster, TEST_CLUSTER_TXS) == 0);
+    TEST_CHECK(tee_cluster_add_tx_request(cluster, &extra) != 0);
+    TEST_CHECK(tee_cluster_add_executed_tx(cluster, TEST_CLUSTER_TXS + 1, 1, 0, 0) != 0);
+    return 0;
+}
+
+static int test_cluster_import(tee_cluster_state_t* cluster, test_stream_t* stream) {
+    uint8_t token[MAX_TOKEN_ADDRESS_LEN];
+    memset(token, 0x42, sizeof(token));
+    mpt_tree_t* token_tree = mpt_state_open(&cluster->token_state, token);
+    TEST_CHECK(token_tree != NULL);
+    stream->len = 0;
+    stream->pos = 0;
+    
+    uint8_t key[4];
+    for (uint32_t i = 0; i < TEST_SORTED_KEYS; i++) {
+        test_be32(i, key);
+        TEST_CHECK(mpt_tree_insert(token_tree, key, sizeof(key), key, sizeof(key)) == 0);
+    }
+    uint8_t exported[32];
+    TEST_CHECK(tee_cluster_export_token_state(cluster, token, test_stream_write, stream) == 0);
+    TEST_CHECK(mpt_tree_get_root_hash(token_tree, exported) == 0);
+    
+    test_be32(TEST_SORTED_KEYS, key);
+    TEST_CHECK(mpt_tree_insert(token_tree, key, sizeof(key), key, sizeof(key)) == 0);
+    uint8_t live[32];
+    uint8_t root[32];
+    TEST_CHECK(mpt_tree_get_root_hash(token_tree, live) == 0);
+    
+    TEST_CHECK(tee_cluster_import_token_state(cluster, token, live, test_stream_read, stream) != 0);
+    TEST_CHECK(mpt_tree_get_root_hash(token_tree, root) == 0);
+    TEST_CHECK(memcmp(root, live, 32) == 0);
+    
+    stream->pos = 0;
+    TEST_CHECK(tee_cluster_import_token_state(cluster, token, exported, test_stream_read, stream) == 0);
+    TEST_CHECK(mpt_tree_get_root_hash(token_tree, root) == 0);
+    TEST_CHECK(memcmp(root, exported, 32) == 0);
+    return 0;
+}
+
+typedef struct {
+    mpt_tree_t* tree;
+    size_t budget;
+} test_fetch_t;
+
+static int test_fetch_node(void* ctx, const uint8_t* path, size_t path_len, uint8_t* data, size_t* len) {
+    test_fetch_t* fetch = (test_fetch_t*)ctx;
+    if (fetch->budget == 0) return -1;
+    fetch->budget--;
+    return mpt_tree_encode_at(fetch->tree, path, path_len, data, len);
+}
+
+static int test_cluster_repair_from(tee_cluster_state_t* cluster, mpt_tree_t* remote) {
+    uint8_t token[MAX_TOKEN_ADDRESS_LEN];
+    memset(token, 0x24, sizeof(token));
+    mpt_tree_t* token_tree = mpt_state_open(&cluster->token_state, token);
+    TEST_CHECK(token_tree != NULL);
+    
+    uint8_t key[4];
+    for (uint32_t i = 0; i < TEST_BATCH_KEYS; i++) {
+        test_be32(i, key);
+        TEST_CHECK(mpt_tree_insert(remote, key, sizeof(key), key, sizeof(key)) == 0);
+    }
+    for (uint32_t i = 0; i < TEST_SORTED_KEYS; i++) {
+        test_be32((i % 8 == 0) ? i + TEST_BATCH_KEYS : i, key);
+        TEST_CHECK(mpt_tree_insert(token_tree, key, sizeof(key), key, sizeof(key)) == 0);
+    }
+    
+    uint8_t remote_root[32];
+    uint8_t local_root[32];
+    uint8_t root[32];
+    TEST_CHECK(mpt_tree_get_root_hash(remote, remote_root) == 0);
+    TEST_CHECK(mpt_tree_get_root_hash(token_tree, local_root) == 0);
+    
+    test_fetch_t fetch;
+    fetch.tree = remote;
+    fetch.budget = 4;
+    TEST_CHECK(tee_cluster_repair_token_state(cluster, token, remote_root, test_fetch_node, &fetch) != 0);
+    TEST_CHECK(mpt_tree_get_root_hash(token_tree, root) == 0);
+    TEST_CHECK(memcmp(root, local_root, 32) == 0);
+    
+    platform_alloc_t pool;
+    TEST_CHECK(platform_alloc_init_pool(&pool, "tiny", 64, 8) == 0);
+    platform_alloc_t* backing = token_tree->arena.backing;
+    token_tree->arena.backing = &pool;
+    fetch.budget = SIZE_MAX;
+    int rc = tee_cluster_repair_token_state(cluster, token, remote_root, test_fetch_node, &fetch);
+    token_tree->arena.backing = backing;
+    platform_alloc_destroy(&pool);
+    TEST_CHECK(rc != 0);
+    TEST_CHECK(mpt_tree_get_root_hash(token_tree, root) == 0);
+    TEST_CHECK(memcmp(root, local_root, 32) == 0);
+    
+    TEST_CHECK(tee_cluster_repair_token_state(cluster, token, remote_root, test_fetch_node, &fetch) == 0);
+    TEST_CHECK(mpt_tree_get_root_hash(token_tree, root) == 0);
+    TEST_CHECK(memcmp(root, remote_root, 32) == 0);
+    return 0;
+}
+
+static int test_cluster_repair(tee_cluster_state_t* cluster) {
+    mpt_tree_t remote;
+    TEST_CHECK(mpt_tree_init(&remote) == 0);
+    
+    int rc = test_cluster_repair_from(cluster, &remote);
+    
+    mpt_tree_destroy(&remote);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+static int test_cluster_tables(void) {
+    tee_cluster_state_t* cluster = (tee_cluster_state_t*)platform_malloc(sizeof(tee_cluster_state_t));
+    TEST_CHECK(cluster != NULL);
+    
+    test_stream_t* stream = (test_stream_t*)platform_malloc(sizeof(test_stream_t));
+    if (stream == NULL) {
+        platform_free(cluster);
+        TEST_CHECK(false);
+    }
+    
+    int rc = tee_cluster_init(cluster, 1);
+    if (rc == 0) rc = test_cluster_dag(cluster);
+    if (rc == 0) rc = test_cluster_txs(cluster);
+    if (rc == 0) rc = test_cluster_import(cluster, stream);
+    if (rc == 0) rc = test_cluster_repair(cluster);
+    
+    tee_cluster_destroy(cluster);
+    platform_free(cluster);
+    platform_free(stream);
+    TEST_CHECK(rc == 0);
+    return 0;
+}
+
+typedef struct {
+    const char* name;
+    int (*run)(void);
+} test_case_t;
+
+static const test_case_t test_cases[] = {
+    { "sha256", test_sha256 },
+    { "random_and_clock", test_random_and_clock },
+    { "allocator", test_allocator },
+    { "alloc_handles", test_alloc_handles },
+    { "mpt", test_mpt },
+    { "mpt_delete", test_mpt_delete },
+    { "mpt_multiproof", test_mpt_multiproof },
+    { "mpt_parallel", test_mpt_parallel },
+    { "mpt_sparse", test_mpt_sparse },
+    { "mpt_cursor", test_mpt_cursor },
+    { "mpt_snapshot_reset", test_mpt_snapshot_reset },
+    { "mpt_snap_delete", test_mpt_snapshot_delete },
+    { "mpt_batch", test_mpt_batch },
+    { "mpt_import", test_mpt_import },
+    { "mpt_store", test_mpt_store },
+    { "sequencer", test_sequencer },
+    { "dag", test_dag },
+    { "containers", test_containers },
+    { "raft_election", test_raft_election },
+    { "cluster_tables", test_cluster_tables }
+};
+
+int main(void) {
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(test_cases) / sizeof(test_cases[0]); i++) {
+        uint64_t start = platform_time_ns();
+        int rc = test_cases[i].run();
+        double ms = (double)(platform_time_ns() - start) / 1e6;
+        printf("%-18s %s %10.2f ms\n", test_cases[i].name, rc == 0 ? "ok    " : "FAILED", ms);
+        if (rc != 0) failed = 1;
+    }
+    return failed;
+}
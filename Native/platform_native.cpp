@@ -0,0 +1,68 @@
+#include "platform_native.h"
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/random.h>
+
+static void* native_system_alloc(void* ctx, size_t size) {
+    return malloc(size);
+}
+
+static void native_system_release(void* ctx, void* ptr) {
+    free(ptr);
+}
+
+static platform_allocator_t native_allocator = { native_system_alloc, native_system_release, NULL };
+
+int platform_set_allocator(const platform_allocator_t* allocator) {
+    if (allocator == NULL) {
+        native_allocator.alloc = native_system_alloc;
+        native_allocator.release = native_system_release;
+        native_allocator.ctx = NULL;
+        return 0;
+    }
+    if (allocator->alloc == NULL || allocator->release == NULL) return -1;
+    
+    native_allocator = *allocator;
+    return 0;
+}
+
+void platform_get_allocator(platform_allocator_t* allocator) {
+    if (allocator == NULL) return;
+    *allocator = native_allocator;
+}
+
+void* platform_malloc(size_t size) {
+    return native_allocator.alloc(native_allocator.ctx, size);
+}
+
+void platform_free(void* ptr) {
+    if (ptr == NULL) return;
+    native_allocator.release(native_allocator.ctx, ptr);
+}
+
+int platform_get_entropy(uint8_t* buffer, size_t len) {
+    if (buffer == NULL) return -1;
+    
+    size_t filled = 0;
+    while (filled < len) {
+        ssize_t got = getrandom(buffer + filled, len - filled, 0);
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        filled += (size_t)got;
+    }
+    return 0;
+}
+
+uint64_t platform_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t platform_time_ms(void) {
+    return platform_time_ns() / 1000000ull;
+}
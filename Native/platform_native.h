@@ -0,0 +1,19 @@
+#ifndef _PLATFORM_NATIVE_H_
+#define _PLATFORM_NATIVE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "../Common/mpt_tree/mpt_tree_common.h"
+#include "../Common/platform/platform_crypto.h"
+
+typedef struct {
+    void* (*alloc)(void* ctx, size_t size);
+    void (*release)(void* ctx, void* ptr);
+    void* ctx;
+} platform_allocator_t;
+
+int platform_set_allocator(const platform_allocator_t* allocator);
+
+void platform_get_allocator(platform_allocator_t* allocator);
+
+#endif